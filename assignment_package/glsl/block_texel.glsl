@@ -0,0 +1,26 @@
+// block_texel.glsl:
+// Block texture sampling shared by lambert.frag.glsl and gbuffer.frag.glsl.
+
+uniform sampler2DArray u_Texture; // Every block texture, one per layer
+
+// Samples the block texture array. The lava and water cells scroll
+// through the cells to their right over time, one texel per step.
+// Needs u_Time, so include per_frame.glsl first.
+vec4 blockTexel(vec3 uv)
+{
+    ivec2 cell = ivec2(int(uv.z + 0.5) % 16, int(uv.z + 0.5) / 16);
+    vec2 st = uv.xy;
+    if(cell.x >= 13 && cell.y < 4)
+    {
+        // Far tiles repeat each texture across several blocks, so wrap into the cell first
+        st.x = fract(st.x);
+        st.x += floor(fract(float(u_Time) / 128.f) * 16) / 16;
+        if(st.x >= 1.f)
+        {
+            st.x -= 1.f;
+            cell.x = (cell.x + 1) % 16;
+        }
+    }
+    // The unshifted gradients, so the jump into the next cell doesn't pick a blurrier mip
+    return textureGrad(u_Texture, vec3(st, cell.x + 16 * cell.y), dFdx(uv.xy), dFdy(uv.xy));
+}
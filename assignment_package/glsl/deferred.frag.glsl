@@ -0,0 +1,48 @@
+#version 150
+// deferred.frag.glsl:
+// The lighting half of the deferred path. Runs once per covered pixel,
+// reading the G-buffer written by gbuffer.frag.glsl and applying the
+// same terrain lighting as lambert.frag.glsl (terrain_lighting.glsl),
+// so that none of it is spent on overdraw.
+
+uniform sampler2D u_Albedo;  // G-buffer attachment 0
+uniform sampler2D u_Normal;  // G-buffer attachment 1
+uniform sampler2D u_Depth;   // G-buffer depth
+
+// Shadows, sun and baked light, shared with lambert.frag.glsl
+#include "terrain_lighting.glsl"
+
+in vec2 fs_UV;
+
+out vec4 out_Col;
+
+void main()
+{
+        float depth = texture(u_Depth, fs_UV).r;
+        // Nothing was drawn here, so leave the sky behind it
+        if(depth == 1.0)
+        {
+            discard;
+        }
+        // Keep the depth so translucent geometry drawn afterwards is still occluded
+        gl_FragDepth = depth;
+
+        // Rebuild the inputs lambert.vert.glsl would have interpolated
+        vec4 ndc = vec4(fs_UV * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+        vec4 fs_Pos = u_InvViewProj * ndc;
+        fs_Pos /= fs_Pos.w;
+        vec4 fs_Nor = vec4(texture(u_Normal, fs_UV).xyz * 2.0 - 1.0, 0);
+        float fs_ViewDepth = (u_ViewProj * fs_Pos).w;
+        vec4 fs_shadowcoord[3];
+        for (int i = 0; i < 3; i++) {
+            fs_shadowcoord[i] = u_depthbiasMVP[i] * fs_Pos;
+        }
+
+        // Already carries the biome tint, and the light reaching the face in alpha
+        vec4 diffuseColor = texture(u_Albedo, fs_UV);
+
+        // Water is translucent and stays on the forward path, so only the diffuse term applies
+        vec3 light = terrainLight(fs_Pos, fs_Nor, fs_ViewDepth, fs_shadowcoord, diffuseColor.a, false);
+        // Compute final shaded color
+        out_Col = vec4(diffuseColor.xyz * light,1.0);
+}
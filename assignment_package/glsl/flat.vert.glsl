@@ -4,7 +4,9 @@
 // Refer to the lambert shader files for useful comments
 
 uniform mat4 u_Model;
-uniform mat4 u_ViewProj;
+
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
 
 in vec4 vs_Pos;
 in vec4 vs_Col;
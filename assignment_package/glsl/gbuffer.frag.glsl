@@ -0,0 +1,33 @@
+#version 330
+// gbuffer.frag.glsl:
+// Writes the surface attributes of opaque terrain into the G-buffer.
+// Version 330 so each output can be pinned to its color attachment.
+// Layout (see MyGL::m_gBuffer):
+//   attachment 0: albedo in rgb, biome tint included, baked light in alpha
+//   attachment 1: normal in rgb
+// Depth comes from the depth attachment.
+
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
+// Block texture sampling, shared with lambert.frag.glsl
+#include "block_texel.glsl"
+
+in vec4 fs_Nor;
+in vec3 fs_UV;
+in vec4 fs_Col;
+
+layout(location = 0) out vec4 out_Albedo;
+layout(location = 1) out vec4 out_Normal;
+
+void main()
+{
+    vec4 diffuseColor = blockTexel(fs_UV);
+
+    if(diffuseColor.a == 0.f)
+    {
+        discard;
+    }
+
+    out_Albedo = vec4(diffuseColor.rgb * fs_Col.rgb, fs_Col.a);
+    out_Normal = vec4(normalize(fs_Nor.xyz) * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 150
+// gbuffer.vert.glsl:
+// The geometry half of the deferred path. Only passes along what the
+// G-buffer stores; all lighting inputs are rebuilt per pixel later
+// from the depth buffer in deferred.frag.glsl.
+
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
+
+in vec4 vs_Pos;             // The array of vertex positions passed to the shader
+in ivec2 vs_ChunkOffset;    // World-space XZ origin of the Chunk being drawn, one per draw
+in vec4 vs_Nor;             // The array of vertex normals passed to the shader
+in vec3 vs_UV;              // Texture coordinates within a block texture, then its texture array layer
+in vec4 vs_Col;             // The biome tint baked into each vertex when its Chunk was meshed
+
+out vec4 fs_Nor;
+out vec3 fs_UV;
+out vec4 fs_Col;
+
+void main()
+{
+    fs_UV = vs_UV;
+    fs_Col = vs_Col;
+    // Terrain is only ever translated, so its normals need no transformation
+    fs_Nor = vs_Nor;
+    gl_Position = u_ViewProj * (vs_Pos + vec4(vs_ChunkOffset.x, 0, vs_ChunkOffset.y, 0));
+}
@@ -0,0 +1,18 @@
+#version 400
+
+// Refer to the lambert shader files for useful comments
+
+in vec4 fs_Pos;
+in vec4 fs_Nor;
+in vec4 fs_LightVec;
+in vec4 fs_Col;             // The color of the instance
+
+out vec4 out_Col;
+
+void main()
+{
+    // Plain lambertian shading, so the faces of a box can be told apart
+    float diffuseTerm = clamp(dot(normalize(fs_Nor), normalize(fs_LightVec)), 0, 1);
+    float lightIntensity = diffuseTerm + 0.3;
+    out_Col = vec4(fs_Col.rgb * lightIntensity, fs_Col.a);
+}
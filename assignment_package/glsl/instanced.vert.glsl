@@ -7,9 +7,8 @@
 //This simultaneous transformation allows your program to run much faster, especially when rendering
 //geometry with millions of vertices.
 
-uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformation.
-                            // We've written a static matrix for you to use for HW2,
-                            // but in HW3 you'll have to generate one yourself
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 in vec4 vs_Nor;             // The array of vertex normals passed to the shader
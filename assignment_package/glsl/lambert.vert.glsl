@@ -8,60 +8,46 @@
 //This simultaneous transformation allows your program to run much faster, especially when rendering
 //geometry with millions of vertices.
 
-uniform mat4 u_Model;       // The matrix that defines the transformation of the
-                            // object we're rendering. In this assignment,
-                            // this will be the result of traversing your scene graph.
-
-uniform mat4 u_ModelInvTr;  // The inverse transpose of the model matrix.
-                            // This allows us to transform the object's normals properly
-                            // if the object has been non-uniformly scaled.
-
-uniform mat4 u_ViewProj;    // The matrix that defines the camera's transformation.
-                            // We've written a static matrix for you to use for HW2,
-                            // but in HW3 you'll have to generate one yourself
-
-uniform mat4 u_depthbiasMVP;
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
 
 uniform vec4 u_Color;       // When drawing the cube instance, we'll set our uniform color to represent different block types.
-uniform int u_Time;
-uniform vec3 u_Cam;         // The vector that defines the camera's position
-uniform vec4 lightDir;
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
+in ivec2 vs_ChunkOffset;    // World-space XZ origin of the Chunk or far tile being drawn, one per draw
 
 in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 
-in vec4 vs_Col;             // The array of vertex colors passed to the shader.
-in vec2 vs_UV;              // The array of vertex texture coordinates passed to the shader
+in vec4 vs_Col;             // The biome tint baked into each vertex when its Chunk was meshed
+in vec3 vs_UV;              // Texture coordinates within a block texture, then its texture array layer
 
 out vec4 fs_Pos;
-out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
+out vec4 fs_Nor;            // The array of normals. This is implicitly passed to the fragment shader.
 out vec4 world_Nor;
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
-out vec2 fs_UV;              // The array of vertex texture coordinates passed to the shader
+out vec3 fs_UV;              // The array of vertex texture coordinates passed to the shader
 
 out vec4 fs_CameraPos;
 
-out vec4 fs_shadowcoord;
+out vec4 fs_shadowcoord[3];
+out float fs_ViewDepth;     // Distance along the camera's view direction, used to pick a cascade
 
-#define BLK_UV  0.0625
-#define IS_WATER (fs_UV.x > 12.9 * BLK_UV && fs_UV.x <= 16.1 * BLK_UV && fs_UV.y > 2.5 * BLK_UV && fs_UV.y <= 4.1 * BLK_UV)
+// Atlas cell of the face's block texture, recovered from its texture array layer
+#define BLK_CELL ivec2(int(fs_UV.z + 0.5) % 16, int(fs_UV.z + 0.5) / 16)
+#define IS_WATER (BLK_CELL.x >= 13 && BLK_CELL.y >= 2 && BLK_CELL.y <= 3)
 
 void main()
 {
-    fs_Pos = u_Model * vs_Pos;
+    fs_Pos = vs_Pos + vec4(vs_ChunkOffset.x, 0, vs_ChunkOffset.y, 0);
     fs_UV = vs_UV;                         // Pass the vertex colors to the fragment shader for interpolation
+    fs_Col = vs_Col;
 
-    mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
-                                                            // Transform the geometry's normals by the inverse transpose of the
-                                                            // model matrix. This is necessary to ensure the normals remain
-                                                            // perpendicular to the surface after the surface is transformed by
-                                                            // the model matrix.
+    // Terrain is only ever translated, so its normals need no transformation
+    fs_Nor = vs_Nor;
     world_Nor = vs_Nor;
 
-    vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
+    vec4 modelposition = vs_Pos + vec4(vs_ChunkOffset.x, 0, vs_ChunkOffset.y, 0);   // Temporarily store the transformed vertex positions for use below
 
 
 
@@ -81,14 +67,17 @@ void main()
     }
 
 
-    fs_CameraPos = vec4(u_Cam[0], u_Cam[1], u_Cam[2], 1); // We want to use this uniform instead of the
+    fs_CameraPos = vec4(u_Eye, 1);                        // We want to use this uniform instead of the
                                                           // original implementation involving the inverse
                                                           // of our view matrix because invoking the inverse
                                                           // function is costly.
 
-    fs_LightVec = (lightDir);  // Compute the direction in which the light source lies
-    fs_shadowcoord = u_depthbiasMVP * modelposition;
+    fs_LightVec = (u_LightDir);  // Compute the direction in which the light source lies
+    for (int i = 0; i < 3; i++) {
+        fs_shadowcoord[i] = u_depthbiasMVP[i] * modelposition;
+    }
     gl_Position = u_ViewProj * modelposition;// gl_Position is a built-in variable of OpenGL which is
                                              // used to render the final positions of the geometry's vertices
+    fs_ViewDepth = gl_Position.w;
 
 }
@@ -1,17 +0,0 @@
-#version 150
-// noOp.vert.glsl:
-// A fragment shader used for post-processing that simply reads the
-// image produced in the first render pass by the surface shader
-// and outputs it to the frame buffer
-
-
-in vec2 fs_UV;
-
-out vec4 out_Col;
-
-uniform sampler2D u_RenderedTexture;
-
-void main()
-{
-    out_Col = texture(u_RenderedTexture, fs_UV);
-}
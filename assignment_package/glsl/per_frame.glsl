@@ -0,0 +1,14 @@
+// per_frame.glsl:
+// Per-frame state shared by every program, uploaded once per frame by MyGL.
+// Spliced into a shader by an #include "per_frame.glsl" line, see
+// ProgramBinaryCache::readSource. Must match PerFrameUniforms in uniformbuffer.h.
+layout(std140) uniform PerFrame {
+    mat4 u_ViewProj;          // The camera's combined projection and view matrices
+    mat4 u_InvViewProj;       // Its inverse, used to cast rays into the sky
+    mat4 u_depthbiasMVP[3];   // Maps world space into each shadow cascade, nearest first
+    vec4 u_CascadeSplits;     // View depth at which each cascade ends
+    vec4 u_LightDir;          // Direction toward the sun
+    vec3 u_Eye;               // Camera position
+    int u_Time;
+    vec2 u_Dimensions;        // Screen dimensions
+};
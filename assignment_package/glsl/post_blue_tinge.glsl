@@ -0,0 +1,22 @@
+// post_blue_tinge.glsl:
+// Underwater: ripples the image and maps its blue channel onto a blue palette.
+// Spliced into a pass by PostProcessChain, which defines POST_EFFECT as
+// this effect's function and POST_INPUT as the stage it reads from.
+
+vec4 POST_EFFECT(vec2 uv)
+{
+    const vec3 a = vec3(0.4, 0.5, 0.5);
+    const vec3 b = vec3(0.43, 0.5, 0.5);
+    const vec3 c = vec3(0.4, 0.57, 0.46);
+    const vec3 d = vec3(-1.573, 0.4233, 0.63);
+
+    vec2 p;
+    float crest;
+    tingeWaves(uv, p, crest);
+    vec4 color = vec4(crest)*0.7+POST_INPUT( uv + p );
+
+    float h = color.b;
+    h = min(1.0, pow(h, 2.0));
+
+    return vec4(cosinePalette(h, a, b, c, d), 1.0);
+}
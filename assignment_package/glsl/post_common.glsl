@@ -1,20 +1,22 @@
-#version 150
+// post_common.glsl:
+// Declarations shared by every post-process pass that PostProcessChain
+// generates, followed by the helpers its effects may call.
+
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
 
 in vec2 fs_UV;
-uniform int u_Time;
 
 out vec4 out_Col;
 
 uniform sampler2D u_RenderedTexture;
 
-const vec3 a = vec3(0.4, 0.5, 0.5);
-const vec3 b = vec3(0.43, 0.5, 0.5);
-const vec3 c = vec3(0.4, 0.57, 0.46);
-const vec3 d = vec3(-1.573, 0.4233, 0.63);
-vec3 cosinePalette(float t) {
+const float timeSpeed = 0.2;
+
+// Maps t onto the cosine palette a + b * cos(2pi * (c * t + d))
+vec3 cosinePalette(float t, vec3 a, vec3 b, vec3 c, vec3 d) {
     return clamp(a + b * cos(2.0 * 3.14159 * (c * t + d)), 0.0, 1.0);
 }
-float timeSpeed = 0.2;
 
 float randomVal (float inVal)
 {
@@ -45,37 +47,24 @@ float makeWaves(vec2 uv, float theTime, float offset)
     return result;
 }
 
-void main()
+// Ripples shared by the tinge effects: the offset by which they
+// displace the image at uv, and how bright the wave crest there is
+void tingeWaves(vec2 uv, out vec2 offset, out float crest)
 {
-    vec2 uv = fs_UV;
     vec2 uv2 = uv * 150.0; // scale
 
-
     float result = 0.0;
     float result2 = 0.0;
 
     result = makeWaves( uv2+vec2(u_Time*timeSpeed,0.0), u_Time, 0.1);
     result2 = makeWaves( uv2-vec2(u_Time*0.8*timeSpeed,0.0), u_Time*0.8+0.06, 0.26);
 
-    //result *= 2.6;
-
     result = smoothstep(0.4,1.1,1.0-abs(result));
     result2 = smoothstep(0.4,1.1,1.0-abs(result2));
 
     result = 2.0*smoothstep(0.35,1.8,(result+result2)*0.5);
 
-        //fragColor = vec4(result)*0.7+texture( iChannel0 , uv );
-
     // thank for this code below Shane!
-    vec2 p = vec2(result, result2)*.015 + sin(uv*16. - cos(uv.yx*16. + u_Time*timeSpeed))*.015; // Etc.
-    vec4 color = vec4(result)*0.7+texture( u_RenderedTexture , uv + p );
-
-    float h = color.b;
-
-    vec4 fragColor = vec4(h, h, h, 1.0);
-
-    h = min(1.0, pow(h, 2.0));
-
-    // Output to screen
-    out_Col = vec4(cosinePalette(h), 1.0);
+    offset = vec2(result, result2)*.015 + sin(uv*16. - cos(uv.yx*16. + u_Time*timeSpeed))*.015; // Etc.
+    crest = result;
 }
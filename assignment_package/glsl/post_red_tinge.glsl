@@ -0,0 +1,22 @@
+// post_red_tinge.glsl:
+// Inside lava: ripples the image and maps its red channel onto a red palette.
+// Spliced into a pass by PostProcessChain, which defines POST_EFFECT as
+// this effect's function and POST_INPUT as the stage it reads from.
+
+vec4 POST_EFFECT(vec2 uv)
+{
+    const vec3 a = vec3(0.5, 0.5, 0.4);
+    const vec3 b = vec3(0.5, 0.5, 0.43);
+    const vec3 c = vec3(0.46, 0.57, 0.4);
+    const vec3 d = vec3(0.63, 0.4233, -1.573);
+
+    vec2 p;
+    float crest;
+    tingeWaves(uv, p, crest);
+    vec4 color = vec4(crest)*0.7+POST_INPUT( uv + p );
+
+    float h = color.r;
+    h = min(1.0, pow(h, 2.0));
+
+    return vec4(cosinePalette(h, a, b, c, d), 1.0);
+}
@@ -8,19 +8,17 @@
 //This simultaneous transformation allows your program to run much faster, especially when rendering
 //geometry with millions of vertices.
 
-uniform mat4 u_Model;       // The matrix that defines the transformation of the
-                            // object we're rendering. In this assignment,
-                            // this will be the result of traversing your scene graph.
 
 uniform mat4 u_shadowViewProj;    // The matrix that defines the camera's transformation.
                             // We've written a static matrix for you to use for HW2,
                             // but in HW3 you'll have to generate one yourself
 
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
+in ivec2 vs_ChunkOffset;    // World-space XZ origin of the Chunk being drawn, one per draw
 
 void main()
 {
-    vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
+    vec4 modelposition = vs_Pos + vec4(vs_ChunkOffset.x, 0, vs_ChunkOffset.y, 0);   // Temporarily store the transformed vertex positions for use below
 
     gl_Position = u_shadowViewProj * modelposition;// gl_Position is a built-in variable of OpenGL which is
                                              // used to render the final positions of the geometry's vertices
@@ -1,14 +1,9 @@
 #version 150
 
-uniform mat4 u_ViewProj;    // We're actually passing the inverse of the viewproj
-                            // from our CPU, but it's named u_ViewProj so we don't
-                            // have to bother rewriting our ShaderProgram class
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
 
-uniform vec2 u_Dimensions; // Screen dimensions
-
-uniform vec3 u_Eye; // Camera pos
-
-uniform int u_Time;
+in vec3 fs_RayDir;         // Ray direction of this texel, from sky.vert
 
 out vec4 outColor;
 
@@ -250,15 +245,8 @@ float worleyFBM(vec3 uv) {
 
 void main()
 {
-    // From pixel space to world space
-    vec2 ndc = (gl_FragCoord.xy / vec2(u_Dimensions)) * 2.0 - 1.0; // -1 to 1 NDC
-
-    vec4 p = vec4(ndc.xy, 1, 1); // Pixel at the far clip plane
-    p *= 1000.0; // Times far clip plane value
-    p = /*Inverse of*/ u_ViewProj * p; // Convert from unhomogenized screen to world
-
-    // Direction from camera to this point
-    vec3 rayDir = normalize(p.xyz - u_Eye);
+    // Direction of this texel of the cubemap face
+    vec3 rayDir = normalize(fs_RayDir);
 
     // get UV coordinate based on ray direction
     vec2 uv = sphereToUV(rayDir);
@@ -1,8 +1,17 @@
 #version 150
 
+// Draws one face of the sky cubemap.
+// Maps the face's NDC onto ray directions from the origin.
+uniform mat4 u_FaceInvViewProj;
+
 in vec4 vs_Pos;
 
+out vec3 fs_RayDir;
+
 void main()
 {
-    gl_Position = vs_Pos;
+    // Every point of the far plane shares one w, so the directions interpolate linearly
+    vec4 p = u_FaceInvViewProj * vec4(vs_Pos.xy, 1, 1);
+    fs_RayDir = p.xyz / p.w;
+    gl_Position = vec4(vs_Pos.xy, 0, 1);
 }
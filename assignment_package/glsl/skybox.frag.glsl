@@ -0,0 +1,13 @@
+#version 150
+
+// Looks the sky up in the cubemap kept by SkyCubeMap
+uniform samplerCube u_SkyCube;
+
+in vec3 fs_RayDir;
+
+out vec4 outColor;
+
+void main()
+{
+    outColor = vec4(texture(u_SkyCube, fs_RayDir).rgb, 1);
+}
@@ -0,0 +1,17 @@
+#version 150
+
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
+
+in vec4 vs_Pos;
+
+out vec3 fs_RayDir;
+
+void main()
+{
+    // Direction from the camera through this corner of the screen
+    vec4 p = u_InvViewProj * vec4(vs_Pos.xy, 1, 1);
+    fs_RayDir = p.xyz / p.w - u_Eye;
+    // On the far plane, so the depth test only lets the sky through where nothing was drawn
+    gl_Position = vec4(vs_Pos.xy, 1, 1);
+}
@@ -0,0 +1,180 @@
+// terrain_lighting.glsl:
+// The lighting shared by the forward (lambert.frag.glsl) and deferred
+// (deferred.frag.glsl) terrain paths: cascaded shadow PCF, the sun's
+// color and angle through the day, and the baked sky and block light.
+
+uniform sampler2D u_Shadow;  // The nearest shadow cascade
+uniform sampler2D u_Shadow1;
+uniform sampler2D u_Shadow2; // The farthest shadow cascade
+
+// Camera, light and time, shared by every program
+#include "per_frame.glsl"
+
+#define SUN_VELOCITY (1 / 20000.f)
+#define SUNSET_LEN 0.4
+#define SHININESS 25
+// Color of the light given off by lava
+#define BLOCK_LIGHT_COLOR vec3(1.0, 0.75, 0.5)
+
+// Sun palette
+const vec3 sun[3] = vec3[](vec3(255, 255, 245) / 255.0,
+                            vec3(255, 137, 103) / 255.0,
+                            vec3(107, 73, 132) / 255.0);
+
+// Light baked into the mesh, from 0 (dark) to 1 (full), sky in x and block in y.
+// Packed by the LightEngine as sky level * 16 + block level, see chunk.h.
+vec2 lightLevels(float packedLight)
+{
+    float light = floor(packedLight * 255.0 + 0.5);
+    return vec2(floor(light / 16.0), mod(light, 16.0)) / 15.0;
+}
+
+// Each level lost to distance dims the light by a fifth
+float lightCurve(float level)
+{
+    return pow(0.8, 15.0 * (1.0 - level));
+}
+
+vec2 poissonDisk[16] = vec2[](
+        vec2( -0.94201624, -0.39906216 ),
+           vec2( 0.94558609, -0.76890725 ),
+           vec2( -0.094184101, -0.92938870 ),
+           vec2( 0.34495938, 0.29387760 ),
+           vec2( -0.91588581, 0.45771432 ),
+           vec2( -0.81544232, -0.87912464 ),
+           vec2( -0.38277543, 0.27676845 ),
+           vec2( 0.97484398, 0.75648379 ),
+           vec2( 0.44323325, -0.97511554 ),
+           vec2( 0.53742981, -0.47373420 ),
+           vec2( -0.26496911, -0.41893023 ),
+           vec2( 0.79197514, 0.19090188 ),
+           vec2( -0.24188840, 0.99706507 ),
+           vec2( -0.81409955, 0.91437590 ),
+           vec2( 0.19984126, 0.78641367 ),
+           vec2( 0.14383161, -0.14100790 )
+);
+
+// Percentage-closer filtering of one shadow cascade
+float shadowVisibility(sampler2D shadowMap, vec4 shadowcoord, float bias)
+{
+    float visibility = 1.0;
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0));
+    bool inShadowMap = all(greaterThanEqual(shadowcoord.xy, vec2(0.0))) && all(lessThanEqual(shadowcoord.xy, vec2(1.0)));
+    for (int i=0;i<16 && inShadowMap;i++){
+      if ( texture(shadowMap,shadowcoord.xy + poissonDisk[i]*texel ).r  <  shadowcoord.z-bias ){
+        visibility-=0.05;
+      }
+    }
+    return visibility;
+}
+
+// The light reaching a terrain surface at world position pos with normal nor.
+// viewDepth and shadowcoord place it in the shadow cascades, packedLight is the
+// light baked into its mesh, and water adds a highlight of the sun on water.
+vec3 terrainLight(vec4 pos, vec4 nor, float viewDepth, vec4 shadowcoord[3], float packedLight, bool water)
+{
+        vec4 lightVec = u_LightDir;
+
+        // Calculate the diffuse term for Lambert shading
+        float diffuseTerm = dot(normalize(nor), normalize(lightVec));
+        // Avoid negative lighting values
+        diffuseTerm = clamp(diffuseTerm, 0, 1);
+        float bias = 0.0005*tan(acos(diffuseTerm)); // cosTheta is dot( n,l ), clamped between 0 and 1
+        bias = clamp(bias, 0,0.005);
+        float visibility = 1.0;
+        // Far terrain lies beyond the last cascade, so leave it unshadowed
+        if (viewDepth < u_CascadeSplits.x) {
+            visibility = shadowVisibility(u_Shadow, shadowcoord[0], bias);
+        }
+        else if (viewDepth < u_CascadeSplits.y) {
+            visibility = shadowVisibility(u_Shadow1, shadowcoord[1], bias);
+        }
+        else if (viewDepth < u_CascadeSplits.z) {
+            visibility = shadowVisibility(u_Shadow2, shadowcoord[2], bias);
+        }
+        if((visibility > 0.9)){
+            visibility = 1.0;
+        }
+        float ambientTerm = 0.25;
+        float lightIntensity = 0.f;
+
+        if (water)
+        {
+            float exp = 200.f;
+            vec4 view = vec4(u_Eye, 1) - pos;
+            vec4 H = (view + lightVec) / 2;
+            vec4 normalized_H = normalize(H);
+            vec4 normalized_N = normalize(nor);
+            float specularIntensity = max(pow(dot(normalized_H , normalized_N), exp), 0);
+            lightIntensity = diffuseTerm + specularIntensity; // add specular highlight intensity
+                                                                        // to a basic Lambertian shading calculation
+        }
+        else
+        {
+            lightIntensity = diffuseTerm;
+        }
+
+        if((lightVec.y <= 0.1) && (lightVec.y >= 0.01f)){
+            lightIntensity = mix(0.2f,lightIntensity,lightVec.y * 10);
+            visibility = mix(0.5f,visibility,lightVec.y * 10);
+        }
+        if(lightVec.y <= 0.01f){
+            lightIntensity = 0.2f;
+            visibility = 0.5f;
+        }
+        if(lightVec.y >= 0.999){
+            visibility = mix(1.f,visibility,(1-lightVec.y) * 1000);
+        }
+
+        //Compute sun
+        float timeIndicator = sin(u_Time * SUN_VELOCITY);
+
+                // Color of sun light
+                vec3 sun_color;
+                if (timeIndicator > SUNSET_LEN) {
+                    sun_color = sun[0];
+                }
+                else if (timeIndicator < -SUNSET_LEN) {
+                    sun_color = sun[2];
+                }
+                else {
+                    if (timeIndicator > 0) {
+                        float smooth_t = smoothstep(0.f, 1.f, abs(timeIndicator) / SUNSET_LEN);
+                        sun_color = mix(sun[1], sun[0], smooth_t);
+                    }
+                    else {
+                        float smooth_t = smoothstep(0.f, 1.f, abs(timeIndicator) / (SUNSET_LEN));
+                        sun_color = mix(sun[1], sun[2], smooth_t);
+                    }
+                }
+
+                // Calculate the diffuse term for Lambert shading
+                vec3 sunDir = vec3(lightVec);
+                float diffuseTermSun = dot(normalize(vec3(nor)), normalize(sunDir));
+                // Avoid negative lighting values
+                diffuseTermSun = clamp(diffuseTermSun, 0, 1);
+
+                // Calculate the specular term
+                vec3 view_dir = u_Eye - vec3(pos);
+                vec3 H = (normalize(view_dir) + normalize(sunDir)) / 2;
+                float specularSun = pow(dot(normalize(vec3(nor)), normalize(H)), SHININESS);
+                // Avoid negative lighting values
+                specularSun = clamp(specularSun, 0, 1);
+
+                if (timeIndicator < -SUNSET_LEN) {
+                    diffuseTermSun = 0.f;
+                    specularSun = 0.f;
+                }
+                else if (timeIndicator >= -SUNSET_LEN && timeIndicator < SUNSET_LEN) {
+                    diffuseTermSun = mix(0.f, diffuseTermSun, (timeIndicator + SUNSET_LEN) / (2.f * SUNSET_LEN));
+                    specularSun = mix(0.f, specularSun, (timeIndicator + SUNSET_LEN) / (2.f * SUNSET_LEN));
+                }
+
+        lightIntensity = (0.5 * diffuseTermSun + specularSun)/ 2 + lightIntensity / 2 + ambientTerm;
+        // The sun only reaches as far as the skylight does, while lava lights
+        // caves in its own color, so a face takes whichever is brighter
+        vec2 levels = lightLevels(packedLight);
+        vec3 skyLit = visibility * lightIntensity * sun_color * lightCurve(levels.x);
+        vec3 blockLit = BLOCK_LIGHT_COLOR * lightCurve(levels.y);
+        return max(skyLit, blockLit);
+}
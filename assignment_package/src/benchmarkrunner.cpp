@@ -0,0 +1,190 @@
+#include "benchmarkrunner.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Samples per spline segment used to measure its length
+#define BENCHMARK_LENGTH_SAMPLES 64
+// Longest step taken along the path in one tick, so a hitch does not skip terrain
+#define BENCHMARK_MAX_DT 0.1f
+
+namespace {
+// The path, relative to where the benchmark starts: a loop out over
+// roughly 1.3 x 1.3 km of terrain just above the mountain tops
+const glm::vec3 PATH_POINTS[] = {
+    {0, 80, 0}, {0, 80, -400}, {300, 90, -800}, {800, 100, -900}, {1200, 90, -500},
+    {1300, 80, 0}, {900, 90, 400}, {400, 80, 300}, {0, 80, 0}
+};
+
+float percentile(std::vector<float> samples, float p) {
+    if(samples.empty()) {
+        return 0.f;
+    }
+    int rank = std::min(static_cast<int>(samples.size()) - 1, static_cast<int>(p / 100.f * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+// Peak resident set size in MB, or -1 where the platform does not say
+float peakRssMb() {
+#if defined(__linux__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.f; // KB
+#elif defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / (1024.f * 1024.f); // Bytes
+#else
+    return -1.f;
+#endif
+}
+}
+
+BenchmarkRunner::BenchmarkRunner()
+    : m_state(WAITING), m_speed(0.f), m_path(), m_pathLengths(), m_distance(0.f), m_framePending(false),
+      m_clock(), m_lastFrameNs(-1), m_frameMs(), m_chunksInView(), m_popInMs()
+{}
+
+void BenchmarkRunner::start(glm::vec3 origin, float speed) {
+    m_state = RUNNING;
+    m_speed = speed;
+    m_path.clear();
+    for(const glm::vec3 &p : PATH_POINTS) {
+        m_path.push_back(origin + p);
+    }
+    m_pathLengths.clear();
+    float length = 0.f;
+    for(int segment = 0; segment + 1 < static_cast<int>(m_path.size()); segment++) {
+        glm::vec3 prev = pointOnSegment(segment, 0.f);
+        for(int i = 1; i <= BENCHMARK_LENGTH_SAMPLES; i++) {
+            glm::vec3 p = pointOnSegment(segment, i / static_cast<float>(BENCHMARK_LENGTH_SAMPLES));
+            length += glm::length(p - prev);
+            prev = p;
+        }
+        m_pathLengths.push_back(length);
+    }
+    m_distance = 0.f;
+    m_clock.start();
+    m_lastFrameNs = -1;
+    std::cout << "Benchmark: flying " << static_cast<int>(length) << " blocks at " << speed << " blocks/s" << std::endl;
+}
+
+bool BenchmarkRunner::isRunning() const {
+    return m_state == RUNNING;
+}
+
+bool BenchmarkRunner::isFinished() const {
+    return m_state == FINISHED;
+}
+
+bool BenchmarkRunner::isFramePending() const {
+    return m_state == RUNNING && m_framePending;
+}
+
+glm::vec3 BenchmarkRunner::pointOnSegment(int segment, float t) const {
+    // Catmull-Rom through the segment's ends, with the end points repeated
+    int last = static_cast<int>(m_path.size()) - 1;
+    const glm::vec3 &p0 = m_path[std::max(segment - 1, 0)];
+    const glm::vec3 &p1 = m_path[segment];
+    const glm::vec3 &p2 = m_path[std::min(segment + 1, last)];
+    const glm::vec3 &p3 = m_path[std::min(segment + 2, last)];
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.f * p1) + (p2 - p0) * t
+                   + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2
+                   + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+glm::vec3 BenchmarkRunner::pointAt(float distance) const {
+    auto end = std::lower_bound(m_pathLengths.begin(), m_pathLengths.end(), distance);
+    if(end == m_pathLengths.end()) {
+        return m_path.back();
+    }
+    int segment = static_cast<int>(end - m_pathLengths.begin());
+    float segmentStart = segment == 0 ? 0.f : m_pathLengths[segment - 1];
+    // Each segment's parameter is close enough to uniform in distance for a camera path
+    float t = (distance - segmentStart) / std::max(*end - segmentStart, 1e-3f);
+    return pointOnSegment(segment, t);
+}
+
+bool BenchmarkRunner::advance(float dT, Player &player) {
+    if(m_state != RUNNING) {
+        return false;
+    }
+    m_distance += m_speed * std::min(dT, BENCHMARK_MAX_DT);
+    if(m_distance >= m_pathLengths.back()) {
+        m_state = FINISHED;
+        return false;
+    }
+    glm::vec3 pos = pointAt(m_distance);
+    glm::vec3 ahead = pointAt(std::min(m_distance + 8.f, m_pathLengths.back()));
+    // Look a little downwards, at the terrain being streamed in
+    glm::vec3 forward = glm::normalize(ahead - pos) - glm::vec3(0.f, 0.3f, 0.f);
+    player.setPose(pos, forward);
+    m_framePending = true;
+    return true;
+}
+
+void BenchmarkRunner::trackChunks(const Terrain &terrain, glm::vec3 pos, int radius) {
+    if(m_state != RUNNING) {
+        return;
+    }
+    qint64 now = m_clock.nsecsElapsed();
+    std::unordered_map<int64_t, qint64> inView;
+    int minX = 16 * static_cast<int>(glm::floor((pos.x - radius) / 16.f));
+    int minZ = 16 * static_cast<int>(glm::floor((pos.z - radius) / 16.f));
+    for(int x = minX; x <= pos.x + radius; x += 16) {
+        for(int z = minZ; z <= pos.z + radius; z += 16) {
+            int64_t key = toKey(x, z);
+            auto seen = m_chunksInView.find(key);
+            qint64 since = seen == m_chunksInView.end() ? now : seen->second;
+            if(since >= 0 && terrain.hasChunkAt(x, z) && terrain.getChunkAt(x, z)->opaquevbogenerated()) {
+                // A Chunk already drawn as it came into view never popped in, so it is not a sample
+                if(seen != m_chunksInView.end()) {
+                    m_popInMs.push_back((now - since) / 1e6f);
+                }
+                since = -1;
+            }
+            inView[key] = since;
+        }
+    }
+    m_chunksInView.swap(inView);
+}
+
+void BenchmarkRunner::frameDone() {
+    if(m_state != RUNNING) {
+        return;
+    }
+    qint64 now = m_clock.nsecsElapsed();
+    if(m_lastFrameNs >= 0) {
+        m_frameMs.push_back((now - m_lastFrameNs) / 1e6f);
+    }
+    m_lastFrameNs = now;
+    m_framePending = false;
+}
+
+void BenchmarkRunner::printReport() const {
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Benchmark finished in " << m_clock.elapsed() / 1000.f << " s, "
+              << m_frameMs.size() << " frames" << std::endl;
+    std::cout << "Frame time (ms): p50 " << percentile(m_frameMs, 50.f)
+              << "  p95 " << percentile(m_frameMs, 95.f)
+              << "  p99 " << percentile(m_frameMs, 99.f)
+              << "  max " << percentile(m_frameMs, 100.f) << std::endl;
+    std::cout << "Chunk pop-in after coming into view (ms, " << m_popInMs.size() << " Chunks): p50 "
+              << percentile(m_popInMs, 50.f)
+              << "  p95 " << percentile(m_popInMs, 95.f)
+              << "  p99 " << percentile(m_popInMs, 99.f)
+              << "  max " << percentile(m_popInMs, 100.f) << std::endl;
+    float rss = peakRssMb();
+    if(rss >= 0.f) {
+        std::cout << "Peak RSS: " << rss << " MB" << std::endl;
+    } else {
+        std::cout << "Peak RSS: n/a" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
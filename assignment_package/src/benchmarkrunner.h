@@ -0,0 +1,60 @@
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include "glm_includes.h"
+#include "scene/player.h"
+#include "scene/terrain.h"
+#include <QElapsedTimer>
+#include <unordered_map>
+#include <vector>
+
+// Flies the Player's camera along a fixed spline through the world while
+// the real streaming and rendering paths run, then reports the frame times,
+// how long Chunks took to appear once in view, and the peak resident memory.
+// Started by --benchmark, usually under Qt's offscreen platform
+// (see main.cpp for what that still needs).
+class BenchmarkRunner
+{
+private:
+    enum State { WAITING, RUNNING, FINISHED };
+    State m_state;
+    float m_speed;                  // Blocks per second along the path
+    std::vector<glm::vec3> m_path;  // Control points of the Catmull-Rom spline, in world space
+    std::vector<float> m_pathLengths; // Distance along the path at the end of each segment
+    float m_distance;               // Flown so far
+    bool m_framePending;            // Has the last advance() been drawn yet?
+
+    QElapsedTimer m_clock;
+    qint64 m_lastFrameNs;
+    std::vector<float> m_frameMs;
+    // Chunks within the view radius, keyed by toKey(), with when each came
+    // into view, or -1 once it has been drawn
+    std::unordered_map<int64_t, qint64> m_chunksInView;
+    std::vector<float> m_popInMs;
+
+    glm::vec3 pointOnSegment(int segment, float t) const;
+    glm::vec3 pointAt(float distance) const;
+
+public:
+    BenchmarkRunner();
+
+    // Lays the path out around the given point and starts the clock
+    void start(glm::vec3 origin, float speed);
+    bool isRunning() const;
+    bool isFinished() const;
+    // MyGL ticks once per drawn frame while the benchmark runs
+    bool isFramePending() const;
+
+    // Moves the Player dT seconds further along the path.
+    // Returns false, and finishes, once the end is reached.
+    bool advance(float dT, Player &player);
+    // Notes which Chunks within the given radius of pos came into view or were drawn this tick
+    void trackChunks(const Terrain &terrain, glm::vec3 pos, int radius);
+    // Call at the end of each paintGL
+    void frameDone();
+
+    // Prints the results to stdout
+    void printReport() const;
+};
+
+#endif // BENCHMARKRUNNER_H
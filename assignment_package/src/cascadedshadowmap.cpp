@@ -0,0 +1,95 @@
+#include "cascadedshadowmap.h"
+#include "scene/camera.h"
+
+// Blend between logarithmic (1) and uniform (0) split placement
+#define CASCADE_SPLIT_LAMBDA 0.75f
+
+static_assert(SHADOW_CASCADE_COUNT == 3, "The cascade splits are stored in a vec3");
+
+namespace {
+// Per-cascade settings, from nearest to farthest
+const unsigned int CASCADE_RESOLUTION[SHADOW_CASCADE_COUNT] = {1024, 1024, 2048};
+const int CASCADE_UPDATE_INTERVAL[SHADOW_CASCADE_COUNT] = {1, 2, 4};
+const int CASCADE_AMORTIZE_FRAMES[SHADOW_CASCADE_COUNT] = {1, 1, 2};
+}
+
+CascadedShadowMap::CascadedShadowMap(OpenGLContext *context, int drawRadius)
+    : m_cascades(), m_splits(0.f), m_shadowDistance(drawRadius)
+{
+    for(int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        m_cascades.push_back(mkU<ShadowMapCache>(context, CASCADE_RESOLUTION[i], drawRadius,
+                                                 CASCADE_AMORTIZE_FRAMES[i], CASCADE_UPDATE_INTERVAL[i]));
+    }
+}
+
+void CascadedShadowMap::create() {
+    for(uPtr<ShadowMapCache> &cascade : m_cascades) {
+        cascade->create();
+    }
+}
+
+void CascadedShadowMap::destroy() {
+    for(uPtr<ShadowMapCache> &cascade : m_cascades) {
+        cascade->destroy();
+    }
+}
+
+void CascadedShadowMap::notifyChunkRemeshed(glm::ivec2 chunkOrigin) {
+    for(uPtr<ShadowMapCache> &cascade : m_cascades) {
+        cascade->notifyChunkRemeshed(chunkOrigin);
+    }
+}
+
+void CascadedShadowMap::update(glm::vec3 sunDir, const Camera &camera, glm::vec3 playerPos,
+                               Terrain &terrain, ShadowShader &shader) {
+    float nearClip = camera.getNearClip();
+    for(int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        // The "practical" split scheme: logarithmic splits keep texel
+        // density even with depth, uniform ones stop the first cascade
+        // from being uselessly small
+        float t = (i + 1) / float(SHADOW_CASCADE_COUNT);
+        float logSplit = nearClip * glm::pow(m_shadowDistance / nearClip, t);
+        float uniformSplit = nearClip + (m_shadowDistance - nearClip) * t;
+        m_splits[i] = glm::mix(uniformSplit, logSplit, CASCADE_SPLIT_LAMBDA);
+    }
+
+    for(int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        float sliceNear = i == 0 ? nearClip : m_splits[i - 1];
+        glm::mat4 invViewProj = glm::inverse(camera.getViewProj(sliceNear, m_splits[i]));
+
+        // Bound this slice of the frustum with a sphere. Unlike a box,
+        // its size does not change as the camera turns.
+        glm::vec3 corners[8];
+        glm::vec3 center(0.f);
+        for(int c = 0; c < 8; c++) {
+            glm::vec4 ndc((c & 1) ? 1.f : -1.f, (c & 2) ? 1.f : -1.f, (c & 4) ? 1.f : -1.f, 1.f);
+            glm::vec4 world = invViewProj * ndc;
+            corners[c] = glm::vec3(world) / world.w;
+            center += corners[c] / 8.f;
+        }
+        float radius = 0.f;
+        for(int c = 0; c < 8; c++) {
+            radius = glm::max(radius, glm::length(corners[c] - center));
+        }
+
+        m_cascades[i]->update(sunDir, center, radius, playerPos, terrain, shader);
+    }
+}
+
+std::array<glm::mat4, SHADOW_CASCADE_COUNT> CascadedShadowMap::getDepthBiasMVPs() const {
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> mvps;
+    for(int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        mvps[i] = m_cascades[i]->getDepthBiasMVP();
+    }
+    return mvps;
+}
+
+glm::vec3 CascadedShadowMap::getSplits() const {
+    return m_splits;
+}
+
+void CascadedShadowMap::bindToTextureSlots() {
+    for(int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        m_cascades[i]->bindToTextureSlot(SHADOW_CASCADE_SLOTS[i]);
+    }
+}
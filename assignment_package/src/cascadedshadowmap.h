@@ -0,0 +1,39 @@
+#ifndef CASCADEDSHADOWMAP_H
+#define CASCADEDSHADOWMAP_H
+
+#include "shadowmapcache.h"
+#include "shaderprogram.h"
+#include <array>
+
+class Camera;
+
+// Splits the camera's frustum, out to the edge of the loaded Chunks, into
+// SHADOW_CASCADE_COUNT depth ranges and gives each its own cached shadow map
+// fitted to the bounding sphere of that range. Near cascades are small and
+// sharp; far ones cover more ground and are checked for updates less often.
+class CascadedShadowMap
+{
+private:
+    std::vector<uPtr<ShadowMapCache>> m_cascades;
+    // View-space depth at which each cascade ends
+    glm::vec3 m_splits;
+    float m_shadowDistance;
+
+public:
+    CascadedShadowMap(OpenGLContext *context, int drawRadius);
+
+    void create();
+    void destroy();
+
+    void notifyChunkRemeshed(glm::ivec2 chunkOrigin);
+    // Refits the cascades to the camera and re-renders the stale ones
+    void update(glm::vec3 sunDir, const Camera &camera, glm::vec3 playerPos,
+                Terrain &terrain, ShadowShader &shader);
+
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> getDepthBiasMVPs() const;
+    glm::vec3 getSplits() const;
+    // Binds each cascade to its slot in SHADOW_CASCADE_SLOTS
+    void bindToTextureSlots();
+};
+
+#endif // CASCADEDSHADOWMAP_H
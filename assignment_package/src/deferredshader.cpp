@@ -0,0 +1,23 @@
+#include "deferredshader.h"
+
+DeferredShader::DeferredShader(OpenGLContext *context)
+    : PostProcessShader(context),
+      unifAlbedo(-1), unifNormal(-1), unifDepth(-1)
+{}
+
+DeferredShader::~DeferredShader()
+{}
+
+void DeferredShader::setupMemberVars()
+{
+    PostProcessShader::setupMemberVars();
+    unifAlbedo = context->glGetUniformLocation(prog, "u_Albedo");
+    unifNormal = context->glGetUniformLocation(prog, "u_Normal");
+    unifDepth  = context->glGetUniformLocation(prog, "u_Depth");
+
+    // The G-buffer always lives in the same slots, so set them once
+    useMe();
+    context->glUniform1i(unifAlbedo, GBUFFER_ALBEDO_SLOT);
+    context->glUniform1i(unifNormal, GBUFFER_NORMAL_SLOT);
+    context->glUniform1i(unifDepth, GBUFFER_DEPTH_SLOT);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "postprocessshader.h"
+
+// Texture slots the G-buffer is bound to for the lighting pass.
+// Slots 0 to 4 hold the block texture, the shadow cascades and the post-process input.
+#define GBUFFER_ALBEDO_SLOT 5
+#define GBUFFER_NORMAL_SLOT 6
+#define GBUFFER_DEPTH_SLOT 7
+
+// The full-screen lighting pass of the deferred path.
+// Reads the G-buffer from the slots above and the shadow cascades
+// from SHADOW_CASCADE_SLOTS, and writes the lit color and the
+// G-buffer's depth into whichever frame buffer is bound.
+class DeferredShader : public PostProcessShader
+{
+public:
+    int unifAlbedo; // A handle to the "uniform" sampler2D of the G-buffer's albedo
+    int unifNormal; // A handle to the "uniform" sampler2D of the G-buffer's normals
+    int unifDepth;  // A handle to the "uniform" sampler2D of the G-buffer's depth
+
+public:
+    DeferredShader(OpenGLContext* context);
+    virtual ~DeferredShader();
+
+    // Sets up shader-specific handles and points the G-buffer samplers at their slots
+    void setupMemberVars() override;
+};
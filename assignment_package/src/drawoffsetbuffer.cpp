@@ -0,0 +1,78 @@
+#include "drawoffsetbuffer.h"
+#include <QOpenGLContext>
+
+DrawOffsetBuffer::DrawOffsetBuffer(OpenGLContext *context)
+    : mp_context(context), m_offsets(), m_buffer(0), m_created(false),
+      m_attr(-1), m_drawBaseInstance(nullptr)
+{}
+
+void DrawOffsetBuffer::destroy() {
+    if(m_created) {
+        m_created = false;
+        mp_context->glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+void DrawOffsetBuffer::clear() {
+    m_offsets.clear();
+}
+
+int DrawOffsetBuffer::add(glm::ivec2 offset) {
+    m_offsets.push_back(offset);
+    return static_cast<int>(m_offsets.size()) - 1;
+}
+
+void DrawOffsetBuffer::upload() {
+    if(!m_created) {
+        mp_context->glGenBuffers(1, &m_buffer);
+        m_created = true;
+        // Core in 4.2, and available to our 4.0 context only through ARB_base_instance
+        QOpenGLContext *ctx = mp_context->context();
+        QSurfaceFormat format = ctx->format();
+        if(format.majorVersion() > 4 || (format.majorVersion() == 4 && format.minorVersion() >= 2) ||
+           ctx->hasExtension(QByteArray("GL_ARB_base_instance"))) {
+            m_drawBaseInstance = reinterpret_cast<DrawElementsInstancedBaseInstance>(
+                        ctx->getProcAddress("glDrawElementsInstancedBaseInstance"));
+        }
+    }
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    // Respecifying the whole store lets the driver hand us fresh memory
+    // instead of waiting on draws that still read last frame's offsets
+    mp_context->glBufferData(GL_ARRAY_BUFFER, m_offsets.size() * sizeof(glm::ivec2), m_offsets.data(), GL_STREAM_DRAW);
+}
+
+void DrawOffsetBuffer::beginPass(int attr) {
+    m_attr = attr;
+    if(m_attr == -1) {
+        return;
+    }
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    mp_context->glEnableVertexAttribArray(m_attr);
+    mp_context->glVertexAttribIPointer(m_attr, 2, GL_INT, sizeof(glm::ivec2), nullptr);
+    // Every vertex of a draw's single instance reads the same entry
+    mp_context->glVertexAttribDivisor(m_attr, 1);
+}
+
+void DrawOffsetBuffer::drawElements(GLenum mode, GLsizei count, int drawIdx) {
+    if(m_attr == -1) {
+        mp_context->glDrawElements(mode, count, GL_UNSIGNED_INT, nullptr);
+    } else if(m_drawBaseInstance) {
+        m_drawBaseInstance(mode, count, GL_UNSIGNED_INT, nullptr, 1, static_cast<GLuint>(drawIdx));
+    } else {
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        mp_context->glVertexAttribIPointer(m_attr, 2, GL_INT, sizeof(glm::ivec2), (void*) (drawIdx * sizeof(glm::ivec2)));
+        mp_context->glDrawElementsInstanced(mode, count, GL_UNSIGNED_INT, nullptr, 1);
+    }
+}
+
+void DrawOffsetBuffer::endPass() {
+    if(m_attr != -1) {
+        mp_context->glVertexAttribDivisor(m_attr, 0);
+        mp_context->glDisableVertexAttribArray(m_attr);
+        m_attr = -1;
+    }
+}
+
+int DrawOffsetBuffer::size() const {
+    return static_cast<int>(m_offsets.size());
+}
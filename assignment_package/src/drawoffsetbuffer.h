@@ -0,0 +1,51 @@
+#ifndef DRAWOFFSETBUFFER_H
+#define DRAWOFFSETBUFFER_H
+
+#include "openglcontext.h"
+#include "glm_includes.h"
+#include <vector>
+
+// The world-space XZ origins of every Chunk (or far tile) drawn in one pass,
+// uploaded together before the pass begins. Each draw then reads its own
+// origin through an instanced ivec2 attribute that is set up once for the
+// whole pass, so no uniform or attribute state changes between draws.
+// A draw selects its entry as its base instance. GL 4.0 only has
+// base-instance draws through ARB_base_instance; without it, each draw
+// re-points the attribute at its entry instead.
+class DrawOffsetBuffer
+{
+private:
+    typedef void (QOPENGLF_APIENTRYP DrawElementsInstancedBaseInstance)(GLenum mode, GLsizei count, GLenum type,
+                                                                         const void *indices, GLsizei instancecount,
+                                                                         GLuint baseinstance);
+
+    OpenGLContext *mp_context;
+    std::vector<glm::ivec2> m_offsets;
+    GLuint m_buffer;
+    bool m_created;
+    // The attribute the current pass reads its offsets through, or -1
+    int m_attr;
+    // glDrawElementsInstancedBaseInstance, or nullptr if the driver lacks it
+    DrawElementsInstancedBaseInstance m_drawBaseInstance;
+
+public:
+    DrawOffsetBuffer(OpenGLContext *context);
+
+    void destroy();
+    // Forgets the offsets of the previous pass
+    void clear();
+    // Records the origin of the next draw and returns its draw index
+    int add(glm::ivec2 offset);
+    // Sends every recorded offset to the GPU
+    void upload();
+    // Points the given integer attribute (-1 for none) at the
+    // offsets for every draw until endPass(). Call after upload().
+    void beginPass(int attr);
+    // Draws count indices of the bound index buffer, reading entry drawIdx
+    void drawElements(GLenum mode, GLsizei count, int drawIdx);
+    // Restores the attribute to non-instanced, disabled state
+    void endPass();
+    int size() const;
+};
+
+#endif // DRAWOFFSETBUFFER_H
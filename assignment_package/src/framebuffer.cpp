@@ -3,49 +3,80 @@
 
 FrameBuffer::FrameBuffer(OpenGLContext *context,
                          unsigned int width, unsigned int height, unsigned int devicePixelRatio)
+    : FrameBuffer(context, width, height, devicePixelRatio, {GL_RGB}, false)
+{}
+
+FrameBuffer::FrameBuffer(OpenGLContext *context,
+                         unsigned int width, unsigned int height, unsigned int devicePixelRatio,
+                         const std::vector<GLenum> &colorFormats, bool depthTexture)
     : mp_context(context), m_frameBuffer(-1),
       m_outputTexture(-1), m_depthRenderBuffer(-1),
+      m_colorFormats(colorFormats), m_colorTextures(), m_depthTexture(depthTexture),
       m_width(width), m_height(height), m_devicePixelRatio(devicePixelRatio), m_created(false)
 {}
 
 void FrameBuffer::resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio) {
+    bool changed = width != m_width || height != m_height || devicePixelRatio != m_devicePixelRatio;
     m_width = width;
     m_height = height;
     m_devicePixelRatio = devicePixelRatio;
+    if(m_created && changed) {
+        destroy();
+        create();
+    }
 }
 
 void FrameBuffer::create() {
+    unsigned int w = m_width * m_devicePixelRatio;
+    unsigned int h = m_height * m_devicePixelRatio;
     // Initialize the frame buffers and render textures
     mp_context->glGenFramebuffers(1, &m_frameBuffer);
-    mp_context->glGenTextures(1, &m_outputTexture);
-    mp_context->glGenRenderbuffers(1, &m_depthRenderBuffer);
+    m_colorTextures.resize(m_colorFormats.size());
+    mp_context->glGenTextures(m_colorTextures.size(), m_colorTextures.data());
+    m_outputTexture = m_colorTextures[0];
 
     mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
-    // Bind our texture so that all functions that deal with textures will interact with this one
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
-    // Give an empty image to OpenGL ( the last "0" )
-    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
-
-    // Set the render settings for the texture we've just created.
-    // Essentially zero filtering on the "texture" so it appears exactly as rendered
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    // Clamp the colors at the edge of our texture
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Initialize our depth buffer
-    mp_context->glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
-    mp_context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
-    mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
-
-    // Set m_renderedTexture as the color output of our frame buffer
-    mp_context->glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_outputTexture, 0);
-
-    // Sets the color output of the fragment shader to be stored in GL_COLOR_ATTACHMENT0,
-    // which we previously set to m_renderedTexture
-    GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-    mp_context->glDrawBuffers(1, drawBuffers); // "1" is the size of drawBuffers
+    std::vector<GLenum> drawBuffers;
+    for(unsigned int i = 0; i < m_colorTextures.size(); i++) {
+        // Bind our texture so that all functions that deal with textures will interact with this one
+        mp_context->glBindTexture(GL_TEXTURE_2D, m_colorTextures[i]);
+        // Give an empty image to OpenGL ( the last "0" )
+        mp_context->glTexImage2D(GL_TEXTURE_2D, 0, m_colorFormats[i], w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+
+        // Set the render settings for the texture we've just created.
+        // Essentially zero filtering on the "texture" so it appears exactly as rendered
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        // Clamp the colors at the edge of our texture
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // Set the texture as color output i of our frame buffer
+        mp_context->glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, m_colorTextures[i], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+
+    if(m_depthTexture) {
+        // A float depth texture, so a later pass can rebuild positions from it precisely
+        mp_context->glGenTextures(1, &m_depthRenderBuffer);
+        mp_context->glBindTexture(GL_TEXTURE_2D, m_depthRenderBuffer);
+        mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        mp_context->glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthRenderBuffer, 0);
+    } else {
+        // Initialize our depth buffer
+        mp_context->glGenRenderbuffers(1, &m_depthRenderBuffer);
+        mp_context->glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
+        mp_context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, w, h);
+        mp_context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
+    }
+
+    // Sets the color outputs of the fragment shader to be stored in
+    // GL_COLOR_ATTACHMENT0 onwards, which we previously set to our textures
+    mp_context->glDrawBuffers(drawBuffers.size(), drawBuffers.data());
 
     m_created = true;
     if(mp_context->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
@@ -60,8 +91,12 @@ void FrameBuffer::destroy() {
     if(m_created) {
         m_created = false;
         mp_context->glDeleteFramebuffers(1, &m_frameBuffer);
-        mp_context->glDeleteTextures(1, &m_outputTexture);
-        mp_context->glDeleteRenderbuffers(1, &m_depthRenderBuffer);
+        mp_context->glDeleteTextures(m_colorTextures.size(), m_colorTextures.data());
+        if(m_depthTexture) {
+            mp_context->glDeleteTextures(1, &m_depthRenderBuffer);
+        } else {
+            mp_context->glDeleteRenderbuffers(1, &m_depthRenderBuffer);
+        }
     }
 }
 
@@ -75,6 +110,16 @@ void FrameBuffer::bindToTextureSlot(unsigned int slot) {
     mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
 }
 
+void FrameBuffer::bindColorToTextureSlot(unsigned int i, unsigned int slot) {
+    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
+    mp_context->glBindTexture(GL_TEXTURE_2D, m_colorTextures[i]);
+}
+
+void FrameBuffer::bindDepthToTextureSlot(unsigned int slot) {
+    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
+    mp_context->glBindTexture(GL_TEXTURE_2D, m_depthRenderBuffer);
+}
+
 unsigned int FrameBuffer::getTextureSlot() const {
     return m_textureSlot;
 }
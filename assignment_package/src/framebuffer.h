@@ -1,6 +1,7 @@
 #pragma once
 #include "openglcontext.h"
 #include "glm_includes.h"
+#include <vector>
 
 // A class representing a frame buffer in the OpenGL pipeline.
 // Stores three GPU handles: one to a frame buffer object, one to
@@ -12,12 +13,18 @@
 // from the frame buffer's output texture by invoking
 // bindToTextureSlot() and then associating a ShaderProgram's
 // sampler2d with the appropriate texture slot.
+// A FrameBuffer may instead be given several color formats, one
+// texture per GL_COLOR_ATTACHMENTi, and a depth texture in place of
+// the depth render buffer, e.g. to serve as a G-buffer.
 class FrameBuffer {
 private:
     OpenGLContext *mp_context;
     GLuint m_frameBuffer;
     GLuint m_outputTexture;
-    GLuint m_depthRenderBuffer;
+    GLuint m_depthRenderBuffer; // Holds the depth texture instead when m_depthTexture is set
+    std::vector<GLenum> m_colorFormats; // Internal format of each color attachment
+    std::vector<GLuint> m_colorTextures; // Every attachment's texture; m_outputTexture is the first
+    bool m_depthTexture; // Whether depth is stored in a sampleable texture
 
     unsigned int m_width, m_height, m_devicePixelRatio;
     bool m_created;
@@ -26,8 +33,10 @@ private:
 
 public:
     FrameBuffer(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+    FrameBuffer(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio,
+                const std::vector<GLenum> &colorFormats, bool depthTexture);
     // Make sure to call resize from MyGL::resizeGL to keep your frame buffer up to date with
-    // your screen dimensions
+    // your screen dimensions. Already created buffers are recreated at the new size.
     void resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio);
     // Initialize all GPU-side data required
     void create();
@@ -36,5 +45,10 @@ public:
     void bindFrameBuffer();
     // Associate our output texture with the indicated texture slot
     void bindToTextureSlot(unsigned int slot);
+    // Associate the texture of color attachment i with the indicated texture slot
+    void bindColorToTextureSlot(unsigned int i, unsigned int slot);
+    // Associate the depth texture with the indicated texture slot.
+    // Only valid when the FrameBuffer was created with a depth texture.
+    void bindDepthToTextureSlot(unsigned int slot);
     unsigned int getTextureSlot() const;
 };
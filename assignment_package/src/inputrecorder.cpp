@@ -0,0 +1,122 @@
+#include "inputrecorder.h"
+#include <cstdint>
+#include <iostream>
+
+// "MMIR" followed by the format version
+#define INPUT_RECORDER_MAGIC 0x52494d4d
+#define INPUT_RECORDER_VERSION 1
+
+namespace {
+template<typename T>
+void writeValue(std::ofstream &out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::ifstream &in, T *value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+// The order of InputBundle's flags in a record's bits
+bool InputBundle::* const BUTTONS[] = {
+    &InputBundle::wPressed, &InputBundle::aPressed, &InputBundle::sPressed, &InputBundle::dPressed,
+    &InputBundle::ePressed, &InputBundle::qPressed, &InputBundle::upPressed, &InputBundle::downPressed,
+    &InputBundle::rightPressed, &InputBundle::leftPressed, &InputBundle::spacePressed, &InputBundle::flightMode,
+    &InputBundle::leftClicked, &InputBundle::rightClicked
+};
+}
+
+InputRecorder::InputRecorder()
+    : m_mode(IDLE), m_out(), m_in(), m_ticks(0)
+{}
+
+bool InputRecorder::startRecording(const std::string &path) {
+    stop();
+    m_out.open(path, std::ios::binary | std::ios::trunc);
+    if(!m_out) {
+        std::cout << "Could not record input to " << path << std::endl;
+        return false;
+    }
+    writeValue<uint32_t>(m_out, INPUT_RECORDER_MAGIC);
+    writeValue<uint32_t>(m_out, INPUT_RECORDER_VERSION);
+    m_mode = RECORDING;
+    return true;
+}
+
+bool InputRecorder::startReplay(const std::string &path) {
+    stop();
+    m_in.open(path, std::ios::binary);
+    uint32_t magic = 0, version = 0;
+    if(!m_in || !readValue(m_in, &magic) || !readValue(m_in, &version)
+            || magic != INPUT_RECORDER_MAGIC || version != INPUT_RECORDER_VERSION) {
+        std::cout << "Could not replay input from " << path << std::endl;
+        m_in.close();
+        return false;
+    }
+    m_mode = REPLAYING;
+    return true;
+}
+
+void InputRecorder::stop() {
+    if(m_out.is_open()) {
+        m_out.close();
+    }
+    if(m_in.is_open()) {
+        m_in.close();
+    }
+    m_mode = IDLE;
+    m_ticks = 0;
+}
+
+bool InputRecorder::isRecording() const {
+    return m_mode == RECORDING;
+}
+
+bool InputRecorder::isReplaying() const {
+    return m_mode == REPLAYING;
+}
+
+int InputRecorder::ticks() const {
+    return m_ticks;
+}
+
+void InputRecorder::record(const InputBundle &inputs, float dT, BlockType selectedBlock) {
+    if(m_mode != RECORDING) {
+        return;
+    }
+    uint16_t buttons = 0;
+    for(unsigned int i = 0; i < sizeof(BUTTONS) / sizeof(BUTTONS[0]); i++) {
+        if(inputs.*BUTTONS[i]) {
+            buttons |= 1 << i;
+        }
+    }
+    writeValue<float>(m_out, dT);
+    writeValue<uint16_t>(m_out, buttons);
+    writeValue<float>(m_out, inputs.mouseX);
+    writeValue<float>(m_out, inputs.mouseY);
+    writeValue<uint8_t>(m_out, static_cast<uint8_t>(selectedBlock));
+    writeValue<uint8_t>(m_out, 0); // Pads the record to 16 bytes
+    m_ticks++;
+}
+
+bool InputRecorder::replay(InputBundle *inputs, float *dT, BlockType *selectedBlock) {
+    if(m_mode != REPLAYING) {
+        return false;
+    }
+    float recordedDT, mouseX, mouseY;
+    uint16_t buttons;
+    uint8_t block, padding;
+    if(!readValue(m_in, &recordedDT) || !readValue(m_in, &buttons) || !readValue(m_in, &mouseX)
+            || !readValue(m_in, &mouseY) || !readValue(m_in, &block) || !readValue(m_in, &padding)) {
+        return false;
+    }
+    for(unsigned int i = 0; i < sizeof(BUTTONS) / sizeof(BUTTONS[0]); i++) {
+        inputs->*BUTTONS[i] = (buttons >> i) & 1;
+    }
+    inputs->mouseX = mouseX;
+    inputs->mouseY = mouseY;
+    *dT = recordedDT;
+    *selectedBlock = static_cast<BlockType>(block);
+    m_ticks++;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include "scene/entity.h"
+#include "scene/chunk.h"
+#include <fstream>
+#include <string>
+
+// Logs the Player's input to a file one simulation step at a time, or reads
+// it back to drive the Player without the user, so two runs follow the same path.
+// The file is a small header then one 16-byte record per step: its dT,
+// the held controls as bits, the mouse turn in degrees, the clicks and
+// the selected block. It is written in the host's byte order.
+class InputRecorder
+{
+private:
+    enum Mode { IDLE, RECORDING, REPLAYING };
+    Mode m_mode;
+    std::ofstream m_out;
+    std::ifstream m_in;
+    int m_ticks; // Recorded or replayed so far
+
+public:
+    InputRecorder();
+
+    // Both return false, and leave the recorder idle, if the file can not be used
+    bool startRecording(const std::string &path);
+    bool startReplay(const std::string &path);
+    void stop();
+
+    bool isRecording() const;
+    bool isReplaying() const;
+    int ticks() const;
+
+    // Appends one tick
+    void record(const InputBundle &inputs, float dT, BlockType selectedBlock);
+    // Overwrites the given input with the next recorded tick.
+    // Returns false once the recording has run out.
+    bool replay(InputBundle *inputs, float *dT, BlockType *selectedBlock);
+};
+
+#endif // INPUTRECORDER_H
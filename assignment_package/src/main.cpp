@@ -1,4 +1,6 @@
 #include <mainwindow.h>
+#include "runoptions.h"
+#include "scene/spatialhash.h"
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -21,7 +23,21 @@ void debugFormatVersion()
 
 int main(int argc, char *argv[])
 {
+    // Qt's offscreen platform keeps the benchmark's window off screen. Its GL
+    // context still comes from GLX, so an X server is needed all the same:
+    // on a headless machine run under Xvfb, e.g. xvfb-run with Mesa's llvmpipe
+    if ((RunOptions::hasFlag(argc, argv, "--benchmark") || RunOptions::hasFlag(argc, argv, "--spatial-benchmark"))
+            && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication a(argc, argv);
+    if (!RunOptions::current().parse(argc, argv)) {
+        return 1;
+    }
+    if (RunOptions::current().spatialBenchmark > 0) {
+        benchmarkSpatialHash(RunOptions::current().spatialBenchmark);
+        return 0;
+    }
 
     // Set OpenGL 4.0 and, optionally, 4-sample multisampling
     QSurfaceFormat format;
@@ -4,21 +4,34 @@
 #include <iostream>
 #include <QApplication>
 #include <QKeyEvent>
+#include "runoptions.h"
 #define RENDERING_RADIUS 96
 #define SUN_VELOCITY 1 / 20000.f
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_geomQuad(this),
-      m_frameBuffer(this, width(), height(), devicePixelRatio()),m_shadowFrameBuffer(this, width(), height(), devicePixelRatio()),
+      m_postChain(this, width(), height(), devicePixelRatio()),
+      m_gBuffer(this, width(), height(), devicePixelRatio(), {GL_RGBA8, GL_RGBA8}, true),
+      m_skyCube(this, 256),
+      m_shadowMap(this, RENDERING_RADIUS + 16),
       m_shadowShader(this),m_worldAxes(this),
-      m_progLambert(this), m_progFlat(this), m_progInstanced(this),
-      m_postNoOp(this), m_postBlueTint(this), m_postRedTint(this), m_progSky(this),
-      openInventory(false), numGrass(10), numDirt(10), numStone(10), numBedrock(10), numWater(10),
-      numLava(10), numSnow(10), currBlockType(GRASS),
-      m_terrain(this), m_player(glm::vec3(48.f, 150.f, 48.f), m_terrain),m_texture(this), m_time(0),
-      prevFrame(QDateTime::currentMSecsSinceEpoch()), currFrame(QDateTime::currentMSecsSinceEpoch())
+      m_progLambert(this), m_progFlat(this), m_progInstanced(this), m_progSky(this), m_progSkyBox(this),
+      m_progGBuffer(this), m_progDeferred(this), m_perFrameUniforms(this, PER_FRAME_UBO_BINDING),
+      m_chunkUploader(), m_terrain(this), m_farTerrain(this), m_player(glm::vec3(48.f, 150.f, 48.f), m_terrain),
+      m_entityMeshes(), m_entityOffsets(), m_entityColors(),
+      m_renderCamera(m_player.mcr_camera), m_viewPos(m_player.mcr_position), m_inputsLock(), m_texture(this), m_time(0),
+      m_postUnderwater(-1), m_postUnderLava(-1),
+      m_deferred(false),
+      prevFrame(QDateTime::currentMSecsSinceEpoch()), currFrame(QDateTime::currentMSecsSinceEpoch()),
+      m_lastExpansionPos(m_player.mcr_position),
+      m_entities(), m_entitiesToSpawn(RunOptions::current().entities), m_fluids(), m_lighting(), m_expansionPlanned(false), m_snapshots(),
+      m_startupTimer(), m_spawnResident(false), m_firstFrameLogged(false),
+      m_simulation([this]() { return simulate(); }),
+      openInventory(false), numGrass(10), numDirt(10), numStone(10), numWater(10),
+      numLava(10), numBedrock(10), numSnow(10), currBlockType(GRASS)
 {
+    m_startupTimer.start();
     // Connect the timer to a function so that when the timer ticks the function is executed
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
     // Tell the timer to redraw 60 times per second
@@ -27,12 +40,50 @@ MyGL::MyGL(QWidget *parent)
 
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
     setCursor(Qt::BlankCursor); // Make the cursor invisible
+
+    const RunOptions &options = RunOptions::current();
+    if (!options.replayPath.empty() && m_inputRecorder.startReplay(options.replayPath)) {
+        std::cout << "Replaying input from " << options.replayPath << std::endl;
+    } else if (!options.recordPath.empty() && m_inputRecorder.startRecording(options.recordPath)) {
+        std::cout << "Recording input to " << options.recordPath << std::endl;
+    }
+    // The profiler is off unless toggled with F3, but benchmarks and replays are there to be measured
+    if (options.benchmark || m_inputRecorder.isReplaying()) {
+        Profiler::instance().setEnabled(true);
+    }
+    // Queues the spawn area's terrain and gives the first frame a camera
+    publishStep(false);
+    if (options.benchmark) {
+        // Tick as soon as the last frame has been drawn, rather than at 60 Hz.
+        // The path is flown in tick() instead of on the simulation thread.
+        m_timer.start(0);
+    } else {
+        m_simulation.start();
+    }
 }
 
 MyGL::~MyGL() {
+    m_simulation.stop();
+    m_inputRecorder.stop();
+    m_terrain.setUploader(nullptr);
+    m_chunkUploader.stop();
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
-    m_frameBuffer.destroy();
+    m_postChain.destroy();
+    m_gBuffer.destroy();
+    m_skyCube.destroy();
+    Profiler::instance().destroy();
+    m_shadowMap.destroy();
+    m_shadowShader.destroy();
+    m_terrain.destroy();
+    m_farTerrain.destroy();
+    m_perFrameUniforms.destroy();
+    m_texture.destroy();
+    for (uPtr<Cube> &mesh : m_entityMeshes) {
+        mesh->destroyVBOdata();
+        mesh->clearOffsetBuf();
+        mesh->clearColorBuf();
+    }
 }
 
 
@@ -54,6 +105,8 @@ void MyGL::initializeGL()
     glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Filter the sky across the edges of its cubemap's faces
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
     // Set the color with which the screen is filled at the start of each render call.
     glClearColor(0.37f, 0.74f, 1.0f, 1);
 
@@ -64,11 +117,17 @@ void MyGL::initializeGL()
 
     //Create the instance of the world axes
     m_worldAxes.createVBOdata();
+    m_perFrameUniforms.create(sizeof(PerFrameUniforms));
     // Create and set up the diffuse shader
     m_shadowShader.create(":/glsl/shadow.vert.glsl", ":/glsl/shadow.frag.glsl");
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
     // Create and set up the flat lighting shader
     m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
+    m_progInstanced.create(":/glsl/instanced.vert.glsl", ":/glsl/instanced.frag.glsl");
+    for (int kind = 0; kind < ENTITY_KIND_COUNT; ++kind) {
+        m_entityMeshes.push_back(mkU<Cube>(this, entityKindMin(EntityKind(kind)), entityKindMax(EntityKind(kind))));
+        m_entityMeshes.back()->createVBOdata();
+    }
     initializeTexture();
     // Set a color with which to draw geometry.
     // This will ultimately not be used when you change
@@ -76,17 +135,25 @@ void MyGL::initializeGL()
     // and UV coordinates
     m_progLambert.setGeometryColor(glm::vec4(0,1,0,1));
 
-    m_postNoOp.create(":/glsl/passthrough.vert.glsl", ":/glsl/noOp.frag.glsl");
-    m_postNoOp.setupMemberVars();
-    m_postBlueTint.create(":/glsl/passthrough.vert.glsl", ":/glsl/post_blue_tinge.frag.glsl");
-    m_postRedTint.create(":/glsl/passthrough.vert.glsl", ":/glsl/post_red_tinge.frag.glsl");
+    m_postUnderwater = m_postChain.addEffect(":/glsl/post_blue_tinge.glsl", true);
+    m_postUnderLava = m_postChain.addEffect(":/glsl/post_red_tinge.glsl", true);
 
     m_progSky.create(":/glsl/sky.vert.glsl", ":/glsl/sky.frag.glsl");
+    m_progSkyBox.create(":/glsl/skybox.vert.glsl", ":/glsl/skybox.frag.glsl");
+    m_progGBuffer.create(":/glsl/gbuffer.vert.glsl", ":/glsl/gbuffer.frag.glsl");
+    m_progDeferred.create(":/glsl/passthrough.vert.glsl", ":/glsl/deferred.frag.glsl");
     m_geomQuad.create();
-    m_frameBuffer = FrameBuffer(this, width(), height(), devicePixelRatio());
-    m_frameBuffer.create();
-    m_shadowFrameBuffer = ShadowFrameBuffer(this, width(), height(), devicePixelRatio());
-    m_shadowFrameBuffer.create();
+    m_postChain.resize(width(), height(), devicePixelRatio());
+    m_postChain.create();
+    m_gBuffer = FrameBuffer(this, width(), height(), devicePixelRatio(), {GL_RGBA8, GL_RGBA8}, true);
+    m_gBuffer.create();
+    m_skyCube.create();
+    Profiler::instance().create(this);
+    m_shadowMap.create();
+    if (RunOptions::current().uploadThread && m_chunkUploader.start(context())) {
+        m_terrain.setUploader(&m_chunkUploader);
+        std::cout << "Uploading Chunks on their own thread" << std::endl;
+    }
     // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
     // using multiple VAOs, we can just bind one once.
     glBindVertexArray(vao);
@@ -95,20 +162,13 @@ void MyGL::initializeGL()
 void MyGL::resizeGL(int w, int h) {
     //This code sets the concatenated view and perspective projection matrices used for
     //our scene's camera view.
-    m_player.setCameraWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
-    glm::mat4 viewproj = m_player.mcr_camera.getViewProj();
+    // The camera matrices reach the shaders through the PerFrame UBO in paintGL.
+    // Only m_renderCamera projects anything; m_player's camera belongs to the
+    // simulation thread, which only reads its pose.
+    m_renderCamera.setWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
 
-    // Upload the view-projection matrix to our shaders (i.e. onto the graphics card)
-
-    m_progLambert.setViewProjMatrix(viewproj);
-    m_progFlat.setViewProjMatrix(viewproj);
-
-    m_frameBuffer.resize(w, h, this->devicePixelRatio());
-    m_postNoOp.setDimensions(glm::ivec3(w * this->devicePixelRatio(), h * this->devicePixelRatio(), this->devicePixelRatio()));
-    m_postBlueTint.setDimensions(glm::ivec3(w * this->devicePixelRatio(), h * this->devicePixelRatio(), this->devicePixelRatio()));
-    m_postRedTint.setDimensions(glm::ivec3(w * this->devicePixelRatio(), h * this->devicePixelRatio(), this->devicePixelRatio()));
-
-    m_progSky.setViewProjMatrix(glm::inverse(viewproj));
+    m_postChain.resize(w, h, this->devicePixelRatio());
+    m_gBuffer.resize(w, h, this->devicePixelRatio());
     printGLErrorLog();
 }
 
@@ -118,22 +178,202 @@ void MyGL::resizeGL(int w, int h) {
 // all per-frame actions here, such as performing physics updates on all
 // entities in the scene.
 void MyGL::tick() {
-    float dT = (QDateTime::currentMSecsSinceEpoch() - currFrame) / 1000.f;
-    m_player.tick(dT, m_inputs);
-    currFrame = QDateTime::currentMSecsSinceEpoch();
-    m_terrain.tryExpansion(m_player.mcr_position, m_player.mcr_prevPos);
-    m_terrain.checkThreadResults();
+    if (m_benchmark.isFramePending() || m_benchmark.isFinished()) {
+        return;
+    }
+    PROFILE_SCOPE("tick");
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    float dT = (now - currFrame) / 1000.f;
+    currFrame = now;
+    if (!m_spawnResident) {
+        // Hold physics so the Player cannot fall through ground that is not there yet.
+        // Terrain streams nearest-first, so this only waits on the spawn area.
+        m_spawnResident = m_terrain.initialTerrainDoneLoading(m_snapshots.read().playerPos);
+        if (m_spawnResident) {
+            std::cout << "Spawn area resident after " << m_startupTimer.elapsed() << " ms" << std::endl;
+        }
+    }
+    if (m_spawnResident && RunOptions::current().benchmark) {
+        if (!m_benchmark.isRunning()) {
+            m_benchmark.start(m_player.mcr_position, RunOptions::current().benchmarkSpeed);
+        }
+        if (!m_benchmark.advance(dT, m_player)) {
+            finishBenchmark();
+            return;
+        }
+        stepEntities(dT);
+        m_fluids.tick(dT, &m_terrain);
+        for(glm::ivec3 p : m_fluids.takeChangedBlocks()) {
+            m_lighting.blockChanged(p);
+        }
+        // The path is flown at the frame rate, so there is nothing to interpolate
+        m_player.storePreviousPose();
+        publishStep(false);
+    }
+    if (RunOptions::current().benchmark) {
+        // There is no simulation thread to light zones as they load, and
+        // until they are lit their Chunks are not meshed, spawn area included.
+        // Only this thread adds Chunks, so the map needs no lock.
+        m_lighting.tick(&m_terrain);
+    }
+    const WorldSnapshot &snapshot = m_snapshots.read();
+    if (snapshot.finished) {
+        finishReplay();
+        return;
+    }
+    m_terrain.setFocus(snapshot.playerPos);
+    {
+        PROFILE_SCOPE("chunk uploads");
+        m_terrain.checkThreadResults();
+    }
+    for(glm::ivec2 chunk : m_terrain.takeRemeshedChunks()) {
+        m_shadowMap.notifyChunkRemeshed(chunk);
+    }
+    m_benchmark.trackChunks(m_terrain, snapshot.playerPos, RENDERING_RADIUS);
+    {
+        PROFILE_SCOPE("far terrain");
+        m_farTerrain.update(snapshot.playerPos);
+        m_farTerrain.checkThreadResults();
+    }
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
-    sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
+    sendPlayerDataToGUI(snapshot); // Updates the info in the secondary window displaying player data
     sendInventoryDataToGUI(); // Update inventory info
 }
 
-void MyGL::sendPlayerDataToGUI() const {
-    emit sig_sendPlayerPos(m_player.posAsQString());
-    emit sig_sendPlayerVel(m_player.velAsQString());
-    emit sig_sendPlayerAcc(m_player.accAsQString());
-    emit sig_sendPlayerLook(m_player.lookAsQString());
-    glm::vec2 pPos(m_player.mcr_position.x, m_player.mcr_position.z);
+bool MyGL::simulate() {
+    qint64 startNs = Profiler::instance().nowNs();
+    bool running = true;
+    if (m_spawnResident) {
+        running = simulateStep();
+    }
+    {
+        // Zones are lit as they load, spawn area included
+        QReadLocker chunksLocker(&m_terrain.chunkMapLock());
+        m_lighting.tick(&m_terrain);
+    }
+    publishStep(!running);
+    Profiler::instance().addThreadSample("simulation step", startNs, Profiler::instance().nowNs());
+    return running;
+}
+
+bool MyGL::simulateStep() {
+    float dT = SIM_TIMESTEP;
+    InputBundle inputs;
+    {
+        QMutexLocker inputsLocker(&m_inputsLock);
+        inputs = m_inputs;
+        // Held keys carry over to the next step, but turns and clicks are used up
+        m_inputs.mouseX = 0.f;
+        m_inputs.mouseY = 0.f;
+        m_inputs.leftClicked = false;
+        m_inputs.rightClicked = false;
+    }
+    // Steps are only logged once physics runs, as how long the spawn
+    // area takes to load differs from run to run
+    if (m_inputRecorder.isReplaying()) {
+        BlockType blockType = currBlockType;
+        if (!m_inputRecorder.replay(&inputs, &dT, &blockType)) {
+            return false;
+        }
+        currBlockType = blockType;
+    } else if (m_inputRecorder.isRecording()) {
+        m_inputRecorder.record(inputs, dT, currBlockType);
+    }
+    m_player.storePreviousPose();
+    // The render thread adds Chunks to the map, and waits on every reader
+    // before it does. So each stage that looks Chunks up holds the map on
+    // its own, letting finished Chunks in between them.
+    {
+        QReadLocker chunksLocker(&m_terrain.chunkMapLock());
+        applyMouseInputs(inputs);
+        m_player.tick(dT, inputs);
+    }
+    {
+        QReadLocker chunksLocker(&m_terrain.chunkMapLock());
+        stepEntities(dT);
+    }
+    {
+        QReadLocker chunksLocker(&m_terrain.chunkMapLock());
+        m_fluids.tick(dT, &m_terrain);
+    }
+    for(glm::ivec3 p : m_fluids.takeChangedBlocks()) {
+        m_lighting.blockChanged(p);
+    }
+    return true;
+}
+
+void MyGL::stepEntities(float dT) {
+    int spawnCount = m_entitiesToSpawn.exchange(0);
+    if (spawnCount > 0) {
+        m_entities.spawnAround(m_terrain, m_player.mcr_position, 48.f, spawnCount);
+    }
+    m_entities.tick(dT, m_terrain);
+}
+
+void MyGL::publishStep(bool finished) {
+    // Streaming is decided here and carried out by the render thread,
+    // which alone may touch GL and add Chunks to the map
+    ExpansionPlan plan = m_terrain.planExpansion(m_player.mcr_position, m_lastExpansionPos, !m_expansionPlanned);
+    if (!plan.zonesToLoad.isEmpty() || !plan.zonesToUnload.isEmpty()) {
+        m_terrain.queueExpansion(plan);
+    }
+    m_expansionPlanned = true;
+    m_lastExpansionPos = m_player.mcr_position;
+
+    WorldSnapshot &snapshot = m_snapshots.back();
+    snapshot.prevCamera = m_player.previousCameraPose();
+    snapshot.camera = m_player.cameraPose();
+    snapshot.stepNs = Profiler::instance().nowNs();
+    snapshot.playerPos = m_player.mcr_position;
+    snapshot.underwater = m_player.checkInWaterLow();
+    snapshot.underLava = m_player.checkInLavaLow();
+    snapshot.finished = finished;
+    snapshot.posText = m_player.posAsQString();
+    snapshot.velText = m_player.velAsQString();
+    snapshot.accText = m_player.accAsQString();
+    snapshot.lookText = m_player.lookAsQString();
+    for (int kind = 0; kind < ENTITY_KIND_COUNT; ++kind) {
+        m_entities.gatherInstances(EntityKind(kind), &snapshot.entities[kind]);
+    }
+    m_snapshots.publish();
+}
+
+void MyGL::applyMouseInputs(const InputBundle &inputs) {
+    if (inputs.mouseX != 0) {
+        m_player.rotateOnUpGlobal(inputs.mouseX);
+    }
+    if (inputs.mouseY != 0) {
+        m_player.rotateOnRightLocal(inputs.mouseY);
+    }
+    if (inputs.leftClicked) {
+        removeBlock();
+    }
+    if (inputs.rightClicked) {
+        placeBlock();
+    }
+}
+
+void MyGL::finishReplay() {
+    // The simulation thread stops itself once the replay runs out
+    m_simulation.wait();
+    std::cout << "Replay finished after " << m_inputRecorder.ticks() << " steps" << std::endl;
+    m_inputRecorder.stop();
+    exportProfile();
+    QApplication::quit();
+}
+
+void MyGL::finishBenchmark() {
+    m_benchmark.printReport();
+    exportProfile();
+    QApplication::quit();
+}
+
+void MyGL::sendPlayerDataToGUI(const WorldSnapshot &snapshot) const {
+    emit sig_sendPlayerPos(snapshot.posText);
+    emit sig_sendPlayerVel(snapshot.velText);
+    emit sig_sendPlayerAcc(snapshot.accText);
+    emit sig_sendPlayerLook(snapshot.lookText);
+    glm::vec2 pPos(snapshot.playerPos.x, snapshot.playerPos.z);
     glm::ivec2 chunk(16 * glm::ivec2(glm::floor(pPos / 16.f)));
     glm::ivec2 zone(64 * glm::ivec2(glm::floor(pPos / 64.f)));
     emit sig_sendPlayerChunk(QString::fromStdString("( " + std::to_string(chunk.x) + ", " + std::to_string(chunk.y) + " )"));
@@ -154,52 +394,78 @@ void MyGL::sendInventoryDataToGUI() const {
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
-    m_frameBuffer.bindFrameBuffer();
-    // Render on the whole framebuffer, complete from the lower left corner to the upper right
-    glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
-
-    // Clear the screen so that we only see newly drawn images
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Qt may have used its own programs since the last frame
+    resetProgramCache();
+    Profiler::instance().beginFrame();
+    PROFILE_SCOPE("paintGL");
+    const WorldSnapshot &snapshot = m_snapshots.read();
+
+    // Picked before rendering, since without an effect the
+    // scene is drawn straight to the screen
+    std::vector<int> postEffects;
+    if (snapshot.underwater)
+    {
+        postEffects.push_back(m_postUnderwater);
+    }
+    else if (snapshot.underLava)
+    {
+        postEffects.push_back(m_postUnderLava);
+    }
+    m_postChain.setActiveEffects(postEffects);
 
-    m_progLambert.setCamPos(m_player.mcr_camera.mcr_position);
-
-    m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
-    m_progLambert.setViewProjMatrix(m_player.mcr_camera.getViewProj());
-    m_progInstanced.setViewProjMatrix(m_player.mcr_camera.getViewProj());
-    m_progSky.setViewProjMatrix(glm::inverse(m_player.mcr_camera.getViewProj()));
-    m_progSky.setEye(m_player.mcr_camera.mcr_position);
-    m_progSky.setTime(m_time);
-    m_progSky.setDim(glm::vec2(this->width(), this->height()));
-    m_progLambert.setEye(m_player.mcr_camera.mcr_position);
-    m_progLambert.setTime(m_time);
     //Calculate light dir
     glm::vec3 sunDir = glm::normalize(glm::vec3(cos(m_time * SUN_VELOCITY), sin(m_time * SUN_VELOCITY), 0.f));
-    m_progLambert.setLightDir(glm::normalize(glm::vec4(sunDir,0)));
-    glm::mat4 depthProjectionMatrix = glm::ortho<float>(-128,128,-128,128,-512,512);
-    glm::vec3 cam_basepos = glm::vec3(m_player.mcr_camera.mcr_position.x,128.f,m_player.mcr_camera.mcr_position.z);
-    glm::mat4 depthViewMatrix = glm::lookAt(cam_basepos + sunDir, cam_basepos, glm::vec3(0,1,0));
-    glm::mat4 depthMVP = depthProjectionMatrix * depthViewMatrix;
-    m_shadowShader.setViewProjMatrix(depthMVP);
-    glm::mat4 biasMatrix(
-    0.5, 0.0, 0.0, 0.0,
-    0.0, 0.5, 0.0, 0.0,
-    0.0, 0.0, 0.5, 0.0,
-    0.5, 0.5, 0.5, 1.0
-    );
-    glm::mat4 depthBiasMVP = biasMatrix*depthMVP;
-    m_progLambert.setShadowViewProjMatrix(depthBiasMVP);
-    m_postBlueTint.setTime(m_time);
-    m_postRedTint.setTime(m_time);
+    // Drawn between the last two simulation steps, by how long ago the newer
+    // one finished, so motion stays smooth whether or not a step finished
+    // since the last frame
+    float alpha = glm::clamp((Profiler::instance().nowNs() - snapshot.stepNs) / float(SIM_TIMESTEP_NS), 0.f, 1.f);
+    m_renderCamera.applyPose(Pose::blend(snapshot.prevCamera, snapshot.camera, alpha));
+    m_viewPos = snapshot.playerPos;
+    const Camera &camera = m_renderCamera;
+    updateEntityInstances(snapshot, alpha);
+    {
+        PROFILE_PASS("shadow");
+        // Only does any drawing when the cached shadow map is out of date
+        m_shadowMap.update(sunDir, camera, m_viewPos, m_terrain, m_shadowShader);
+    }
+
+    // Everything the scene's programs share goes up in one upload
+    PerFrameUniforms frame;
+    frame.viewProj = camera.getViewProj();
+    frame.invViewProj = glm::inverse(frame.viewProj);
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> depthBiasMVPs = m_shadowMap.getDepthBiasMVPs();
+    std::copy(depthBiasMVPs.begin(), depthBiasMVPs.end(), frame.depthBiasMVP);
+    frame.cascadeSplits = glm::vec4(m_shadowMap.getSplits(), 0.f);
+    frame.lightDir = glm::vec4(sunDir, 0.f);
+    frame.eye = camera.mcr_position;
+    frame.time = m_time;
+    frame.dimensions = glm::vec2(this->width(), this->height());
+    frame.padding = glm::vec2(0.f);
+    m_perFrameUniforms.upload(&frame);
+
     renderTerrain();
 
-    performPostprocessRenderPass();
+    {
+        PROFILE_PASS("post-process");
+        performPostprocessRenderPass();
+    }
 
     glDisable(GL_DEPTH_TEST);
     m_progFlat.setModelMatrix(glm::mat4());
-    m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
     m_progFlat.draw(m_worldAxes);
     glEnable(GL_DEPTH_TEST);
 
+    m_benchmark.frameDone();
+
+    if (m_spawnResident && !m_firstFrameLogged) {
+        m_firstFrameLogged = true;
+        std::cout << "Time to first frame: " << m_startupTimer.elapsed() << " ms" << std::endl;
+    }
+
+    // Report roughly every five seconds while the profiler (F3) is on
+    if(Profiler::instance().isEnabled() && m_time % 300 == 0) {
+        printRenderPathTimings();
+    }
     m_time ++;
 }
 
@@ -207,62 +473,152 @@ void MyGL::paintGL() {
 // terrain that surround the player (refer to Terrain::m_generatedTerrain
 // for more info)
 void MyGL::renderTerrain() {
-    m_shadowFrameBuffer.bindFrameBuffer();
-    glViewport(0, 0, 2048,2048);
+    m_shadowMap.bindToTextureSlots();
+    m_texture.bind(0);
+    {
+        PROFILE_PASS("sky cubemap");
+        // Only one face of the sky is redrawn per frame
+        m_skyCube.update(m_progSky, m_geomQuad);
+    }
+    m_skyCube.bindToTextureSlot(SKY_CUBE_SLOT);
+    if(m_deferred) {
+        PROFILE_PASS("terrain deferred");
+        renderTerrainDeferred();
+    } else {
+        PROFILE_PASS("terrain forward");
+        renderTerrainForward();
+    }
+}
+
+void MyGL::renderTerrainForward() {
+    m_postChain.bindSceneTarget();
+    glViewport(0, 0, this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    m_shadowShader.drawShadow(m_terrain,int(m_player.mcr_position.x) - 16 - RENDERING_RADIUS, int(m_player.mcr_position.x) + 16 + RENDERING_RADIUS,
-                              int(m_player.mcr_position.z) - 16 - RENDERING_RADIUS, int(m_player.mcr_position.z) + 16 + RENDERING_RADIUS);
-    m_frameBuffer.bindFrameBuffer();
+    m_terrain.drawOpaque(int(m_viewPos.x) - RENDERING_RADIUS, int(m_viewPos.x) + RENDERING_RADIUS,
+                         int(m_viewPos.z) - RENDERING_RADIUS, int(m_viewPos.z) + RENDERING_RADIUS, &m_progLambert);
+    renderEntities();
+    // Far tiles go before the near terrain's water so it blends over them
+    m_farTerrain.draw(int(m_viewPos.x) - RENDERING_RADIUS, int(m_viewPos.x) + RENDERING_RADIUS,
+                      int(m_viewPos.z) - RENDERING_RADIUS, int(m_viewPos.z) + RENDERING_RADIUS,
+                      m_terrain, &m_progLambert);
+    renderSky();
+    m_terrain.drawTransparent(&m_progLambert);
+}
+
+void MyGL::renderTerrainDeferred() {
+    // Opaque Chunks only write their surface attributes...
+    m_gBuffer.bindFrameBuffer();
     glViewport(0, 0, this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    m_progSky.draw(m_geomQuad);
-    m_shadowFrameBuffer.bindToTextureSlot(1);
-    m_texture.bind(0);
-    m_terrain.draw(int(m_player.mcr_position.x) - RENDERING_RADIUS, int(m_player.mcr_position.x) + RENDERING_RADIUS,
-                       int(m_player.mcr_position.z) - RENDERING_RADIUS, int(m_player.mcr_position.z) + RENDERING_RADIUS, &m_progLambert);
+    // The albedo target's alpha holds the baked light, which must not be blended
+    glDisable(GL_BLEND);
+    m_terrain.drawOpaque(int(m_viewPos.x) - RENDERING_RADIUS, int(m_viewPos.x) + RENDERING_RADIUS,
+                         int(m_viewPos.z) - RENDERING_RADIUS, int(m_viewPos.z) + RENDERING_RADIUS, &m_progGBuffer);
+    glEnable(GL_BLEND);
 
+    // ...and are lit once per visible pixel
+    m_postChain.bindSceneTarget();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    m_gBuffer.bindColorToTextureSlot(0, GBUFFER_ALBEDO_SLOT);
+    m_gBuffer.bindColorToTextureSlot(1, GBUFFER_NORMAL_SLOT);
+    m_gBuffer.bindDepthToTextureSlot(GBUFFER_DEPTH_SLOT);
+    // The lighting pass copies the G-buffer's depth into the cleared depth buffer
+    glDepthFunc(GL_ALWAYS);
+    m_progDeferred.draw(m_geomQuad, GBUFFER_ALBEDO_SLOT);
+    glDepthFunc(GL_LESS);
+    // Entities are few enough pixels that lighting them forward costs nothing
+    renderEntities();
+
+    // Far tiles and water carry translucency, so they stay forward-shaded.
+    // The far tiles still go before the near water so it blends over them.
+    m_farTerrain.draw(int(m_viewPos.x) - RENDERING_RADIUS, int(m_viewPos.x) + RENDERING_RADIUS,
+                      int(m_viewPos.z) - RENDERING_RADIUS, int(m_viewPos.z) + RENDERING_RADIUS,
+                      m_terrain, &m_progLambert);
+    renderSky();
+    m_terrain.drawTransparent(&m_progLambert);
 }
 
-void MyGL::performPostprocessRenderPass()
-{
-    // Render the frame buffer as a texture on a screen-size quad
+void MyGL::updateEntityInstances(const WorldSnapshot &snapshot, float t) {
+    for (int kind = 0; kind < ENTITY_KIND_COUNT; ++kind) {
+        const EntityInstances &instances = snapshot.entities[kind];
+        m_entityOffsets.resize(instances.offsets.size());
+        for (unsigned int i = 0; i < instances.offsets.size(); ++i) {
+            m_entityOffsets[i] = glm::mix(instances.prevOffsets[i], instances.offsets[i], t);
+        }
+        m_entityColors.assign(instances.colors.begin(), instances.colors.end());
+        m_entityMeshes[kind]->createInstancedVBOdata(m_entityOffsets, m_entityColors);
+    }
+}
 
-    // Tell OpenGL to render to the viewport's frame buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, this->defaultFramebufferObject());
-    // Render on the whole framebuffer, complete from the lower left corner to the upper right
-    glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
-    // Clear the screen
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void MyGL::renderEntities() {
+    PROFILE_SCOPE("entities");
+    // One draw per kind, however many entities there are
+    for (uPtr<Cube> &mesh : m_entityMeshes) {
+        if (mesh->instanceCount() > 0) {
+            m_progInstanced.drawInstanced(*mesh);
+        }
+    }
+}
 
-    m_frameBuffer.bindToTextureSlot(2);
-    //m_postNoOp.draw(m_geomQuad, 2);
+void MyGL::renderSky() {
+    // Inside the terrain pass, so only its CPU side can be timed
+    PROFILE_SCOPE("sky");
+    // The sky sits on the far plane, so it only passes where the depth
+    // buffer still holds its cleared value. It must go before any
+    // translucent geometry that could blend over it.
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    m_progSkyBox.draw(m_geomQuad);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
 
-    if (m_player.checkInWaterLow())
-    {
-        //TODO: blue-tint post-process
-        m_postBlueTint.draw(m_geomQuad, 2);
+void MyGL::printRenderPathTimings() const {
+    float forwardMs = Profiler::instance().gpuMedianMs("terrain forward");
+    float deferredMs = Profiler::instance().gpuMedianMs("terrain deferred");
+    if(forwardMs < 0.f && deferredMs < 0.f) {
+        return;
     }
-    else if (m_player.checkInLavaLow())
-    {
-        //TODO: red-tint post-process
-        m_postRedTint.draw(m_geomQuad, 2);
+    std::cout << "Terrain GPU time: forward ";
+    if(forwardMs >= 0.f) {
+        std::cout << forwardMs << " ms";
+    } else {
+        std::cout << "n/a";
     }
-    else
-    {
-        //TODO: noOp post-process
-        m_postNoOp.draw(m_geomQuad, 2);
+    std::cout << ", deferred ";
+    if(deferredMs >= 0.f) {
+        std::cout << deferredMs << " ms";
+    } else {
+        std::cout << "n/a";
     }
+    std::cout << (m_deferred ? " (deferred active)" : " (forward active)") << std::endl;
+}
 
+void MyGL::exportProfile() const {
+    Profiler &profiler = Profiler::instance();
+    profiler.printReport();
+    if(profiler.exportCsv("profile.csv") && profiler.exportChromeTrace("profile_trace.json")) {
+        std::cout << "Profile written to profile.csv and profile_trace.json" << std::endl;
+    } else {
+        std::cout << "Could not write the profile" << std::endl;
+    }
+}
+
+void MyGL::performPostprocessRenderPass()
+{
+    // Leaves the result in the viewport's frame buffer
+    m_postChain.apply(m_geomQuad);
 }
 
 void MyGL::initializeTexture()
 {
-    m_texture.create(":/textures/minecraft_textures_all.png");
-    //m_texture.create(":/textures/minecraft_textures_all_grey_grass.png");
+    m_texture.create(":/textures/minecraft_textures_all.png", BLK_ATLAS_CELLS);
+    //m_texture.create(":/textures/minecraft_textures_all_grey_grass.png", BLK_ATLAS_CELLS);
     m_texture.load(0);
 }
 
 void MyGL::keyPressEvent(QKeyEvent *e) {
+    QMutexLocker inputsLocker(&m_inputsLock);
     float amount = 2.0f;
     // m_player.mcr_prevPos = m_player.mcr_position;
     if(e->modifiers() & Qt::ShiftModifier){
@@ -295,6 +651,24 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     } else if (e->key() == Qt::Key_I) {
         openInventory = !openInventory;
         emit sig_inventoryWindow(openInventory);
+    } else if (e->key() == Qt::Key_M) {
+        m_entitiesToSpawn += 100;
+    } else if (e->key() == Qt::Key_G) {
+        m_deferred = !m_deferred;
+        std::cout << (m_deferred ? "Deferred" : "Forward") << " terrain shading" << std::endl;
+    } else if (e->key() == Qt::Key_F3) {
+        Profiler &profiler = Profiler::instance();
+        profiler.setEnabled(!profiler.isEnabled());
+        std::cout << "Profiler " << (profiler.isEnabled() ? "on" : "off") << std::endl;
+    } else if (e->key() == Qt::Key_F4) {
+        // Starts a trace, or ends it and writes it out
+        Profiler &profiler = Profiler::instance();
+        profiler.setRecording(!profiler.isRecording());
+        if (profiler.isRecording()) {
+            std::cout << "Recording profile" << std::endl;
+        } else {
+            exportProfile();
+        }
     }
     if (m_inputs.flightMode) {
         if (e->key() == Qt::Key_Q) {
@@ -304,13 +678,13 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         }
     } else {
         if (e->key() == Qt::Key_Space) {
-            this->currFrame = QDateTime::currentMSecsSinceEpoch();
             m_inputs.spacePressed = true;
         }
     }
 }
 
 void MyGL::keyReleaseEvent(QKeyEvent *e) {
+    QMutexLocker inputsLocker(&m_inputsLock);
     if (e->key() == Qt::Key_W) {
         this->m_inputs.wPressed = false;
     } else if (e->key() == Qt::Key_S) {
@@ -345,55 +719,74 @@ void MyGL::keyReleaseEvent(QKeyEvent *e) {
 void MyGL::mouseMoveEvent(QMouseEvent *e) {
     const float SENSITIVITY = 50.0;
 
+    // Applied on the next step, so it can be recorded along with the keys
+    QMutexLocker inputsLocker(&m_inputsLock);
     float dx = width() * 0.5 - e->pos().x();
-    if (dx != 0) {
-        m_player.rotateOnUpGlobal(dx/width() * SENSITIVITY);
-    }
+    m_inputs.mouseX += dx/width() * SENSITIVITY;
 
     float dy = height() * 0.5 - e->pos().y() - 0.5;
-
-    if (dy != 0) {
-        m_player.rotateOnRightLocal(dy/height() * SENSITIVITY);
-    }
+    m_inputs.mouseY += dy/height() * SENSITIVITY;
 
      moveMouseToCenter();
 }
 
 void MyGL::mousePressEvent(QMouseEvent *e) {
+    QMutexLocker inputsLocker(&m_inputsLock);
     if (e->button() == Qt::LeftButton) {
-        BlockType removed = this->m_player.removeBlock(&m_terrain);
-                if (removed == GRASS) {
-                    numGrass++;
-                } else if (removed == DIRT) {
-                    numDirt++;
-                } else if (removed == STONE) {
-                    numStone++;
-                } else if (removed == BEDROCK) {
-                    numBedrock++;
-                } else if (removed == LAVA) {
-                    numLava++;
-                } else if (removed == WATER) {
-                    numWater++;
-                } else if (removed == SNOW) {
-                    numSnow++;
-                }
+        m_inputs.leftClicked = true;
     }
     if (e->button() == Qt::RightButton) {
-        if (currBlockType == GRASS && numGrass > 0 && this->m_player.placeBlock(&m_terrain, GRASS) != EMPTY) {
-                    numGrass--;
-                } else if (currBlockType == DIRT && numDirt > 0 && this->m_player.placeBlock(&m_terrain, DIRT) != EMPTY) {
-                    numDirt--;
-                } else if (currBlockType == STONE && numStone > 0 && this->m_player.placeBlock(&m_terrain, STONE) != EMPTY) {
-                    numStone--;
-                } else if (currBlockType == BEDROCK && numBedrock > 0 && this->m_player.placeBlock(&m_terrain, BEDROCK) != EMPTY) {
-                    numBedrock--;
-                } else if (currBlockType == LAVA && numLava > 0 && this->m_player.placeBlock(&m_terrain, LAVA) != EMPTY) {
-                    numLava--;
-                } else if (currBlockType == WATER && numWater > 0 && this->m_player.placeBlock(&m_terrain, WATER) != EMPTY) {
-                    numWater--;
-                } else if (currBlockType == SNOW && numSnow > 0 && this->m_player.placeBlock(&m_terrain, SNOW) != EMPTY) {
-                    numSnow--;
-                }
+        m_inputs.rightClicked = true;
+    }
+}
+
+void MyGL::removeBlock() {
+    glm::ivec3 removedAt;
+    BlockType removed = this->m_player.removeBlock(&m_terrain, &removedAt);
+    if (removed != EMPTY) {
+        m_fluids.blockChanged(m_terrain, removedAt);
+        m_lighting.blockChanged(removedAt);
+    }
+    if (removed == GRASS) {
+        numGrass++;
+    } else if (removed == DIRT) {
+        numDirt++;
+    } else if (removed == STONE) {
+        numStone++;
+    } else if (removed == BEDROCK) {
+        numBedrock++;
+    } else if (removed == LAVA) {
+        numLava++;
+    } else if (removed == WATER) {
+        numWater++;
+    } else if (removed == SNOW) {
+        numSnow++;
+    }
+}
+
+void MyGL::placeBlock() {
+    // May be switched from the inventory window at any moment
+    BlockType blockType = currBlockType;
+    // Left below the world unless a block is placed
+    glm::ivec3 placedAt(0, -1, 0);
+    if (blockType == GRASS && numGrass > 0 && this->m_player.placeBlock(&m_terrain, GRASS, &placedAt) != EMPTY) {
+        numGrass--;
+    } else if (blockType == DIRT && numDirt > 0 && this->m_player.placeBlock(&m_terrain, DIRT, &placedAt) != EMPTY) {
+        numDirt--;
+    } else if (blockType == STONE && numStone > 0 && this->m_player.placeBlock(&m_terrain, STONE, &placedAt) != EMPTY) {
+        numStone--;
+    } else if (blockType == BEDROCK && numBedrock > 0 && this->m_player.placeBlock(&m_terrain, BEDROCK, &placedAt) != EMPTY) {
+        numBedrock--;
+    } else if (blockType == LAVA && numLava > 0 && this->m_player.placeBlock(&m_terrain, LAVA, &placedAt) != EMPTY) {
+        numLava--;
+    } else if (blockType == WATER && numWater > 0 && this->m_player.placeBlock(&m_terrain, WATER, &placedAt) != EMPTY) {
+        numWater--;
+    } else if (blockType == SNOW && numSnow > 0 && this->m_player.placeBlock(&m_terrain, SNOW, &placedAt) != EMPTY) {
+        numSnow--;
+    }
+    if (placedAt.y >= 0) {
+        m_fluids.blockChanged(m_terrain, placedAt);
+        m_lighting.blockChanged(placedAt);
     }
 }
 
@@ -4,20 +4,37 @@
 #include "openglcontext.h"
 #include "shaderprogram.h"
 #include "shadowshader.h"
-#include "postprocessshader.h"
+#include "postprocesschain.h"
+#include "deferredshader.h"
+#include "skyshader.h"
 #include "scene/worldaxes.h"
 #include "scene/camera.h"
 #include "scene/terrain.h"
+#include "scene/farterrain.h"
 #include "scene/player.h"
 #include "scene/quad.h"
+#include "scene/cube.h"
+#include "scene/entitymanager.h"
+#include "scene/fluidsimulator.h"
+#include "scene/lightengine.h"
 #include "framebuffer.h"
-#include "shadowframebuffer.h"
-#include "texteure.h"
+#include "cascadedshadowmap.h"
+#include "texturearray.h"
+#include "skycubemap.h"
+#include "uniformbuffer.h"
+#include "profiler.h"
+#include "inputrecorder.h"
+#include "benchmarkrunner.h"
+#include "worldsimulation.h"
+#include "triplebuffer.h"
 
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
 #include <smartpointerhelp.h>
 #include <qdatetime.h>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <atomic>
 
 class MyGL : public OpenGLContext
 {
@@ -27,51 +44,106 @@ private:
     // the scene with the post-process shaders.
     Quad m_geomQuad;
 
-    FrameBuffer m_frameBuffer;
-    ShadowFrameBuffer m_shadowFrameBuffer;
+    PostProcessChain m_postChain; // Where the scene is rendered, and the screen-space effects applied to it
+    FrameBuffer m_gBuffer; // Albedo, normal and depth of the opaque terrain, for the deferred path
+    SkyCubeMap m_skyCube; // The sky, cached and redrawn a face at a time
+    CascadedShadowMap m_shadowMap; // Cached shadow cascades, only re-rendered when the sun, the camera or nearby geometry changes
     ShadowShader m_shadowShader;
 
     WorldAxes m_worldAxes; // A wireframe representation of the world axes. It is hard-coded to sit centered at (32, 128, 32).
     ShaderProgram m_progLambert;// A shader program that uses lambertian reflection
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
     ShaderProgram m_progInstanced;// A shader program that is designed to be compatible with instanced rendering
-    ShaderProgram m_progSky; // A shader program that draws the sky box(day and night cycle)
-    PostProcessShader m_postNoOp;
-    PostProcessShader m_postBlueTint;
-    PostProcessShader m_postRedTint;
+    SkyShader m_progSky; // A shader program that draws the sky box(day and night cycle) into m_skyCube
+    SkyShader m_progSkyBox; // Composites m_skyCube behind the terrain
+    ShaderProgram m_progGBuffer; // Writes opaque terrain into m_gBuffer
+    DeferredShader m_progDeferred; // Lights every pixel of m_gBuffer once
+    UniformBuffer m_perFrameUniforms; // Camera, light and time, shared by every ShaderProgram
 
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry too much about this. Just know it is necessary in order to render geometry.
 
+    ChunkUploader m_chunkUploader; // Fills Chunk VBOs off the render thread when run with --upload-thread
     Terrain m_terrain; // All of the Chunks that currently comprise the world.
+    FarTerrain m_farTerrain; // Heightmap-only stand-ins for the world beyond the Chunks we draw.
     Player m_player; // The entity controlled by the user. Contains a camera to display what it sees as well.
+    std::vector<uPtr<Cube>> m_entityMeshes; // One per EntityKind, drawn once per frame for all entities of that kind
+    std::vector<glm::vec3> m_entityOffsets, m_entityColors; // Instance data of the mesh being uploaded
+    Camera m_renderCamera; // The Player's camera as drawn this frame, between the last two simulation steps
+    glm::vec3 m_viewPos;   // The Player's position as drawn this frame. Chunks are drawn around it.
     InputBundle m_inputs; // A collection of variables to be updated in keyPressEvent, mouseMoveEvent, mousePressEvent, etc.
+    QMutex m_inputsLock;  // Guards m_inputs, which the simulation thread takes each step
+    InputRecorder m_inputRecorder; // Logs m_inputs each tick, or replaces them with a logged run
+    BenchmarkRunner m_benchmark; // Flies the Player along a fixed path when run with --benchmark
 
     QTimer m_timer; // Timer linked to tick(). Fires approximately 60 times per second.
-    Texture m_texture;
+    TextureArray m_texture; // Every block texture, one per layer
     int m_time; //A variable that increases every time paintGL is called
 
+    int m_postUnderwater; // m_postChain's effect IDs
+    int m_postUnderLava;
+
+    bool m_deferred; // Whether renderTerrain lights opaque terrain through m_gBuffer. Toggled with G.
+
     void moveMouseToCenter(); // Forces the mouse position to the screen's center. You should call this
                               // from within a mouse move event after reading the mouse movement so that
                               // your mouse stays within the screen bounds and is always read.
 
-    void sendPlayerDataToGUI() const;
+    // Applies the mouse turn and block clicks gathered since the last step
+    void applyMouseInputs(const InputBundle &inputs);
+    void removeBlock();
+    void placeBlock();
+    // Stops a replay once its input runs out, reporting the run's profile
+    void finishReplay();
+    // Reports the benchmark once its path is flown, and quits
+    void finishBenchmark();
+
+    void sendPlayerDataToGUI(const WorldSnapshot &snapshot) const;
     void sendInventoryDataToGUI() const;
 
     qint64 prevFrame;
     qint64 currFrame;
 
+    // Fixed-rate simulation. m_simulation steps the Player, their edits and the
+    // terrain streaming decisions on its own thread, and hands each step's
+    // outcome to tick() and paintGL through m_snapshots. paintGL draws the
+    // camera part way between the last two steps.
+    // Everything below up to m_simulation belongs to that thread once it runs.
+    glm::vec3 m_lastExpansionPos; // Where the last step saw the Player
+    EntityManager m_entities;     // Every mob and item
+    std::atomic<int> m_entitiesToSpawn; // Requested from the GUI thread, spawned by the next step
+    void stepEntities(float dT);
+    FluidSimulator m_fluids;      // Makes WATER and LAVA flow
+    LightEngine m_lighting;       // Keeps the sky and block light up to date
+    bool m_expansionPlanned;      // Has the first ExpansionPlan been queued?
+    // The thread's step. Returns false once a replay has ended.
+    bool simulate();
+    // Runs one step of the Player's simulation. Returns false if a replay just ended.
+    bool simulateStep();
+    // Plans the terrain streaming for the Player's new position and publishes the step
+    void publishStep(bool finished);
+    TripleBuffer<WorldSnapshot> m_snapshots;
+
+    // Startup: the Player is frozen until the ground around them is resident
+    QElapsedTimer m_startupTimer; // Started when MyGL is constructed
+    std::atomic<bool> m_spawnResident; // Has the spawn area been meshed and uploaded?
+    bool m_firstFrameLogged;  // Has the first frame showing it been reported?
+
+    // Declared last, so it is built once everything it steps is
+    WorldSimulation m_simulation;
+
 public:
     bool openInventory;
-        int numGrass;
-        int numDirt;
-        int numStone;
-        int numWater;
-        int numLava;
-        int numBedrock;
-        int numSnow;
+        // Spent and refilled by the simulation thread
+        std::atomic<int> numGrass;
+        std::atomic<int> numDirt;
+        std::atomic<int> numStone;
+        std::atomic<int> numWater;
+        std::atomic<int> numLava;
+        std::atomic<int> numBedrock;
+        std::atomic<int> numSnow;
         // initial block type holding
-        BlockType currBlockType;
+        std::atomic<BlockType> currBlockType;
 
     explicit MyGL(QWidget *parent = nullptr);
     ~MyGL();
@@ -90,6 +162,18 @@ public:
     // Called from paintGL().
     // Calls Terrain::draw().
     void renderTerrain();
+    // The two ways renderTerrain can draw the world
+    void renderTerrainForward();
+    void renderTerrainDeferred();
+    // Fills every pixel no geometry has covered yet with the cached sky
+    void renderSky();
+    // Uploads the snapshot's entities the given fraction of the way between its two steps
+    void updateEntityInstances(const WorldSnapshot &snapshot, float t);
+    void renderEntities();
+    // Prints the median GPU time of each render path's recent frames
+    void printRenderPathTimings() const;
+    // Stops recording and writes the profile out next to the executable
+    void exportProfile() const;
 
     void performPostprocessRenderPass();
     void performSkyRender();
@@ -8,7 +8,7 @@
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent), m_currentProgram(0), m_programBinaries(this)
 {}
 
 OpenGLContext::~OpenGLContext()
@@ -142,3 +142,22 @@ void OpenGLContext::printShaderInfoLog(int shader)
     // Throwing here allows us to use the debugger to track down the error.
     throw;
 }
+
+void OpenGLContext::useProgram(GLuint prog)
+{
+    if(prog != m_currentProgram) {
+        glUseProgram(prog);
+        m_currentProgram = prog;
+    }
+}
+
+void OpenGLContext::resetProgramCache()
+{
+    m_currentProgram = 0;
+    glUseProgram(0);
+}
+
+ProgramBinaryCache& OpenGLContext::programBinaries()
+{
+    return m_programBinaries;
+}
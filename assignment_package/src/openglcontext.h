@@ -3,6 +3,7 @@
 #include <QOpenGLWidget>
 #include <QTimer>
 #include <QOpenGLExtraFunctions>
+#include "programbinarycache.h"
 
 
 class OpenGLContext
@@ -18,4 +19,17 @@ public:
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // glUseProgram, skipped when the program is already current
+    void useProgram(GLuint prog);
+    // Forgets the cached program. Call whenever code outside our
+    // shader classes (e.g. Qt's compositing) may have changed it.
+    void resetProgramCache();
+
+    // Compiled programs saved from earlier launches
+    ProgramBinaryCache& programBinaries();
+
+private:
+    GLuint m_currentProgram;
+    ProgramBinaryCache m_programBinaries;
 };
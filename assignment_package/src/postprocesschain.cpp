@@ -0,0 +1,122 @@
+#include "postprocesschain.h"
+
+// Reads a shader file whose text is spliced into a generated source
+static QString readShaderText(const char *fileName) {
+    return QString::fromUtf8(ProgramBinaryCache::readSource(fileName));
+}
+
+PostProcessChain::PostProcessChain(OpenGLContext *context,
+                                   unsigned int width, unsigned int height, unsigned int devicePixelRatio)
+    : mp_context(context), m_effects(), m_active(),
+      m_sceneTarget(context, width, height, devicePixelRatio),
+      m_pingTarget(context, width, height, devicePixelRatio),
+      m_programs(), m_width(width), m_height(height), m_devicePixelRatio(devicePixelRatio),
+      m_created(false)
+{}
+
+int PostProcessChain::addEffect(const char *file, bool singleTap) {
+    m_effects.push_back(Effect{readShaderText(file), singleTap});
+    return static_cast<int>(m_effects.size()) - 1;
+}
+
+void PostProcessChain::create() {
+    m_sceneTarget.create();
+    m_pingTarget.create();
+    m_created = true;
+    // Build the single-effect programs up front, so switching
+    // an effect on does not stall a frame on a shader compile
+    for(int i = 0; i < static_cast<int>(m_effects.size()); i++) {
+        programFor({i});
+    }
+}
+
+void PostProcessChain::destroy() {
+    if(m_created) {
+        m_created = false;
+        m_sceneTarget.destroy();
+        m_pingTarget.destroy();
+    }
+}
+
+void PostProcessChain::resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio) {
+    m_width = width;
+    m_height = height;
+    m_devicePixelRatio = devicePixelRatio;
+    m_sceneTarget.resize(width, height, devicePixelRatio);
+    m_pingTarget.resize(width, height, devicePixelRatio);
+}
+
+void PostProcessChain::setActiveEffects(const std::vector<int> &effects) {
+    m_active = effects;
+}
+
+void PostProcessChain::bindSceneTarget() {
+    if(m_active.empty()) {
+        mp_context->glBindFramebuffer(GL_FRAMEBUFFER, mp_context->defaultFramebufferObject());
+    } else {
+        m_sceneTarget.bindFrameBuffer();
+    }
+}
+
+std::vector<std::vector<int>> PostProcessChain::fusedRuns() const {
+    std::vector<std::vector<int>> runs;
+    for(int effect : m_active) {
+        if(runs.empty() || !m_effects[effect].singleTap) {
+            runs.push_back({});
+        }
+        runs.back().push_back(effect);
+    }
+    return runs;
+}
+
+PostProcessShader& PostProcessChain::programFor(const std::vector<int> &run) {
+    auto found = m_programs.find(run);
+    if(found != m_programs.end()) {
+        return *found->second;
+    }
+
+    // Stage 0 reads the previous pass's output. Every effect is then
+    // compiled as the next stage, reading the one before it.
+    QString frag = "#version 150\n";
+    frag += readShaderText(":/glsl/post_common.glsl");
+    frag += "\nvec4 postStage0(vec2 uv) { return texture(u_RenderedTexture, uv); }\n";
+    for(int i = 0; i < static_cast<int>(run.size()); i++) {
+        frag += QString("#define POST_INPUT postStage%1\n#define POST_EFFECT postStage%2\n").arg(i).arg(i + 1);
+        frag += m_effects[run[i]].source;
+        frag += "\n#undef POST_INPUT\n#undef POST_EFFECT\n";
+    }
+    frag += QString("void main()\n{\n    out_Col = postStage%1(fs_UV);\n}\n").arg(static_cast<int>(run.size()));
+
+    uPtr<PostProcessShader> program = mkU<PostProcessShader>(mp_context);
+    program->createFromSource(ProgramBinaryCache::readSource(":/glsl/passthrough.vert.glsl"), frag.toUtf8());
+    PostProcessShader &result = *program;
+    m_programs[run] = std::move(program);
+    return result;
+}
+
+void PostProcessChain::apply(Drawable &quad) {
+    if(m_active.empty()) {
+        // The scene was rendered straight to the screen
+        return;
+    }
+
+    // Every pass overwrites every pixel
+    mp_context->glDisable(GL_DEPTH_TEST);
+    mp_context->glViewport(0, 0, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio);
+
+    std::vector<std::vector<int>> runs = fusedRuns();
+    FrameBuffer *src = &m_sceneTarget;
+    FrameBuffer *dst = &m_pingTarget;
+    for(unsigned int i = 0; i < runs.size(); i++) {
+        if(i + 1 == runs.size()) {
+            mp_context->glBindFramebuffer(GL_FRAMEBUFFER, mp_context->defaultFramebufferObject());
+        } else {
+            dst->bindFrameBuffer();
+        }
+        src->bindToTextureSlot(POST_INPUT_SLOT);
+        programFor(runs[i]).draw(quad, POST_INPUT_SLOT);
+        std::swap(src, dst);
+    }
+
+    mp_context->glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "postprocessshader.h"
+#include "framebuffer.h"
+#include "smartpointerhelp.h"
+#include <map>
+#include <vector>
+
+// Texture slot each post-process pass reads its input from
+#define POST_INPUT_SLOT 2
+
+// Applies a list of screen-space effects to the rendered scene.
+// Each effect is a GLSL function in its own file (see post_blue_tinge.glsl),
+// and consecutive effects that read their input once per pixel are fused
+// into a single generated shader, so a run of them costs one full-screen
+// pass. Passes ping-pong between two frame buffers however long the chain
+// is, and the last one writes straight to the screen. With no effect active
+// the scene itself is rendered to the screen and no pass runs at all.
+class PostProcessChain
+{
+private:
+    struct Effect {
+        QString source;  // Body of the effect's .glsl file
+        bool singleTap;  // Does it sample its input only once per pixel?
+    };
+
+    OpenGLContext *mp_context;
+    std::vector<Effect> m_effects;
+    std::vector<int> m_active; // Effects applied this frame, in order
+    FrameBuffer m_sceneTarget; // The scene, then every other pass's output
+    FrameBuffer m_pingTarget;  // The remaining passes' output
+    // One program per run of fused effects, keyed by the effect IDs it applies
+    std::map<std::vector<int>, uPtr<PostProcessShader>> m_programs;
+    unsigned int m_width, m_height, m_devicePixelRatio;
+    bool m_created;
+
+    // Splits the active effects into the runs drawn by each pass
+    std::vector<std::vector<int>> fusedRuns() const;
+    // Returns the program that applies the given run, building it on first use
+    PostProcessShader& programFor(const std::vector<int> &run);
+
+public:
+    PostProcessChain(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+
+    // Registers the effect defined in the given file and returns its ID.
+    // Effects that sample their input more than once (e.g. blurs) always
+    // start a new pass, since fusing them would re-run the whole run before
+    // them for every sample.
+    int addEffect(const char *file, bool singleTap);
+
+    // Allocates the frame buffers and builds a program for every effect on its own
+    void create();
+    void destroy();
+    void resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+
+    // Picks the effects applied to the next frame, in order
+    void setActiveEffects(const std::vector<int> &effects);
+    // Binds the frame buffer the scene should be rendered into
+    void bindSceneTarget();
+    // Applies the active effects to the scene and writes the result to the screen
+    void apply(Drawable &quad);
+};
@@ -0,0 +1,365 @@
+#include "profiler.h"
+#include <QThread>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+RollingHistogram::RollingHistogram()
+    : m_samples(), m_next(0), m_count(0)
+{}
+
+void RollingHistogram::add(float ms) {
+    m_samples[m_next] = ms;
+    m_next = (m_next + 1) % PROFILER_WINDOW;
+    m_count = std::min(m_count + 1, PROFILER_WINDOW);
+}
+
+int RollingHistogram::count() const {
+    return m_count;
+}
+
+float RollingHistogram::percentile(float p) const {
+    if(m_count == 0) {
+        return 0.f;
+    }
+    // The window is small enough to copy and partially sort on demand
+    std::vector<float> sorted(m_samples.begin(), m_samples.begin() + m_count);
+    int rank = std::min(m_count - 1, static_cast<int>(p / 100.f * m_count));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+float RollingHistogram::mean() const {
+    if(m_count == 0) {
+        return 0.f;
+    }
+    float sum = 0.f;
+    for(int i = 0; i < m_count; i++) {
+        sum += m_samples[i];
+    }
+    return sum / m_count;
+}
+
+float RollingHistogram::max() const {
+    if(m_count == 0) {
+        return 0.f;
+    }
+    return *std::max_element(m_samples.begin(), m_samples.begin() + m_count);
+}
+
+Profiler::Profiler()
+    : mp_context(nullptr), m_clock(), m_mainThread(nullptr),
+      m_enabled(false), m_recording(false), m_gpuCreated(false), m_gpuScopeOpen(false),
+      m_cpuHistograms(), m_gpuHistograms(), m_lock(), m_trace(), m_workerHistograms(), m_latencyHistograms(),
+      m_workerTracks(), m_poolThreads(), m_workerBusyNs(0), m_workerWindowStartNs(0), m_nextAsyncId(0),
+      m_gpuFrames(), m_gpuFrame(0)
+{
+    m_clock.start();
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::create(OpenGLContext *context) {
+    mp_context = context;
+    // The thread that owns the GL context is the one whose frames we time
+    m_mainThread = QThread::currentThread();
+    m_gpuCreated = true;
+}
+
+void Profiler::destroy() {
+    if(!m_gpuCreated) {
+        return;
+    }
+    m_gpuCreated = false;
+    for(GpuFrame &frame : m_gpuFrames) {
+        for(const PendingGpuScope &scope : frame.scopes) {
+            frame.freeQueries.push_back(scope.query);
+        }
+        frame.scopes.clear();
+        if(!frame.freeQueries.empty()) {
+            mp_context->glDeleteQueries(frame.freeQueries.size(), frame.freeQueries.data());
+            frame.freeQueries.clear();
+        }
+    }
+}
+
+void Profiler::setEnabled(bool enabled) {
+    m_enabled = enabled;
+}
+
+bool Profiler::isEnabled() const {
+    return m_enabled;
+}
+
+void Profiler::setRecording(bool recording) {
+    QMutexLocker locker(&m_lock);
+    if(recording && !m_recording) {
+        m_trace.clear();
+        m_workerBusyNs = 0;
+        m_workerWindowStartNs = nowNs();
+    }
+    m_recording = recording;
+}
+
+bool Profiler::isRecording() const {
+    return m_recording;
+}
+
+bool Profiler::counting() const {
+    return m_enabled && QThread::currentThread() == m_mainThread;
+}
+
+qint64 Profiler::nowNs() const {
+    return m_clock.nsecsElapsed();
+}
+
+void Profiler::record(const char *name, qint64 startNs, qint64 durationNs, int track, qint64 asyncId) {
+    float ms = durationNs / 1e6f;
+    if(track == TRACK_CPU || track == TRACK_GPU) {
+        // Only ever touched by the main thread
+        (track == TRACK_GPU ? m_gpuHistograms : m_cpuHistograms)[name].add(ms);
+    }
+    QMutexLocker locker(&m_lock);
+    if(track == TRACK_PIPELINE) {
+        m_latencyHistograms[name].add(ms);
+    } else if(track >= TRACK_WORKER) {
+        m_workerHistograms[name].add(ms);
+    }
+    if(m_recording && m_trace.size() < PROFILER_MAX_TRACE_EVENTS) {
+        m_trace.push_back(Event{name, startNs, durationNs, track, asyncId});
+    }
+}
+
+void Profiler::addCpuSample(const char *name, qint64 startNs, qint64 endNs) {
+    if(!counting()) {
+        return;
+    }
+    record(name, startNs, endNs - startNs, TRACK_CPU);
+}
+
+void Profiler::addWorkerSample(const char *name, qint64 startNs, qint64 endNs) {
+    if(!m_enabled) {
+        return;
+    }
+    int track;
+    {
+        QMutexLocker locker(&m_lock);
+        track = currentThreadTrack();
+        m_poolThreads.insert(QThread::currentThread());
+        m_workerBusyNs += endNs - std::max(startNs, m_workerWindowStartNs);
+    }
+    record(name, startNs, endNs - startNs, track);
+}
+
+void Profiler::addThreadSample(const char *name, qint64 startNs, qint64 endNs) {
+    if(!m_enabled) {
+        return;
+    }
+    int track;
+    {
+        QMutexLocker locker(&m_lock);
+        track = currentThreadTrack();
+    }
+    record(name, startNs, endNs - startNs, track);
+}
+
+int Profiler::currentThreadTrack() {
+    auto found = m_workerTracks.find(QThread::currentThread());
+    if(found == m_workerTracks.end()) {
+        found = m_workerTracks.emplace(QThread::currentThread(), TRACK_WORKER + static_cast<int>(m_workerTracks.size())).first;
+    }
+    return found->second;
+}
+
+void Profiler::addLatencySample(const char *name, qint64 startNs, qint64 endNs, qint64 asyncId) {
+    if(!m_enabled) {
+        return;
+    }
+    record(name, startNs, endNs - startNs, TRACK_PIPELINE, asyncId);
+}
+
+qint64 Profiler::nextAsyncId() {
+    QMutexLocker locker(&m_lock);
+    return m_nextAsyncId++;
+}
+
+float Profiler::workerUtilization(int *threadCount) const {
+    *threadCount = static_cast<int>(m_poolThreads.size());
+    qint64 window = nowNs() - m_workerWindowStartNs;
+    if(m_poolThreads.empty() || window <= 0) {
+        return 0.f;
+    }
+    return static_cast<float>(m_workerBusyNs) / (static_cast<float>(window) * m_poolThreads.size());
+}
+
+GLuint Profiler::takeQuery(GpuFrame &frame) {
+    if(frame.freeQueries.empty()) {
+        GLuint query;
+        mp_context->glGenQueries(1, &query);
+        return query;
+    }
+    GLuint query = frame.freeQueries.back();
+    frame.freeQueries.pop_back();
+    return query;
+}
+
+void Profiler::collectGpuFrame(GpuFrame &frame) {
+    if(frame.scopes.empty()) {
+        return;
+    }
+    // Queries finish in order, so if the last is ready they all are.
+    // If not, the frame is dropped rather than waited on.
+    GLuint available = 0;
+    mp_context->glGetQueryObjectuiv(frame.scopes.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    for(const PendingGpuScope &scope : frame.scopes) {
+        if(available && m_enabled) {
+            GLuint ns = 0;
+            mp_context->glGetQueryObjectuiv(scope.query, GL_QUERY_RESULT, &ns);
+            record(scope.name, scope.cpuStartNs, ns, TRACK_GPU);
+        }
+        frame.freeQueries.push_back(scope.query);
+    }
+    frame.scopes.clear();
+}
+
+void Profiler::beginFrame() {
+    if(!m_gpuCreated) {
+        return;
+    }
+    m_gpuFrame = (m_gpuFrame + 1) % PROFILER_GPU_LATENCY;
+    collectGpuFrame(m_gpuFrames[m_gpuFrame]);
+}
+
+bool Profiler::beginGpuScope(const char *name, qint64 cpuStartNs) {
+    if(!m_gpuCreated || m_gpuScopeOpen || !counting()) {
+        return false;
+    }
+    GpuFrame &frame = m_gpuFrames[m_gpuFrame];
+    GLuint query = takeQuery(frame);
+    mp_context->glBeginQuery(GL_TIME_ELAPSED, query);
+    frame.scopes.push_back(PendingGpuScope{name, query, cpuStartNs});
+    m_gpuScopeOpen = true;
+    return true;
+}
+
+void Profiler::endGpuScope() {
+    mp_context->glEndQuery(GL_TIME_ELAPSED);
+    m_gpuScopeOpen = false;
+}
+
+float Profiler::gpuMedianMs(const std::string &name) const {
+    auto found = m_gpuHistograms.find(name);
+    if(found == m_gpuHistograms.end() || found->second.count() == 0) {
+        return -1.f;
+    }
+    return found->second.percentile(50.f);
+}
+
+void Profiler::printReport() const {
+    QMutexLocker locker(&m_lock);
+    const std::pair<const char*, const std::map<std::string, RollingHistogram>*> clocks[] = {
+        {"CPU ", &m_cpuHistograms}, {"GPU ", &m_gpuHistograms},
+        {"JOB ", &m_workerHistograms}, {"WAIT", &m_latencyHistograms}};
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Section                        count     p50     p95     p99  (ms)" << std::endl;
+    for(const auto &clock : clocks) {
+        for(const auto &entry : *clock.second) {
+            const RollingHistogram &h = entry.second;
+            std::cout << clock.first << std::left << std::setw(26) << entry.first << std::right
+                      << std::setw(6) << h.count()
+                      << std::setw(8) << h.percentile(50.f)
+                      << std::setw(8) << h.percentile(95.f)
+                      << std::setw(8) << h.percentile(99.f) << std::endl;
+        }
+    }
+    int threads;
+    float busy = workerUtilization(&threads);
+    std::cout << std::setprecision(1) << "Worker utilization: " << 100.f * busy << "% of "
+              << threads << " threads" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+bool Profiler::exportCsv(const std::string &path) const {
+    std::ofstream out(path);
+    if(!out) {
+        return false;
+    }
+    QMutexLocker locker(&m_lock);
+    const std::pair<const char*, const std::map<std::string, RollingHistogram>*> clocks[] = {
+        {"cpu", &m_cpuHistograms}, {"gpu", &m_gpuHistograms},
+        {"worker", &m_workerHistograms}, {"pipeline", &m_latencyHistograms}};
+    out << "clock,section,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    for(const auto &clock : clocks) {
+        for(const auto &entry : *clock.second) {
+            const RollingHistogram &h = entry.second;
+            out << clock.first << ',' << entry.first << ',' << h.count() << ',' << h.mean() << ','
+                << h.percentile(50.f) << ',' << h.percentile(95.f) << ',' << h.percentile(99.f) << ','
+                << h.max() << '\n';
+        }
+    }
+    int threads;
+    float busy = workerUtilization(&threads);
+    out << "pool,utilization_percent," << threads << ',' << 100.f * busy << ",,,,\n";
+    return true;
+}
+
+bool Profiler::exportChromeTrace(const std::string &path) const {
+    std::ofstream out(path);
+    if(!out) {
+        return false;
+    }
+    QMutexLocker locker(&m_lock);
+    // Complete ("X") events in microseconds, with the CPU, the GPU and each
+    // other thread as a thread. Pipeline spans are async events, one row per Chunk.
+    out << "{\"traceEvents\":[\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for(const auto &worker : m_workerTracks) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << worker.second
+            << ",\"args\":{\"name\":\"" << (m_poolThreads.count(worker.first) ? "Worker " : "Thread ")
+            << worker.second - TRACK_WORKER << "\"}}";
+    }
+    out << std::fixed << std::setprecision(3);
+    for(const Event &e : m_trace) {
+        if(e.track == TRACK_PIPELINE) {
+            out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"pipeline\",\"ph\":\"b\",\"id\":" << e.asyncId
+                << ",\"pid\":1,\"tid\":0,\"ts\":" << e.startNs / 1e3 << '}'
+                << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"pipeline\",\"ph\":\"e\",\"id\":" << e.asyncId
+                << ",\"pid\":1,\"tid\":0,\"ts\":" << (e.startNs + e.durationNs) / 1e3 << '}';
+        } else {
+            out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.track
+                << ",\"ts\":" << e.startNs / 1e3 << ",\"dur\":" << e.durationNs / 1e3 << '}';
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
+
+ProfileScope::ProfileScope(const char *name)
+    : m_name(name), m_startNs(Profiler::instance().isEnabled() ? Profiler::instance().nowNs() : -1)
+{}
+
+ProfileScope::~ProfileScope() {
+    if(m_startNs >= 0) {
+        Profiler &profiler = Profiler::instance();
+        profiler.addCpuSample(m_name, m_startNs, profiler.nowNs());
+    }
+}
+
+qint64 ProfileScope::startNs() const {
+    return m_startNs;
+}
+
+ProfilePassScope::ProfilePassScope(const char *name)
+    : m_cpu(name), m_gpu(m_cpu.startNs() >= 0 && Profiler::instance().beginGpuScope(name, m_cpu.startNs()))
+{}
+
+ProfilePassScope::~ProfilePassScope() {
+    if(m_gpu) {
+        Profiler::instance().endGpuScope();
+    }
+}
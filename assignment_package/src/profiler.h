@@ -0,0 +1,192 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "openglcontext.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <array>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class QThread;
+
+// How many of the most recent samples each section's percentiles cover
+#define PROFILER_WINDOW 600
+// How many frames of GPU queries may be in flight before they are read
+#define PROFILER_GPU_LATENCY 4
+// Events kept for a Chrome trace before recording stops, about a minute of frames
+#define PROFILER_MAX_TRACE_EVENTS 200000
+
+// The most recent PROFILER_WINDOW durations of one section
+class RollingHistogram
+{
+private:
+    std::array<float, PROFILER_WINDOW> m_samples; // In milliseconds
+    int m_next;
+    int m_count;
+
+public:
+    RollingHistogram();
+    void add(float ms);
+    int count() const;
+    // The given percentile (0 to 100) of the samples in the window
+    float percentile(float p) const;
+    float mean() const;
+    float max() const;
+};
+
+// Times named sections of each frame, on the CPU with PROFILE_SCOPE and
+// also on the GPU with PROFILE_PASS, which brackets a render pass with a
+// GL_TIME_ELAPSED query. Those queries cannot overlap, so a PROFILE_PASS
+// inside another one only times the CPU. GPU results are read
+// PROFILER_GPU_LATENCY frames late so the CPU never waits on them.
+// Every section feeds a rolling histogram. While recording, each sample
+// is also kept as an event that can be written out as a Chrome trace
+// (load it in chrome://tracing or Perfetto). GPU events are drawn on
+// their own track, starting when their pass was issued.
+// Scopes only count on the main thread, and only while enabled, which
+// keeps a disabled scope down to one branch. It starts disabled.
+// Worker threads report their jobs with addWorkerSample() instead, which
+// also tracks how busy the pool's workers are. Other threads, and parts of
+// a job already timed, report with addThreadSample(), which leaves the
+// utilization alone. The terrain pipeline reports how long each Chunk
+// waited between stages with addLatencySample().
+class Profiler
+{
+private:
+    // Trace tracks. Worker threads get their own tracks from TRACK_WORKER up.
+    enum Track { TRACK_PIPELINE = 0, TRACK_CPU = 1, TRACK_GPU = 2, TRACK_WORKER = 3 };
+    struct Event {
+        const char *name;
+        qint64 startNs;    // Since the profiler was created, on the CPU's clock
+        qint64 durationNs;
+        int track;
+        qint64 asyncId;    // Groups the TRACK_PIPELINE spans of one Chunk
+    };
+    // A GPU section whose query has not been read yet
+    struct PendingGpuScope {
+        const char *name;
+        GLuint query;
+        qint64 cpuStartNs; // When the pass was issued
+    };
+    struct GpuFrame {
+        std::vector<PendingGpuScope> scopes;
+        std::vector<GLuint> freeQueries;
+    };
+
+    OpenGLContext *mp_context;
+    QElapsedTimer m_clock;
+    QThread *m_mainThread;
+    // Read by every thread that reports a sample, so atomic
+    std::atomic<bool> m_enabled;
+    std::atomic<bool> m_recording;
+    bool m_gpuCreated;
+    bool m_gpuScopeOpen;
+
+    std::map<std::string, RollingHistogram> m_cpuHistograms;
+    std::map<std::string, RollingHistogram> m_gpuHistograms;
+
+    // Guards everything below, which worker threads also write
+    mutable QMutex m_lock;
+    std::vector<Event> m_trace;
+    std::map<std::string, RollingHistogram> m_workerHistograms;
+    std::map<std::string, RollingHistogram> m_latencyHistograms;
+    std::map<QThread*, int> m_workerTracks; // Of every thread that reported a sample
+    std::set<QThread*> m_poolThreads;       // Those that reported with addWorkerSample()
+    qint64 m_workerBusyNs;
+    qint64 m_workerWindowStartNs; // Utilization is measured from here
+    qint64 m_nextAsyncId;
+
+    std::array<GpuFrame, PROFILER_GPU_LATENCY> m_gpuFrames;
+    int m_gpuFrame; // Slot the current frame's GPU scopes go into
+
+    Profiler();
+    bool counting() const;
+    void record(const char *name, qint64 startNs, qint64 durationNs, int track, qint64 asyncId = -1);
+    // The trace track of the calling thread, given one on its first sample. Needs m_lock.
+    int currentThreadTrack();
+    // Busy share of the pool threads seen since m_workerWindowStartNs, from 0 to 1. Needs m_lock.
+    float workerUtilization(int *threadCount) const;
+    GLuint takeQuery(GpuFrame &frame);
+    // Reads back the queries of the given slot, which must be PROFILER_GPU_LATENCY frames old
+    void collectGpuFrame(GpuFrame &frame);
+
+public:
+    // The profiler shared by every part of the program
+    static Profiler& instance();
+
+    // Enables the GPU timers. Until then, PROFILE_PASS only times the CPU.
+    void create(OpenGLContext *context);
+    void destroy();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    // Starts keeping every sample for exportChromeTrace(), dropping any earlier ones
+    void setRecording(bool recording);
+    bool isRecording() const;
+
+    // Call once per frame, before any PROFILE_PASS in it
+    void beginFrame();
+
+    qint64 nowNs() const;
+    void addCpuSample(const char *name, qint64 startNs, qint64 endNs);
+    // Returns false, and starts nothing, if the GPU can not be timed right now
+    bool beginGpuScope(const char *name, qint64 cpuStartNs);
+    void endGpuScope();
+    // The median GPU time of the given PROFILE_PASS, or -1 without samples
+    float gpuMedianMs(const std::string &name) const;
+
+    // May be called from any thread. Times one job run by a worker thread,
+    // counting towards the workers' utilization.
+    void addWorkerSample(const char *name, qint64 startNs, qint64 endNs);
+    // May be called from any thread. Times work that is not a pool job of its
+    // own, such as a step of the simulation thread or a part of one, so it
+    // gets a track and a histogram but does not count towards utilization.
+    void addThreadSample(const char *name, qint64 startNs, qint64 endNs);
+    // Times one hop of an item through a pipeline. Hops sharing an id from
+    // nextAsyncId() are drawn on one row of the trace.
+    void addLatencySample(const char *name, qint64 startNs, qint64 endNs, qint64 asyncId);
+    qint64 nextAsyncId();
+
+    // Prints p50/p95/p99 of every section to stdout
+    void printReport() const;
+    // One row per section: its sample count, mean, percentiles and maximum.
+    // A last "pool" row gives the worker threads' busy percentage as its mean.
+    bool exportCsv(const std::string &path) const;
+    // Every recorded event, in the Chrome trace event format
+    bool exportChromeTrace(const std::string &path) const;
+};
+
+// Times the enclosing C++ scope on the CPU
+class ProfileScope
+{
+private:
+    const char *m_name;
+    qint64 m_startNs; // -1 when the profiler was disabled
+public:
+    ProfileScope(const char *name);
+    ~ProfileScope();
+    qint64 startNs() const;
+};
+
+// Times the enclosing C++ scope on both the CPU and the GPU
+class ProfilePassScope
+{
+private:
+    ProfileScope m_cpu;
+    bool m_gpu; // Did the GPU query start?
+public:
+    ProfilePassScope(const char *name);
+    ~ProfilePassScope();
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// The name must be a string literal, or otherwise outlive the profiler
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_PASS(name) ProfilePassScope PROFILE_CONCAT(profilePass, __LINE__)(name)
+
+#endif // PROFILER_H
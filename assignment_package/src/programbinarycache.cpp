@@ -0,0 +1,231 @@
+#include "programbinarycache.h"
+#include "openglcontext.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QOpenGLContext>
+#include <QDebug>
+#include <iostream>
+#include <cstring>
+
+ProgramBinaryCache::ProgramBinaryCache(OpenGLContext *context)
+    : mp_context(context), m_directory(), m_driver(),
+      m_initialized(false), m_supported(false)
+{}
+
+void ProgramBinaryCache::initialize() {
+    if(m_initialized) {
+        return;
+    }
+    m_initialized = true;
+
+    // Binaries are core in 4.1, and available to our 4.0 context
+    // only through ARB_get_program_binary
+    QOpenGLContext *ctx = mp_context->context();
+    QSurfaceFormat format = ctx->format();
+    bool hasEntryPoints = format.majorVersion() > 4 ||
+                          (format.majorVersion() == 4 && format.minorVersion() >= 1) ||
+                          ctx->hasExtension(QByteArray("GL_ARB_get_program_binary"));
+    GLint numFormats = 0;
+    if(hasEntryPoints) {
+        mp_context->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    }
+
+    m_directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+    m_supported = numFormats > 0 && QDir().mkpath(m_directory);
+    if(!m_supported) {
+        std::cout << "Program binaries are unavailable, every shader will be compiled from source" << std::endl;
+        return;
+    }
+
+    m_driver.append(reinterpret_cast<const char*>(mp_context->glGetString(GL_VENDOR)));
+    m_driver.append('\n');
+    m_driver.append(reinterpret_cast<const char*>(mp_context->glGetString(GL_RENDERER)));
+    m_driver.append('\n');
+    m_driver.append(reinterpret_cast<const char*>(mp_context->glGetString(GL_VERSION)));
+}
+
+QString ProgramBinaryCache::pathFor(const QByteArray &key) const {
+    return m_directory + "/" + QString(key.toHex()) + ".bin";
+}
+
+QByteArray ProgramBinaryCache::readSource(const char *fileName) {
+    QSet<QString> included;
+    return readSource(QString(fileName), &included);
+}
+
+QByteArray ProgramBinaryCache::readSource(const QString &fileName, QSet<QString> *included) {
+    QFile file(fileName);
+    if(!file.open(QFile::ReadOnly)) {
+        std::cerr << "Could not open shader " << fileName.toStdString() << std::endl;
+        return QByteArray();
+    }
+    included->insert(fileName);
+    QString directory = QFileInfo(fileName).path();
+    QByteArray source;
+    while(!file.atEnd()) {
+        QByteArray line = file.readLine();
+        QByteArray directive = line.trimmed();
+        if(!directive.startsWith("#include")) {
+            source += line;
+            continue;
+        }
+        // #include "name.glsl" splices in a file from the same directory, once per program
+        int open = directive.indexOf('"');
+        int close = directive.lastIndexOf('"');
+        if(open < 0 || close <= open) {
+            std::cerr << "Malformed #include in shader " << fileName.toStdString() << std::endl;
+            continue;
+        }
+        QString includedName = directory + "/" + QString::fromUtf8(directive.mid(open + 1, close - open - 1));
+        if(!included->contains(includedName)) {
+            source += readSource(includedName, included);
+            source += '\n';
+        }
+    }
+    return source;
+}
+
+QByteArray ProgramBinaryCache::keyFor(const QByteArray &vertSource, const QByteArray &fragSource) {
+    initialize();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_driver);
+    // Separators keep different splits of the same text from colliding
+    hash.addData("\0", 1);
+    hash.addData(vertSource);
+    hash.addData("\0", 1);
+    hash.addData(fragSource);
+    return hash.result();
+}
+
+bool ProgramBinaryCache::load(GLuint prog, const QByteArray &key) {
+    initialize();
+    if(!m_supported) {
+        return false;
+    }
+    QFile file(pathFor(key));
+    if(!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    // The file holds the binary's format, then the binary itself
+    QByteArray contents = file.readAll();
+    if(contents.size() <= static_cast<int>(sizeof(GLenum))) {
+        return false;
+    }
+    GLenum binaryFormat;
+    std::memcpy(&binaryFormat, contents.constData(), sizeof(GLenum));
+    mp_context->glProgramBinary(prog, binaryFormat, contents.constData() + sizeof(GLenum),
+                                contents.size() - sizeof(GLenum));
+
+    // A driver update may reject an old binary, which leaves prog unlinked
+    GLint linked = GL_FALSE;
+    mp_context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void ProgramBinaryCache::prepareForStore(GLuint prog) {
+    initialize();
+    if(m_supported) {
+        mp_context->glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+void ProgramBinaryCache::store(GLuint prog, const QByteArray &key) {
+    initialize();
+    if(!m_supported) {
+        return;
+    }
+    GLint length = 0;
+    mp_context->glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) {
+        return;
+    }
+    QByteArray contents(sizeof(GLenum) + length, '\0');
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    mp_context->glGetProgramBinary(prog, length, &written, &binaryFormat, contents.data() + sizeof(GLenum));
+    std::memcpy(contents.data(), &binaryFormat, sizeof(GLenum));
+    contents.resize(sizeof(GLenum) + written);
+
+    // Written to a temporary file first, so a crash never leaves a torn binary behind
+    QSaveFile file(pathFor(key));
+    if(file.open(QFile::WriteOnly)) {
+        file.write(contents);
+        file.commit();
+    }
+}
+
+GLuint ProgramBinaryCache::build(const QByteArray &vertSource, const QByteArray &fragSource) {
+    GLuint prog = mp_context->glCreateProgram();
+
+    // A program this driver has already built on an earlier launch is loaded as-is
+    QByteArray key = keyFor(vertSource, fragSource);
+    if(load(prog, key)) {
+        return prog;
+    }
+    // Allocate space on our GPU for a vertex shader and a fragment shader
+    GLuint vertShader = mp_context->glCreateShader(GL_VERTEX_SHADER);
+    GLuint fragShader = mp_context->glCreateShader(GL_FRAGMENT_SHADER);
+
+    // Send the shader text to OpenGL straight from the files' bytes
+    const char *vertText = vertSource.constData();
+    const char *fragText = fragSource.constData();
+    GLint vertLength = vertSource.size();
+    GLint fragLength = fragSource.size();
+    mp_context->glShaderSource(vertShader, 1, &vertText, &vertLength);
+    mp_context->glShaderSource(fragShader, 1, &fragText, &fragLength);
+    // Tell OpenGL to compile the shader text stored above
+    mp_context->glCompileShader(vertShader);
+    mp_context->glCompileShader(fragShader);
+    printShaderInfoLog(vertShader);
+    printShaderInfoLog(fragShader);
+
+    // Tell prog that it manages these particular vertex and fragment shaders
+    mp_context->glAttachShader(prog, vertShader);
+    mp_context->glAttachShader(prog, fragShader);
+    prepareForStore(prog);
+    mp_context->glLinkProgram(prog);
+
+    // Only a program that linked is worth keeping
+    GLint linked;
+    mp_context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        printLinkInfoLog(prog);
+    } else {
+        store(prog, key);
+    }
+
+    // The linked program no longer needs its shaders
+    mp_context->glDetachShader(prog, vertShader);
+    mp_context->glDetachShader(prog, fragShader);
+    mp_context->glDeleteShader(vertShader);
+    mp_context->glDeleteShader(fragShader);
+    return prog;
+}
+
+void ProgramBinaryCache::printShaderInfoLog(GLuint shader) {
+    GLint compiled;
+    mp_context->glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    GLint infoLogLen = 0;
+    mp_context->glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLen);
+    if(compiled || infoLogLen <= 0) {
+        return;
+    }
+    QByteArray infoLog(infoLogLen, '\0');
+    mp_context->glGetShaderInfoLog(shader, infoLogLen, nullptr, infoLog.data());
+    qDebug() << "ShaderInfoLog:" << "\n" << infoLog.constData() << "\n";
+}
+
+void ProgramBinaryCache::printLinkInfoLog(GLuint prog) {
+    GLint infoLogLen = 0;
+    mp_context->glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &infoLogLen);
+    if(infoLogLen <= 0) {
+        return;
+    }
+    QByteArray infoLog(infoLogLen, '\0');
+    mp_context->glGetProgramInfoLog(prog, infoLogLen, nullptr, infoLog.data());
+    qDebug() << "LinkInfoLog:" << "\n" << infoLog.constData() << "\n";
+}
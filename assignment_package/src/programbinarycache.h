@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+#include <QOpenGLExtraFunctions>
+
+class OpenGLContext;
+
+// Keeps the driver's compiled form of every linked program on disk, under
+// the user's cache directory, so later launches can skip compiling GLSL.
+// Binaries are keyed by a hash of the program's sources and the driver's
+// vendor, renderer and version strings, since they are only valid for the
+// driver that produced them. A binary the driver rejects is simply rebuilt
+// from source and overwritten.
+class ProgramBinaryCache
+{
+private:
+    OpenGLContext *mp_context;
+    QString m_directory;  // Where the binaries are stored
+    QByteArray m_driver;  // Vendor, renderer and version of the current driver
+    bool m_initialized;
+    bool m_supported;     // Can the driver save and load binaries at all?
+
+    // Looks up driver support and the cache directory once a context is current
+    void initialize();
+    QString pathFor(const QByteArray &key) const;
+    // As the public readSource, skipping the files already in included
+    static QByteArray readSource(const QString &fileName, QSet<QString> *included);
+
+    // The key under which the program built from these sources is cached
+    QByteArray keyFor(const QByteArray &vertSource, const QByteArray &fragSource);
+    // Loads the cached binary for key into prog.
+    // Returns whether prog is now successfully linked.
+    bool load(GLuint prog, const QByteArray &key);
+    // Call before linking a program that will be passed to store()
+    void prepareForStore(GLuint prog);
+    // Saves the binary of the linked program prog under key
+    void store(GLuint prog, const QByteArray &key);
+    // Print the compile log of shader, or the link log of prog, if they failed
+    void printShaderInfoLog(GLuint shader);
+    void printLinkInfoLog(GLuint prog);
+
+public:
+    ProgramBinaryCache(OpenGLContext *context);
+
+    // Reads a shader file as the raw bytes handed to glShaderSource, with
+    // each #include "name.glsl" line replaced by that file, read the same way.
+    // A file included more than once is only spliced in the first time.
+    static QByteArray readSource(const char *fileName);
+
+    // Creates a program from the given vertex and fragment shader sources,
+    // loading its cached binary if there is one and compiling, linking and
+    // caching it otherwise. Errors are printed, and the program is returned
+    // either way.
+    GLuint build(const QByteArray &vertSource, const QByteArray &fragSource);
+};
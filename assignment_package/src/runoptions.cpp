@@ -0,0 +1,61 @@
+#include "runoptions.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+RunOptions::RunOptions()
+    : recordPath(), replayPath(), benchmark(false), benchmarkSpeed(40.f), uploadThread(false), entities(0),
+      spatialBenchmark(0)
+{}
+
+RunOptions& RunOptions::current() {
+    static RunOptions options;
+    return options;
+}
+
+bool RunOptions::parse(int argc, char *argv[]) {
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if(arg == "--replay" && hasValue) {
+            replayPath = argv[++i];
+        } else if(arg == "--benchmark") {
+            benchmark = true;
+        } else if(arg == "--benchmark-speed" && hasValue && std::atof(argv[i + 1]) > 0.f) {
+            benchmarkSpeed = std::atof(argv[++i]);
+        } else if(arg == "--upload-thread") {
+            uploadThread = true;
+        } else if(arg == "--entities" && hasValue && std::atoi(argv[i + 1]) >= 0) {
+            entities = std::atoi(argv[++i]);
+        } else if(arg == "--spatial-benchmark" && hasValue && std::atoi(argv[i + 1]) > 0) {
+            spatialBenchmark = std::atoi(argv[++i]);
+        } else {
+            std::cout << "Unknown argument " << arg << "\n"
+                      << "Usage: " << argv[0] << " [--record FILE | --replay FILE]"
+                      << " [--benchmark [--benchmark-speed BLOCKS_PER_SECOND]]"
+                      << " [--upload-thread] [--entities COUNT]"
+                      << " [--spatial-benchmark COUNT]" << std::endl;
+            return false;
+        }
+    }
+    if(!recordPath.empty() && !replayPath.empty()) {
+        std::cout << "--record and --replay can not be used together" << std::endl;
+        return false;
+    }
+    if(benchmark && !replayPath.empty()) {
+        std::cout << "--benchmark flies its own path, so it can not replay input" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RunOptions::hasFlag(int argc, char *argv[], const char *flag) {
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], flag) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,27 @@
+#ifndef RUNOPTIONS_H
+#define RUNOPTIONS_H
+
+#include <string>
+
+// How the program was asked to run, read from its command line in main()
+struct RunOptions
+{
+    std::string recordPath; // --record FILE: log the input of every tick to FILE
+    std::string replayPath; // --replay FILE: drive the Player from FILE instead of the user
+    bool benchmark;         // --benchmark: fly a fixed path, report the run and quit
+    float benchmarkSpeed;   // --benchmark-speed N: how fast, in blocks per second
+    bool uploadThread;      // --upload-thread: create Chunk VBOs on a thread with a shared GL context
+    int entities;           // --entities N: spawn N mobs and items around the Player once they can move
+    int spatialBenchmark;   // --spatial-benchmark N: time the entity spatial hash with N points and quit
+
+    RunOptions();
+
+    // The options of this run
+    static RunOptions& current();
+    // Returns false, after printing the usage, if an argument is not understood
+    bool parse(int argc, char *argv[]);
+    // Whether the flag was given, for the few options needed before QApplication exists
+    static bool hasFlag(int argc, char *argv[], const char *flag);
+};
+
+#endif // RUNOPTIONS_H
@@ -242,5 +242,17 @@ bool Biome::isCave(int x, int y, int z)
     }
 }
 
+glm::vec4 Biome::grassTint(int x, int z)
+{
+    const glm::vec4 grasslandGreen = glm::vec4(164, 255, 117, 255) / 255.f;
+    const glm::vec4 mountainGreen = glm::vec4(35, 100, 2, 255) / 255.f;
+    const glm::vec4 waterlandGreen = glm::vec4(100, 171, 63, 255) / 255.f;
+
+    float biome = 0.5f * (perlinNoise(x / 1750.f, z / 1750.f) + 1.f);
+    biome = glm::smoothstep(0.4f, 0.6f, glm::smoothstep(0.25f, 0.75f, biome));
+    glm::vec4 grasslandWaterGreen = glm::mix(grasslandGreen, waterlandGreen, biome);
+    return glm::mix(grasslandWaterGreen, mountainGreen, biome);
+}
+
 Biome::~Biome()
 {}
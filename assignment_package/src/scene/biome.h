@@ -14,6 +14,10 @@ public:
 
     static bool isCave(int x, int y, int z);
 
+    // The color grass takes at column (x, z), blending the grassland,
+    // waterland and mountain greens by a low-frequency noise field
+    static glm::vec4 grassTint(int x, int z);
+
     ~Biome();
 };
 
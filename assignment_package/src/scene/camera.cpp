@@ -7,7 +7,7 @@ Camera::Camera(glm::vec3 pos)
 
 Camera::Camera(unsigned int w, unsigned int h, glm::vec3 pos)
     : Entity(pos), m_fovy(45), m_width(w), m_height(h),
-      m_near_clip(0.1f), m_far_clip(1000.f), m_aspect(w / static_cast<float>(h))
+      m_near_clip(0.1f), m_far_clip(1500.f), m_aspect(w / static_cast<float>(h))
 {}
 
 Camera::Camera(const Camera &c)
@@ -36,6 +36,14 @@ glm::mat4 Camera::getViewProj() const {
     return glm::perspective(glm::radians(m_fovy), m_aspect, m_near_clip, m_far_clip) * glm::lookAt(m_position, m_position + m_forward, m_up);
 }
 
+glm::mat4 Camera::getViewProj(float nearClip, float farClip) const {
+    return glm::perspective(glm::radians(m_fovy), m_aspect, nearClip, farClip) * glm::lookAt(m_position, m_position + m_forward, m_up);
+}
+
+float Camera::getNearClip() const {
+    return m_near_clip;
+}
+
 void Camera::setPos(glm::vec3 pos) {
     m_position = pos;
 }
@@ -21,6 +21,10 @@ public:
     void tick(float dT, InputBundle &input) override;
 
     glm::mat4 getViewProj() const;
+    // The view-projection of the slice of this camera's frustum
+    // lying between the given view-space depths
+    glm::mat4 getViewProj(float nearClip, float farClip) const;
+    float getNearClip() const;
 
     void setPos(glm::vec3);
 };
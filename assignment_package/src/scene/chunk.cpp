@@ -1,12 +1,72 @@
 #include "chunk.h"
 
 
-Chunk::Chunk(OpenGLContext *context,glm::ivec2 global_pos) :  Drawable(context),m_countOpaque(-1),m_countTransp(-1),
-    m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-    m_bufIdxOpaque(),m_bufIdxTransp(),m_bufSingleOpaque(),m_bufSingleTransp(),
-    m_singleOpaqueGenerated(false),m_singleTranspGenerated(false),m_idxOpaqueGenerated(false),m_idxTranspGenerated(false),m_global_pos(global_pos)
+Chunk::Chunk(OpenGLContext *context,glm::ivec2 global_pos) :  Drawable(context),m_countOpaque(-1),m_countTransp(-1),m_opaqueMinY(0.f),m_opaqueMaxY(0.f),
+    m_blocks(), m_light(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}, m_columnTints(),
+    m_bufIdxOpaque(),m_bufIdxTransp(),m_bufSingleOpaque(),m_bufSingleTransp(),m_bufOpaquePos(),
+    m_singleOpaqueGenerated(false),m_singleTranspGenerated(false),m_idxOpaqueGenerated(false),m_idxTranspGenerated(false),m_opaquePosGenerated(false),m_global_pos(global_pos),
+    m_lightStitched(false)
 {
     std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    // Chunks built without a LightEngine look as if lit by the sky alone
+    m_light.fill(LIGHT_OPEN_AIR);
+    m_columnTints.fill(TINT_WHITE);
+}
+
+GLuint Chunk::getColumnTint(int x, int z) const {
+    return m_columnTints.at(x + 16 * z);
+}
+
+void Chunk::setColumnTint(int x, int z, GLuint tint) {
+    m_columnTints.at(x + 16 * z) = tint;
+}
+
+GLuint Chunk::getFaceTint(int x, int z, BlockType t, Direction d) const {
+    return isBiomeTinted(t, d) ? getColumnTint(x, z) : TINT_WHITE;
+}
+
+GLuint Chunk::getLitFaceTint(int x, int y, int z, BlockType t, Direction d) const {
+    glm::ivec3 facing = glm::ivec3(x, y, z) + glm::ivec3(adjacentFaces[d].directionVec);
+    return withLight(getFaceTint(x, z, t, d), getLightAt(facing.x, facing.y, facing.z));
+}
+
+unsigned char Chunk::getLightAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return m_light[x + 16 * y + 16 * 256 * z];
+}
+
+unsigned char Chunk::getLightAt(int x, int y, int z) const {
+    if(y > 255) {
+        return LIGHT_OPEN_AIR;
+    }
+    if(y < 0) {
+        return 0;
+    }
+    Direction d;
+    if(x > 15) {
+        d = XPOS;
+    } else if(x < 0) {
+        d = XNEG;
+    } else if(z > 15) {
+        d = ZPOS;
+    } else if(z < 0) {
+        d = ZNEG;
+    } else {
+        return getLightAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
+    }
+    const Chunk *neighbor = m_neighbors.at(d);
+    if(neighbor == nullptr) {
+        return LIGHT_OPEN_AIR;
+    }
+    return neighbor->getLightAt(static_cast<unsigned int>((x + 16) % 16), static_cast<unsigned int>(y),
+                                static_cast<unsigned int>((z + 16) % 16));
+}
+
+void Chunk::setLightAt(unsigned int x, unsigned int y, unsigned int z, unsigned char light) {
+    m_light[x + 16 * y + 16 * 256 * z] = light;
+}
+
+void Chunk::fillLight(unsigned char light) {
+    m_light.fill(light);
 }
 
 // Does bounds checking with at()
@@ -106,6 +166,11 @@ void Chunk::generateSingleTranspBuf() {
     mp_context->glGenBuffers(1, &m_bufSingleTransp);
 }
 
+void Chunk::generateOpaquePosBuf() {
+    m_opaquePosGenerated = true;
+    mp_context->glGenBuffers(1, &m_bufOpaquePos);
+}
+
 void Chunk::generateIdxOpaque(){
     m_idxOpaqueGenerated = true;
     mp_context->glGenBuffers(1, &m_bufIdxOpaque);
@@ -130,6 +195,13 @@ bool Chunk::bindSingleTranspBuf() {
     return m_singleTranspGenerated;
 }
 
+bool Chunk::bindOpaquePosBuf() {
+    if(m_opaquePosGenerated){
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpaquePos);
+    }
+    return m_opaquePosGenerated;
+}
+
 bool Chunk::bindIdxOpaque() {
     if(m_idxOpaqueGenerated){
         mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpaque);
@@ -158,6 +230,13 @@ void Chunk::clearSingleTranspBuf() {
     }
 }
 
+void Chunk::clearOpaquePosBuf() {
+    if(m_opaquePosGenerated) {
+        mp_context->glDeleteBuffers(1, &m_bufOpaquePos);
+        m_opaquePosGenerated = false;
+    }
+}
+
 void Chunk::clearIdxOpaqueBuf() {
     if(m_idxOpaqueGenerated) {
         mp_context->glDeleteBuffers(1, &m_bufIdxOpaque);
@@ -174,30 +253,75 @@ void Chunk::clearIdxTranspBuf() {
     }
 }
 
-void Chunk::createSingleOpaqueVBO(const std::vector<VertexData>& pnu_Buffer,const std::vector<GLuint>& idx_Buffer)
+void Chunk::createSingleOpaqueVBO(const std::vector<VertexData>& pnu_Buffer,const std::vector<GLuint>& idx_Buffer,
+                                  const std::vector<VertexPos>& pos_Buffer)
 {
     m_countOpaque = idx_Buffer.size();
-    generateIdxOpaque();
+    glm::vec2 extent = verticalExtent(pos_Buffer);
+    m_opaqueMinY = extent.x;
+    m_opaqueMaxY = extent.y;
+    // A remeshed Chunk refills its buffers in place, so it keeps
+    // drawing its old mesh until the new one is here
+    if(!m_idxOpaqueGenerated) {
+        generateIdxOpaque();
+    }
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpaque);
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_Buffer.size() * sizeof(GLuint), idx_Buffer.data(), GL_STATIC_DRAW);
 
-    generateSingleOpaqueBuf();
+    if(!m_singleOpaqueGenerated) {
+        generateSingleOpaqueBuf();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufSingleOpaque);
     mp_context->glBufferData(GL_ARRAY_BUFFER, pnu_Buffer.size() * sizeof(VertexData), pnu_Buffer.data(), GL_STATIC_DRAW);
+
+    // The position stream shares the opaque index buffer
+    if(!m_opaquePosGenerated) {
+        generateOpaquePosBuf();
+    }
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpaquePos);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, pos_Buffer.size() * sizeof(VertexPos), pos_Buffer.data(), GL_STATIC_DRAW);
 }
 
 void Chunk::createSingleTranspVBO(const std::vector<VertexData>& pnu_Buffer,const std::vector<GLuint>& idx_Buffer)
 {
     m_countTransp = idx_Buffer.size();
-    generateIdxTransp();
+    if(!m_idxTranspGenerated) {
+        generateIdxTransp();
+    }
     mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTransp);
     mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_Buffer.size() * sizeof(GLuint), idx_Buffer.data(), GL_STATIC_DRAW);
 
-    generateSingleTranspBuf();
+    if(!m_singleTranspGenerated) {
+        generateSingleTranspBuf();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufSingleTransp);
     mp_context->glBufferData(GL_ARRAY_BUFFER, pnu_Buffer.size() * sizeof(VertexData), pnu_Buffer.data(), GL_STATIC_DRAW);
 }
 
+void Chunk::adoptBuffers(const ChunkBuffers& buffers)
+{
+    destroy();
+    m_bufIdxOpaque = buffers.m_bufIdxOpaque;
+    m_bufSingleOpaque = buffers.m_bufSingleOpaque;
+    m_bufOpaquePos = buffers.m_bufOpaquePos;
+    m_bufIdxTransp = buffers.m_bufIdxTransp;
+    m_bufSingleTransp = buffers.m_bufSingleTransp;
+    m_idxOpaqueGenerated = m_singleOpaqueGenerated = m_opaquePosGenerated = true;
+    m_idxTranspGenerated = m_singleTranspGenerated = true;
+    m_countOpaque = buffers.m_countOpaque;
+    m_countTransp = buffers.m_countTransp;
+    m_opaqueMinY = buffers.m_opaqueMinY;
+    m_opaqueMaxY = buffers.m_opaqueMaxY;
+}
+
+void ChunkBuffers::release(QOpenGLExtraFunctions *gl)
+{
+    GLuint buffers[] = {m_bufIdxOpaque, m_bufSingleOpaque, m_bufOpaquePos, m_bufIdxTransp, m_bufSingleTransp};
+    gl->glDeleteBuffers(5, buffers);
+    gl->glDeleteSync(m_fence);
+    m_fence = nullptr;
+}
+
 bool Chunk::opaquevbogenerated() const
 {
     return m_singleOpaqueGenerated;
@@ -212,6 +336,7 @@ void Chunk::destroy()
 {
     clearSingleOpaqueBuf();
     clearSingleTranspBuf();
+    clearOpaquePosBuf();
     clearIdxOpaqueBuf();
     clearIdxTranspBuf();
 }
@@ -223,3 +348,26 @@ int Chunk::elemCountOpaque(){
 int Chunk::elemCountTransp(){
     return m_countTransp;
 }
+
+std::vector<VertexPos> packPositions(const std::vector<VertexData>& pnu_Buffer)
+{
+    std::vector<VertexPos> pos_Buffer;
+    pos_Buffer.reserve(pnu_Buffer.size());
+    for(const VertexData &v : pnu_Buffer) {
+        pos_Buffer.push_back(VertexPos(v.pos));
+    }
+    return pos_Buffer;
+}
+
+glm::vec2 verticalExtent(const std::vector<VertexPos>& pos_Buffer)
+{
+    if(pos_Buffer.empty()) {
+        return glm::vec2(0.f);
+    }
+    glm::vec2 extent(256.f, 0.f);
+    for(const VertexPos &v : pos_Buffer) {
+        extent.x = glm::min(extent.x, float(v.y));
+        extent.y = glm::max(extent.y, float(v.y));
+    }
+    return extent;
+}
@@ -2,14 +2,17 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "drawable.h"
+#include "chunktimeline.h"
+#include <glm/gtc/packing.hpp>
 #include <array>
 #include <unordered_map>
 #include <cstddef>
 #include <unordered_set>
 
-#define BLK_UVX * 0.0625
-#define BLK_UVY * 0.0625
-#define BLK_UV  0.0625
+// Block textures are the 16 x 16 cells of the texture atlas, one per layer of
+// the block texture array. Cells are numbered from the atlas' lower left corner.
+#define BLK_ATLAS_CELLS 16
+#define BLK_LAYER(col, row) ((col) + BLK_ATLAS_CELLS * (row))
 
 //using namespace std;
 
@@ -36,15 +39,53 @@ struct VertexPUData {
     {}
 };
 
+// An RGBA color packed into four normalized bytes
+#define TINT_WHITE 0xFFFFFFFFu
+inline GLuint packTint(const glm::vec4& color) {
+    return glm::packUnorm4x8(color);
+}
+
+// A block's light level packs 4 bits of skylight over 4 bits of block light,
+// each from 0 (dark) to LIGHT_MAX
+#define LIGHT_MAX 15
+#define LIGHT_SKY(l) ((l) >> 4)
+#define LIGHT_BLOCK(l) ((l) & 0xF)
+#define PACK_LIGHT(sky, block) static_cast<unsigned char>(((sky) << 4) | (block))
+// Full skylight and no block light, as in the open air
+#define LIGHT_OPEN_AIR PACK_LIGHT(LIGHT_MAX, 0)
+
+// The tint with its alpha replaced by a light level, which
+// the surface shaders decode to light the face with
+inline GLuint withLight(GLuint tint, unsigned char light) {
+    return (tint & 0x00FFFFFFu) | (GLuint(light) << 24);
+}
+
 struct VertexData {
     glm::vec4 pos;
     glm::vec4 nor;
-    glm::vec2 uv;
-    VertexData(const VertexPUData& PU,const glm::vec4& m_nor,const glm::vec4& posoffset,const glm::vec2& UVoffset)
-        :pos(PU.pos + posoffset),nor(m_nor),uv(PU.uv + UVoffset)
+    glm::vec3 uv; // Texture coordinates within one block texture, then its layer
+    GLuint tint; // RGB8 color the texture is multiplied by, then the face's light level, baked at mesh time
+    VertexData(const VertexPUData& PU,const glm::vec4& m_nor,const glm::vec4& posoffset,int layer,
+               GLuint m_tint = TINT_WHITE)
+        :pos(PU.pos + posoffset),nor(m_nor),uv(PU.uv, layer),tint(m_tint)
     {}
 };
 
+// A Chunk-local vertex position packed for the depth-only shadow pass.
+// Every coordinate is a whole number of blocks, so shorts hold it exactly
+// in a fifth of the space of a VertexData.
+struct VertexPos {
+    GLshort x, y, z, w;
+    VertexPos(const glm::vec4& p)
+        :x(GLshort(p.x)),y(GLshort(p.y)),z(GLshort(p.z)),w(1)
+    {}
+};
+
+// Extracts the position stream of already-built vertex data
+std::vector<VertexPos> packPositions(const std::vector<VertexData>& pnu_Buffer);
+// The lowest and highest Y of the given positions, or (0, 0) if there are none
+glm::vec2 verticalExtent(const std::vector<VertexPos>& pos_Buffer);
+
 struct BlockFace
 {
     Direction direction;
@@ -57,36 +98,42 @@ struct BlockFace
 
 const static std::array<BlockFace,6> adjacentFaces {
     BlockFace(XPOS,glm::vec4(1,0,0,0),VertexPUData(glm::vec4(1,0,1,1),glm::vec2(0,0)),
-                                      VertexPUData(glm::vec4(1,0,0,1),glm::vec2(BLK_UV,0)),
-                                      VertexPUData(glm::vec4(1,1,0,1),glm::vec2(BLK_UV,BLK_UV)),
-                                      VertexPUData(glm::vec4(1,1,1,1),glm::vec2(0,BLK_UV))),
+                                      VertexPUData(glm::vec4(1,0,0,1),glm::vec2(1,0)),
+                                      VertexPUData(glm::vec4(1,1,0,1),glm::vec2(1,1)),
+                                      VertexPUData(glm::vec4(1,1,1,1),glm::vec2(0,1))),
 
     BlockFace(XNEG,glm::vec4(-1,0,0,0),VertexPUData(glm::vec4(0,0,0,1),glm::vec2(0,0)),
-                                      VertexPUData(glm::vec4(0,0,1,1),glm::vec2(BLK_UV,0)),
-                                      VertexPUData(glm::vec4(0,1,1,1),glm::vec2(BLK_UV,BLK_UV)),
-                                      VertexPUData(glm::vec4(0,1,0,1),glm::vec2(0,BLK_UV))),
+                                      VertexPUData(glm::vec4(0,0,1,1),glm::vec2(1,0)),
+                                      VertexPUData(glm::vec4(0,1,1,1),glm::vec2(1,1)),
+                                      VertexPUData(glm::vec4(0,1,0,1),glm::vec2(0,1))),
 
     BlockFace(YPOS,glm::vec4(0,1,0,0),VertexPUData(glm::vec4(0,1,1,1),glm::vec2(0,0)),
-                                      VertexPUData(glm::vec4(1,1,1,1),glm::vec2(BLK_UV,0)),
-                                      VertexPUData(glm::vec4(1,1,0,1),glm::vec2(BLK_UV,BLK_UV)),
-                                      VertexPUData(glm::vec4(0,1,0,1),glm::vec2(0,BLK_UV))),
+                                      VertexPUData(glm::vec4(1,1,1,1),glm::vec2(1,0)),
+                                      VertexPUData(glm::vec4(1,1,0,1),glm::vec2(1,1)),
+                                      VertexPUData(glm::vec4(0,1,0,1),glm::vec2(0,1))),
 
     BlockFace(YNEG,glm::vec4(0,-1,0,0),VertexPUData(glm::vec4(0,0,0,1),glm::vec2(0,0)),
-                                      VertexPUData(glm::vec4(1,0,0,1),glm::vec2(BLK_UV,0)),
-                                      VertexPUData(glm::vec4(1,0,1,1),glm::vec2(BLK_UV,BLK_UV)),
-                                      VertexPUData(glm::vec4(0,0,1,1),glm::vec2(0,BLK_UV))),
+                                      VertexPUData(glm::vec4(1,0,0,1),glm::vec2(1,0)),
+                                      VertexPUData(glm::vec4(1,0,1,1),glm::vec2(1,1)),
+                                      VertexPUData(glm::vec4(0,0,1,1),glm::vec2(0,1))),
 
     BlockFace(ZPOS,glm::vec4(0,0,1,0),VertexPUData(glm::vec4(0,0,1,1),glm::vec2(0,0)),
-                                      VertexPUData(glm::vec4(1,0,1,1),glm::vec2(BLK_UV,0)),
-                                      VertexPUData(glm::vec4(1,1,1,1),glm::vec2(BLK_UV,BLK_UV)),
-                                      VertexPUData(glm::vec4(0,1,1,1),glm::vec2(0,BLK_UV))),
+                                      VertexPUData(glm::vec4(1,0,1,1),glm::vec2(1,0)),
+                                      VertexPUData(glm::vec4(1,1,1,1),glm::vec2(1,1)),
+                                      VertexPUData(glm::vec4(0,1,1,1),glm::vec2(0,1))),
 
     BlockFace(ZNEG,glm::vec4(0,0,-1,0),VertexPUData(glm::vec4(1,0,0,1),glm::vec2(0,0)),
-                                      VertexPUData(glm::vec4(0,0,0,1),glm::vec2(BLK_UV,0)),
-                                      VertexPUData(glm::vec4(0,1,0,1),glm::vec2(BLK_UV,BLK_UV)),
-                                      VertexPUData(glm::vec4(1,1,0,1),glm::vec2(0,BLK_UV)))
+                                      VertexPUData(glm::vec4(0,0,0,1),glm::vec2(1,0)),
+                                      VertexPUData(glm::vec4(0,1,0,1),glm::vec2(1,1)),
+                                      VertexPUData(glm::vec4(1,1,0,1),glm::vec2(0,1)))
 };
 
+// Whether this face uses the greyscale grass texture, which
+// takes its color from the biome tint of its column
+inline bool isBiomeTinted(BlockType t, Direction d) {
+    return t == GRASS && d == YPOS;
+}
+
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -101,49 +148,50 @@ const static std::unordered_set<BlockType,EnumHash> transparent_blocks{
 
 
 
-const static std::unordered_map<BlockType,std::unordered_map<Direction,glm::vec2,EnumHash>,EnumHash> blockFaceUVs{
-    {GRASS,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(3 BLK_UVX, 15 BLK_UVY)},
-                                                            {XNEG,glm::vec2(3 BLK_UVX, 15 BLK_UVY)},
-                                                            {YPOS,glm::vec2(8 BLK_UVX, 13 BLK_UVY)},
-                                                            {YNEG,glm::vec2(2 BLK_UVX, 15 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(3 BLK_UVX, 15 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(3 BLK_UVX, 15 BLK_UVY)}}},
-    {DIRT,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(2 BLK_UVX, 15 BLK_UVY)},
-                                                            {XNEG,glm::vec2(2 BLK_UVX, 15 BLK_UVY)},
-                                                            {YPOS,glm::vec2(2 BLK_UVX, 15 BLK_UVY)},
-                                                            {YNEG,glm::vec2(2 BLK_UVX, 15 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(2 BLK_UVX, 15 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(2 BLK_UVX, 15 BLK_UVY)}}},
-    {STONE,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(1 BLK_UVX, 15 BLK_UVY)},
-                                                            {XNEG,glm::vec2(1 BLK_UVX, 15 BLK_UVY)},
-                                                            {YPOS,glm::vec2(1 BLK_UVX, 15 BLK_UVY)},
-                                                            {YNEG,glm::vec2(1 BLK_UVX, 15 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(1 BLK_UVX, 15 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(1 BLK_UVX, 15 BLK_UVY)}}},
-    {WATER,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(13 BLK_UVX, 3 BLK_UVY)},
-                                                            {XNEG,glm::vec2(13 BLK_UVX, 3 BLK_UVY)},
-                                                            {YPOS,glm::vec2(13 BLK_UVX, 3 BLK_UVY)},
-                                                            {YNEG,glm::vec2(13 BLK_UVX, 3 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(13 BLK_UVX, 3 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(13 BLK_UVX, 3 BLK_UVY)}}},
-    {SNOW,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(2 BLK_UVX, 11 BLK_UVY)},
-                                                            {XNEG,glm::vec2(2 BLK_UVX, 11 BLK_UVY)},
-                                                            {YPOS,glm::vec2(2 BLK_UVX, 11 BLK_UVY)},
-                                                            {YNEG,glm::vec2(2 BLK_UVX, 11 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(2 BLK_UVX, 11 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(2 BLK_UVX, 11 BLK_UVY)}}},
-    {BEDROCK,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(1 BLK_UVX, 14 BLK_UVY)},
-                                                            {XNEG,glm::vec2(1 BLK_UVX, 14 BLK_UVY)},
-                                                            {YPOS,glm::vec2(1 BLK_UVX, 14 BLK_UVY)},
-                                                            {YNEG,glm::vec2(1 BLK_UVX, 14 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(1 BLK_UVX, 14 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(1 BLK_UVX, 14 BLK_UVY)}}},
-    {LAVA,std::unordered_map<Direction,glm::vec2,EnumHash>{{XPOS,glm::vec2(13 BLK_UVX, 1 BLK_UVY)},
-                                                            {XNEG,glm::vec2(13 BLK_UVX, 1 BLK_UVY)},
-                                                            {YPOS,glm::vec2(13 BLK_UVX, 1 BLK_UVY)},
-                                                            {YNEG,glm::vec2(13 BLK_UVX, 1 BLK_UVY)},
-                                                            {ZPOS,glm::vec2(13 BLK_UVX, 1 BLK_UVY)},
-                                                            {ZNEG,glm::vec2(13 BLK_UVX, 1 BLK_UVY)}}}
+// The block texture layer each face of each block type samples
+const static std::unordered_map<BlockType,std::unordered_map<Direction,int,EnumHash>,EnumHash> blockFaceLayers{
+    {GRASS,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(3, 15)},
+                                                            {XNEG,BLK_LAYER(3, 15)},
+                                                            {YPOS,BLK_LAYER(8, 13)},
+                                                            {YNEG,BLK_LAYER(2, 15)},
+                                                            {ZPOS,BLK_LAYER(3, 15)},
+                                                            {ZNEG,BLK_LAYER(3, 15)}}},
+    {DIRT,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(2, 15)},
+                                                            {XNEG,BLK_LAYER(2, 15)},
+                                                            {YPOS,BLK_LAYER(2, 15)},
+                                                            {YNEG,BLK_LAYER(2, 15)},
+                                                            {ZPOS,BLK_LAYER(2, 15)},
+                                                            {ZNEG,BLK_LAYER(2, 15)}}},
+    {STONE,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(1, 15)},
+                                                            {XNEG,BLK_LAYER(1, 15)},
+                                                            {YPOS,BLK_LAYER(1, 15)},
+                                                            {YNEG,BLK_LAYER(1, 15)},
+                                                            {ZPOS,BLK_LAYER(1, 15)},
+                                                            {ZNEG,BLK_LAYER(1, 15)}}},
+    {WATER,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(13, 3)},
+                                                            {XNEG,BLK_LAYER(13, 3)},
+                                                            {YPOS,BLK_LAYER(13, 3)},
+                                                            {YNEG,BLK_LAYER(13, 3)},
+                                                            {ZPOS,BLK_LAYER(13, 3)},
+                                                            {ZNEG,BLK_LAYER(13, 3)}}},
+    {SNOW,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(2, 11)},
+                                                            {XNEG,BLK_LAYER(2, 11)},
+                                                            {YPOS,BLK_LAYER(2, 11)},
+                                                            {YNEG,BLK_LAYER(2, 11)},
+                                                            {ZPOS,BLK_LAYER(2, 11)},
+                                                            {ZNEG,BLK_LAYER(2, 11)}}},
+    {BEDROCK,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(1, 14)},
+                                                            {XNEG,BLK_LAYER(1, 14)},
+                                                            {YPOS,BLK_LAYER(1, 14)},
+                                                            {YNEG,BLK_LAYER(1, 14)},
+                                                            {ZPOS,BLK_LAYER(1, 14)},
+                                                            {ZNEG,BLK_LAYER(1, 14)}}},
+    {LAVA,std::unordered_map<Direction,int,EnumHash>{{XPOS,BLK_LAYER(13, 1)},
+                                                            {XNEG,BLK_LAYER(13, 1)},
+                                                            {YPOS,BLK_LAYER(13, 1)},
+                                                            {YNEG,BLK_LAYER(13, 1)},
+                                                            {ZPOS,BLK_LAYER(13, 1)},
+                                                            {ZNEG,BLK_LAYER(13, 1)}}}
 };
 
 // One Chunk is a 16 x 256 x 16 section of the world,
@@ -154,48 +202,81 @@ const static std::unordered_map<BlockType,std::unordered_map<Direction,glm::vec2
 // to render the world block by block.
 
 // TODO have Chunk inherit from Drawable
+struct ChunkBuffers;
+
 class Chunk : public Drawable
 {
 private:
     // All of the blocks contained within this Chunk
     std::array<BlockType, 65536> m_blocks;
+    // The light level of each block, indexed like m_blocks
+    std::array<unsigned char, 65536> m_light;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
+    // Packed biome tint of each of the 16 x 16 columns, filled in with the blocks
+    std::array<GLuint, 256> m_columnTints;
     GLuint m_bufIdxOpaque; // A Vertex Buffer Object that we will use to store triangle indices (GLuints)
     GLuint m_bufIdxTransp; // A Vertex Buffer Object that we will use to store triangle indices (GLuints)
     GLuint m_bufSingleOpaque;
     GLuint m_bufSingleTransp;
+    GLuint m_bufOpaquePos; // Positions of the opaque vertices alone, read by the shadow pass
     bool m_singleOpaqueGenerated;
     bool m_singleTranspGenerated;
     bool m_idxOpaqueGenerated;
     bool m_idxTranspGenerated;
+    bool m_opaquePosGenerated;
 
 public:
     const glm::ivec2 m_global_pos;
     int m_countOpaque;
     int m_countTransp;
+    // Vertical extent of the opaque mesh, used to cull shadow casters
+    float m_opaqueMinY, m_opaqueMaxY;
+    // When this Chunk's zone was requested and filled by its FBMWorker
+    ChunkTimeline m_timeline;
+    // Has the LightEngine joined this Chunk's light up with its neighbors'?
+    // Only touched by the LightEngine's thread.
+    bool m_lightStitched;
     Chunk(OpenGLContext *context,glm::ivec2 global_pos);
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAtRTC(int x, int y, int z) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    unsigned char getLightAt(unsigned int x, unsigned int y, unsigned int z) const;
+    // As above, but reaching into the neighboring Chunks. Blocks above the
+    // world or in missing neighbors are in the open air, those below it dark.
+    unsigned char getLightAt(int x, int y, int z) const;
+    void setLightAt(unsigned int x, unsigned int y, unsigned int z, unsigned char light);
+    void fillLight(unsigned char light);
+    GLuint getColumnTint(int x, int z) const;
+    void setColumnTint(int x, int z, GLuint tint);
+    // The tint to bake into a face of the given block in column (x, z)
+    GLuint getFaceTint(int x, int z, BlockType t, Direction d) const;
+    // The above, carrying the light of the block the face looks into
+    GLuint getLitFaceTint(int x, int y, int z, BlockType t, Direction d) const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
     void createVBOdata() override;
     void generateIdxOpaque();
     void generateIdxTransp();
     void generateSingleOpaqueBuf();
     void generateSingleTranspBuf();
+    void generateOpaquePosBuf();
     bool bindSingleOpaqueBuf();
     bool bindSingleTranspBuf();
+    bool bindOpaquePosBuf();
     bool bindIdxOpaque();
     bool bindIdxTransp();
-    void createSingleOpaqueVBO(const std::vector<VertexData>& pnu_Buffer,const std::vector<GLuint>& idx_Buffer);
+    void createSingleOpaqueVBO(const std::vector<VertexData>& pnu_Buffer,const std::vector<GLuint>& idx_Buffer,
+                               const std::vector<VertexPos>& pos_Buffer);
     void createSingleTranspVBO(const std::vector<VertexData>& pnu_Buffer,const std::vector<GLuint>& idx_Buffer);
+    // Takes over buffers filled on the ChunkUploader's thread, deleting the ones they replace
+    void adoptBuffers(const ChunkBuffers& buffers);
     void clearSingleOpaqueBuf();
     void clearSingleTranspBuf();
+    void clearOpaquePosBuf();
     void clearIdxOpaqueBuf();
     void clearIdxTranspBuf();
     bool opaquevbogenerated() const;
@@ -212,9 +293,38 @@ struct ChunkVBOData {
     Chunk* mp_chunk;
     std::vector<VertexData> m_vboDataOpaque, m_vboDataTransparent;
     std::vector<GLuint> m_idxDataOpaque, m_idxDataTransparent;
+    std::vector<VertexPos> m_posDataOpaque;
+    // The trip through the pipeline that produced this data
+    ChunkTimeline m_timeline;
 
-    ChunkVBOData(Chunk* c) : mp_chunk(c),
+    ChunkVBOData(Chunk* c, const ChunkTimeline &timeline) : mp_chunk(c),
                              m_vboDataOpaque{}, m_vboDataTransparent{},
-                             m_idxDataOpaque{}, m_idxDataTransparent{}
+                             m_idxDataOpaque{}, m_idxDataTransparent{},
+                             m_posDataOpaque{}, m_timeline(timeline)
+    {}
+};
+
+// The GL buffers a ChunkUploader has created and filled from one
+// ChunkVBOData, ready to be swapped into their Chunk
+struct ChunkBuffers {
+    Chunk* mp_chunk;
+    GLuint m_bufIdxOpaque, m_bufSingleOpaque, m_bufOpaquePos;
+    GLuint m_bufIdxTransp, m_bufSingleTransp;
+    int m_countOpaque, m_countTransp;
+    float m_opaqueMinY, m_opaqueMaxY;
+    // Signaled once the GPU has the data, after which the render thread may draw it
+    GLsync m_fence;
+    ChunkTimeline m_timeline;
+
+    ChunkBuffers(Chunk* c, const ChunkTimeline &timeline) : mp_chunk(c),
+                             m_bufIdxOpaque(0), m_bufSingleOpaque(0), m_bufOpaquePos(0),
+                             m_bufIdxTransp(0), m_bufSingleTransp(0),
+                             m_countOpaque(0), m_countTransp(0),
+                             m_opaqueMinY(0.f), m_opaqueMaxY(0.f),
+                             m_fence(nullptr), m_timeline(timeline)
     {}
+
+    // Deletes the buffers and fence of an upload that will never be adopted,
+    // from any context sharing with the one that filled them
+    void release(QOpenGLExtraFunctions *gl);
 };
@@ -0,0 +1,43 @@
+#include "chunktimeline.h"
+#include "profiler.h"
+
+namespace {
+struct StageSpan {
+    ChunkStage from, to;
+    const char *name;
+};
+
+const StageSpan STAGE_SPANS[] = {
+    {ZONE_REQUESTED, FBM_START, "fbm queue"},
+    {FBM_START, FBM_END, "fbm"},
+    {FBM_END, MESH_QUEUED, "mesh dispatch"},
+    {MESH_QUEUED, MESH_START, "mesh queue"},
+    {MESH_START, MESH_END, "mesh"},
+    {MESH_END, UPLOADED, "upload wait"},
+};
+}
+
+ChunkTimeline::ChunkTimeline()
+{
+    stamps.fill(-1);
+}
+
+void ChunkTimeline::stamp(ChunkStage stage) {
+    stamps[stage] = Profiler::instance().nowNs();
+}
+
+void ChunkTimeline::report() const {
+    Profiler &profiler = Profiler::instance();
+    if(!profiler.isEnabled()) {
+        return;
+    }
+    qint64 id = profiler.nextAsyncId();
+    for(const StageSpan &span : STAGE_SPANS) {
+        if(stamps[span.from] >= 0 && stamps[span.to] >= 0) {
+            profiler.addLatencySample(span.name, stamps[span.from], stamps[span.to], id);
+        }
+    }
+    if(stamps[ZONE_REQUESTED] >= 0 && stamps[UPLOADED] >= 0) {
+        profiler.addLatencySample("request to upload", stamps[ZONE_REQUESTED], stamps[UPLOADED], id);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <QtGlobal>
+#include <array>
+
+// The points a Chunk passes on its way from a requested terrain zone
+// through FBMWorker, VBOWorker and checkThreadResults to the GPU
+enum ChunkStage : unsigned char {
+    ZONE_REQUESTED, FBM_START, FBM_END, MESH_QUEUED, MESH_START, MESH_END, UPLOADED, CHUNK_STAGE_COUNT
+};
+
+// When one trip of a Chunk through the terrain pipeline reached each stage,
+// on the profiler's clock. A remesh starts its trip at MESH_QUEUED.
+// Each stage is stamped by whichever thread holds the Chunk at that point
+// and only read after the handoff to the next one, so it needs no lock.
+struct ChunkTimeline {
+    std::array<qint64, CHUNK_STAGE_COUNT> stamps; // -1 for stages not reached
+
+    ChunkTimeline();
+    void stamp(ChunkStage stage);
+    // Hands the time between each pair of reached stages,
+    // and the whole trip, to the profiler
+    void report() const;
+};
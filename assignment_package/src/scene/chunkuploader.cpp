@@ -0,0 +1,135 @@
+#include "chunkuploader.h"
+#include "profiler.h"
+#include <iostream>
+
+ChunkUploader::ChunkUploader()
+    : mp_glContext(nullptr), mp_surface(nullptr), m_pending(), m_uploaded(),
+      m_lock(), m_wake(), m_stopping(false)
+{}
+
+ChunkUploader::~ChunkUploader() {
+    stop();
+}
+
+bool ChunkUploader::start(QOpenGLContext *shareContext) {
+    // Both have to be made on the GUI thread
+    mp_surface = new QOffscreenSurface();
+    mp_surface->setFormat(shareContext->format());
+    mp_surface->create();
+    mp_glContext = new QOpenGLContext();
+    mp_glContext->setFormat(shareContext->format());
+    mp_glContext->setShareContext(shareContext);
+    if(!mp_surface->isValid() || !mp_glContext->create()
+            || !QOpenGLContext::areSharing(mp_glContext, shareContext)) {
+        std::cout << "Could not share a GL context with the upload thread, so Chunks upload on the render thread" << std::endl;
+        delete mp_glContext;
+        delete mp_surface;
+        mp_glContext = nullptr;
+        mp_surface = nullptr;
+        return false;
+    }
+    mp_glContext->moveToThread(this);
+    QThread::start();
+    return true;
+}
+
+void ChunkUploader::stop() {
+    if(!isActive()) {
+        return;
+    }
+    m_lock.lock();
+    m_stopping = true;
+    m_wake.wakeAll();
+    m_lock.unlock();
+    wait();
+    // The shared objects outlive the context. run() has deleted any the render
+    // thread never took, and the rest are its own to delete.
+    delete mp_glContext;
+    mp_glContext = nullptr;
+    mp_surface->destroy();
+    delete mp_surface;
+    mp_surface = nullptr;
+}
+
+bool ChunkUploader::isActive() const {
+    return mp_glContext != nullptr;
+}
+
+void ChunkUploader::upload(std::vector<ChunkVBOData> &data) {
+    QMutexLocker locker(&m_lock);
+    m_pending.insert(m_pending.end(), std::make_move_iterator(data.begin()), std::make_move_iterator(data.end()));
+    data.clear();
+    m_wake.wakeOne();
+}
+
+std::vector<ChunkBuffers> ChunkUploader::takeUploaded() {
+    std::vector<ChunkBuffers> uploaded;
+    QMutexLocker locker(&m_lock);
+    uploaded.swap(m_uploaded);
+    return uploaded;
+}
+
+void ChunkUploader::run() {
+    mp_glContext->makeCurrent(mp_surface);
+    QOpenGLExtraFunctions *gl = mp_glContext->extraFunctions();
+    m_lock.lock();
+    while(true) {
+        while(m_pending.empty() && !m_stopping) {
+            m_wake.wait(&m_lock);
+        }
+        if(m_stopping) {
+            break;
+        }
+        std::vector<ChunkVBOData> batch;
+        batch.swap(m_pending);
+        m_lock.unlock();
+
+        qint64 startNs = Profiler::instance().nowNs();
+        std::vector<ChunkBuffers> filled;
+        filled.reserve(batch.size());
+        for(const ChunkVBOData &data : batch) {
+            filled.push_back(fill(gl, data));
+        }
+        // Fences only signal once the commands before them reach the GPU
+        gl->glFlush();
+        Profiler::instance().addThreadSample("upload", startNs, Profiler::instance().nowNs());
+
+        m_lock.lock();
+        m_uploaded.insert(m_uploaded.end(), filled.begin(), filled.end());
+    }
+    // Nothing will adopt these now, so they go while there is still a context to delete them from
+    m_pending.clear();
+    for(ChunkBuffers &buffers : m_uploaded) {
+        buffers.release(gl);
+    }
+    m_uploaded.clear();
+    m_lock.unlock();
+    mp_glContext->doneCurrent();
+}
+
+// Buffers have no type of their own, so each is filled through the copy
+// target, which unlike the element array target needs no vertex array bound
+static GLuint createBuffer(QOpenGLExtraFunctions *gl, size_t size, const void *data) {
+    GLuint buf;
+    gl->glGenBuffers(1, &buf);
+    gl->glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+    gl->glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+    return buf;
+}
+
+ChunkBuffers ChunkUploader::fill(QOpenGLExtraFunctions *gl, const ChunkVBOData &data) const {
+    ChunkBuffers buffers(data.mp_chunk, data.m_timeline);
+    buffers.m_countOpaque = data.m_idxDataOpaque.size();
+    buffers.m_countTransp = data.m_idxDataTransparent.size();
+    glm::vec2 extent = verticalExtent(data.m_posDataOpaque);
+    buffers.m_opaqueMinY = extent.x;
+    buffers.m_opaqueMaxY = extent.y;
+
+    buffers.m_bufIdxOpaque = createBuffer(gl, data.m_idxDataOpaque.size() * sizeof(GLuint), data.m_idxDataOpaque.data());
+    buffers.m_bufSingleOpaque = createBuffer(gl, data.m_vboDataOpaque.size() * sizeof(VertexData), data.m_vboDataOpaque.data());
+    buffers.m_bufOpaquePos = createBuffer(gl, data.m_posDataOpaque.size() * sizeof(VertexPos), data.m_posDataOpaque.data());
+    buffers.m_bufIdxTransp = createBuffer(gl, data.m_idxDataTransparent.size() * sizeof(GLuint), data.m_idxDataTransparent.data());
+    buffers.m_bufSingleTransp = createBuffer(gl, data.m_vboDataTransparent.size() * sizeof(VertexData), data.m_vboDataTransparent.data());
+    buffers.m_fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return buffers;
+}
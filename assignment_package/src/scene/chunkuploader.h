@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <vector>
+#include "chunk.h"
+
+// Creates and fills Chunk VBOs on its own thread, through a GL context
+// sharing its objects with the render thread's. The render thread hands
+// over finished meshes with upload(), and later swaps the buffers into
+// their Chunks once takeUploaded() returns them and their fences signal,
+// so it never waits on the driver copying the data.
+class ChunkUploader : public QThread
+{
+private:
+    QOpenGLContext *mp_glContext;
+    QOffscreenSurface *mp_surface;
+    std::vector<ChunkVBOData> m_pending;
+    std::vector<ChunkBuffers> m_uploaded;
+    QMutex m_lock; // Guards both queues and m_stopping
+    QWaitCondition m_wake;
+    bool m_stopping;
+
+    ChunkBuffers fill(QOpenGLExtraFunctions *gl, const ChunkVBOData &data) const;
+
+protected:
+    void run() override;
+
+public:
+    ChunkUploader();
+    ~ChunkUploader();
+
+    // Call from the render thread with its context current. Returns false,
+    // and starts nothing, if no context sharing with it could be made.
+    bool start(QOpenGLContext *shareContext);
+    void stop();
+    bool isActive() const;
+
+    void upload(std::vector<ChunkVBOData> &data);
+    // Returns and forgets the buffers filled so far, in the order their data was handed over
+    std::vector<ChunkBuffers> takeUploaded();
+};
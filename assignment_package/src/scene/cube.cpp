@@ -136,6 +136,9 @@ void Cube::createVBOdata()
     glm::vec4 sph_vert_nor[CUB_VERT_COUNT];
 
     createCubeVertexPositions(sph_vert_pos);
+    for(glm::vec4 &p : sph_vert_pos) {
+        p = glm::vec4(glm::mix(m_min, m_max, glm::vec3(p)), 1.f);
+    }
     createCubeVertexNormals(sph_vert_nor);
     createCubeIndices(sph_idx);
 
@@ -166,12 +169,16 @@ void Cube::createVBOdata()
 void Cube::createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) {
     m_numInstances = offsets.size();
 
-    generateOffsetBuf();
+    if(!m_offsetGenerated) {
+        generateOffsetBuf();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STATIC_DRAW);
+    // Respecified rather than updated, so the driver need not wait on last frame's draw
+    mp_context->glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STREAM_DRAW);
 
-
-    generateCol();
+    if(!m_colGenerated) {
+        generateCol();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_STREAM_DRAW);
 }
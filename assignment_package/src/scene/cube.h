@@ -7,11 +7,17 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
 
+// A box, by default the unit cube, drawn once at each of its instance offsets
 class Cube : public InstancedDrawable
 {
+private:
+    glm::vec3 m_min, m_max; // Corners of the box, relative to each instance offset
+
 public:
-    Cube(OpenGLContext* context) : InstancedDrawable(context){}
+    Cube(OpenGLContext* context) : Cube(context, glm::vec3(0.f), glm::vec3(1.f)){}
+    Cube(OpenGLContext* context, glm::vec3 min, glm::vec3 max) : InstancedDrawable(context), m_min(min), m_max(max){}
     virtual ~Cube(){}
     void createVBOdata() override;
+    // May be called every frame. The instance buffers are only created once.
     void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) override;
 };
@@ -1,5 +1,21 @@
 #include "entity.h"
 
+Pose::Pose()
+    : position(0,0,0), forward(0,0,-1), right(1,0,0), up(0,1,0)
+{}
+
+Pose Pose::blend(const Pose &a, const Pose &b, float t) {
+    Pose pose;
+    pose.position = glm::mix(a.position, b.position, t);
+    // One step's turn is small, so blending the axes and
+    // squaring them up again is as good as a slerp
+    pose.forward = glm::normalize(glm::mix(a.forward, b.forward, t));
+    glm::vec3 up = glm::normalize(glm::mix(a.up, b.up, t));
+    pose.right = glm::normalize(glm::cross(pose.forward, up));
+    pose.up = glm::cross(pose.right, pose.forward);
+    return pose;
+}
+
 Entity::Entity()
     :  Entity(glm::vec3(0,0,0))
 {}
@@ -80,6 +96,28 @@ void Entity::rotateOnRightGlobal(float degrees) {
     m_up = glm::vec3(glm::rotate(glm::mat4(), rad, glm::vec3(1,0,0)) * glm::vec4(m_up, 0.f));
 }
 
+void Entity::lookAlong(glm::vec3 forward) {
+    m_forward = glm::normalize(forward);
+    m_right = glm::normalize(glm::cross(m_forward, glm::vec3(0,1,0)));
+    m_up = glm::cross(m_right, m_forward);
+}
+
+Pose Entity::getPose() const {
+    Pose pose;
+    pose.position = m_position;
+    pose.forward = m_forward;
+    pose.right = m_right;
+    pose.up = m_up;
+    return pose;
+}
+
+void Entity::applyPose(const Pose &pose) {
+    m_position = pose.position;
+    m_forward = pose.forward;
+    m_right = pose.right;
+    m_up = pose.up;
+}
+
 void Entity::rotateOnUpGlobal(float degrees) {
     float rad = glm::radians(degrees);
     m_forward = glm::vec3(glm::rotate(glm::mat4(), rad, glm::vec3(0,1,0)) * glm::vec4(m_forward, 0.f));
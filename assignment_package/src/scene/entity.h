@@ -6,7 +6,11 @@ struct InputBundle {
     bool upPressed, downPressed, rightPressed, leftPressed;
     bool spacePressed;
     bool flightMode;
+    // Degrees the mouse has turned the camera about the world's up axis
+    // and its own right axis since the last tick
     float mouseX, mouseY;
+    // Block edits clicked since the last tick
+    bool leftClicked, rightClicked;
 
     InputBundle()
         : wPressed(false), aPressed(false), sPressed(false),
@@ -14,10 +18,22 @@ struct InputBundle {
           upPressed(false), downPressed(false),
           rightPressed(false), leftPressed(false),
           spacePressed(false), flightMode(true),
-          mouseX(0.f), mouseY(0.f)
+          mouseX(0.f), mouseY(0.f),
+          leftClicked(false), rightClicked(false)
     {}
 };
 
+// Where an Entity is and which way it faces, as plain data that can
+// be handed between threads
+struct Pose {
+    glm::vec3 position;
+    glm::vec3 forward, right, up;
+
+    Pose();
+    // The pose the given fraction of the way from a to b
+    static Pose blend(const Pose &a, const Pose &b, float t);
+};
+
 class Entity {
 protected:
     // Vectors that define the axes of our local coordinate system
@@ -60,4 +76,11 @@ public:
     virtual void rotateOnForwardGlobal(float degrees);
     virtual void rotateOnRightGlobal(float degrees);
     virtual void rotateOnUpGlobal(float degrees);
+
+    // Turn to face along the given direction, keeping our right axis level
+    virtual void lookAlong(glm::vec3 forward);
+
+    Pose getPose() const;
+    // Take on the given position and axes
+    void applyPose(const Pose &pose);
 };
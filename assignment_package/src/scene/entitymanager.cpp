@@ -0,0 +1,228 @@
+#include "entitymanager.h"
+#include "voxelcollision.h"
+
+#define ENTITY_GRAVITY 29.4f
+#define MOB_WALK_SPEED 2.f
+#define MOB_JUMP_SPEED 8.f
+// Entities below this are removed
+#define ENTITY_KILL_Y -64.f
+// Resting entities slower than this skip collision entirely
+#define ENTITY_REST_SPEED 0.01f
+// How fast overlapping mobs move apart, in blocks per second per block of overlap
+#define MOB_SEPARATION_SPEED 4.f
+
+glm::vec3 entityKindMin(EntityKind kind) {
+    return kind == MOB ? glm::vec3(-0.4f, 0.f, -0.4f) : glm::vec3(-0.15f, 0.f, -0.15f);
+}
+
+glm::vec3 entityKindMax(EntityKind kind) {
+    return kind == MOB ? glm::vec3(0.4f, 1.6f, 0.4f) : glm::vec3(0.15f, 0.3f, 0.15f);
+}
+
+EntityManager::EntityManager()
+    : m_kinds(), m_positions(), m_prevPositions(), m_velocities(),
+      m_boxMins(), m_boxMaxs(), m_colors(), m_wanderTimers(), m_grounded(), m_rng(1234),
+      m_spatial(), m_neighbors(), m_separations()
+{}
+
+int EntityManager::count() const {
+    return static_cast<int>(m_kinds.size());
+}
+
+int EntityManager::spawn(EntityKind kind, glm::vec3 pos, glm::vec3 velocity) {
+    std::uniform_real_distribution<float> shade(0.6f, 1.f);
+    m_kinds.push_back(kind);
+    m_positions.push_back(pos);
+    m_prevPositions.push_back(pos);
+    m_velocities.push_back(velocity);
+    m_boxMins.push_back(entityKindMin(kind));
+    m_boxMaxs.push_back(entityKindMax(kind));
+    m_colors.push_back(kind == MOB ? glm::vec3(0.9f, 0.6f, 0.6f) * shade(m_rng)
+                                   : glm::vec3(0.9f, 0.8f, 0.3f) * shade(m_rng));
+    m_wanderTimers.push_back(0.f);
+    m_grounded.push_back(false);
+    m_spatial.insert(count() - 1, pos);
+    return count() - 1;
+}
+
+void EntityManager::spawnAround(const Terrain &terrain, glm::vec3 center, float radius, int count) {
+    std::uniform_real_distribution<float> offset(-radius, radius);
+    std::uniform_real_distribution<float> chance(0.f, 1.f);
+    for(int n = 0; n < count; ++n) {
+        int x = static_cast<int>(glm::floor(center.x + offset(m_rng)));
+        int z = static_cast<int>(glm::floor(center.z + offset(m_rng)));
+        const Chunk *c = terrain.chunkAt(x, z);
+        if(c == nullptr) {
+            continue;
+        }
+        unsigned int localX = x - c->m_global_pos.x;
+        unsigned int localZ = z - c->m_global_pos.y;
+        for(int y = 255; y >= 0; --y) {
+            if(isSolidBlock(c->getBlockAt(localX, static_cast<unsigned int>(y), localZ))) {
+                spawn(chance(m_rng) < 0.8f ? MOB : ITEM, glm::vec3(x + 0.5f, y + 1.f, z + 0.5f));
+                break;
+            }
+        }
+    }
+}
+
+void EntityManager::remove(int i) {
+    int last = count() - 1;
+    m_spatial.remove(i);
+    if(last != i) {
+        m_spatial.renumber(last, i);
+    }
+    m_kinds[i] = m_kinds[last];
+    m_positions[i] = m_positions[last];
+    m_prevPositions[i] = m_prevPositions[last];
+    m_velocities[i] = m_velocities[last];
+    m_boxMins[i] = m_boxMins[last];
+    m_boxMaxs[i] = m_boxMaxs[last];
+    m_colors[i] = m_colors[last];
+    m_wanderTimers[i] = m_wanderTimers[last];
+    m_grounded[i] = m_grounded[last];
+    m_kinds.pop_back();
+    m_positions.pop_back();
+    m_prevPositions.pop_back();
+    m_velocities.pop_back();
+    m_boxMins.pop_back();
+    m_boxMaxs.pop_back();
+    m_colors.pop_back();
+    m_wanderTimers.pop_back();
+    m_grounded.pop_back();
+}
+
+void EntityManager::wander(int i) {
+    std::uniform_real_distribution<float> angle(0.f, 2.f * glm::pi<float>());
+    std::uniform_real_distribution<float> seconds(1.f, 5.f);
+    std::uniform_real_distribution<float> chance(0.f, 1.f);
+    // Some of the time a mob stands still instead
+    float speed = chance(m_rng) < 0.7f ? MOB_WALK_SPEED : 0.f;
+    float a = angle(m_rng);
+    m_velocities[i].x = speed * glm::cos(a);
+    m_velocities[i].z = speed * glm::sin(a);
+    m_wanderTimers[i] = seconds(m_rng);
+}
+
+void EntityManager::separateMobs(float dT) {
+    m_separations.assign(count(), glm::vec3(0.f));
+    for(int i = 0; i < count(); ++i) {
+        if(m_kinds[i] != MOB) {
+            continue;
+        }
+        float reach = 2.f * m_boxMaxs[i].x;
+        m_neighbors.clear();
+        m_spatial.queryRange(m_positions[i], reach, &m_neighbors);
+        for(int j : m_neighbors) {
+            if(j == i || m_kinds[j] != MOB) {
+                continue;
+            }
+            glm::vec2 away(m_positions[i].x - m_positions[j].x, m_positions[i].z - m_positions[j].z);
+            float dist = glm::length(away);
+            // Mobs at the very same spot part along an arbitrary axis
+            glm::vec2 dir = dist > 0.001f ? away / dist : glm::vec2(i < j ? 1.f : -1.f, 0.f);
+            glm::vec2 push = dir * (reach - dist) * MOB_SEPARATION_SPEED * dT;
+            m_separations[i].x += push.x;
+            m_separations[i].z += push.y;
+        }
+    }
+}
+
+void EntityManager::tick(float dT, const Terrain &terrain) {
+    m_prevPositions = m_positions;
+
+    // Steering, for mobs only
+    for(int i = 0; i < count(); ++i) {
+        if(m_kinds[i] != MOB) {
+            continue;
+        }
+        m_wanderTimers[i] -= dT;
+        if(m_wanderTimers[i] <= 0.f) {
+            wander(i);
+        }
+    }
+    separateMobs(dT);
+
+    // Gravity and drag, for everything
+    for(int i = 0; i < count(); ++i) {
+        m_velocities[i].y -= ENTITY_GRAVITY * dT;
+        if(m_kinds[i] == ITEM && m_grounded[i]) {
+            m_velocities[i].x *= 0.8f;
+            m_velocities[i].z *= 0.8f;
+        }
+    }
+
+    // Collision
+    for(int i = 0; i < count(); ++i) {
+        glm::vec3 &pos = m_positions[i];
+        glm::vec3 &vel = m_velocities[i];
+        if(terrain.chunkAt(static_cast<int>(glm::floor(pos.x)), static_cast<int>(glm::floor(pos.z))) == nullptr) {
+            vel = glm::vec3(0.f);
+            continue;
+        }
+        // An item lying still stays put as long as the block under it does
+        if(m_grounded[i] && m_kinds[i] == ITEM
+                && glm::length(glm::vec2(vel.x, vel.z)) < ENTITY_REST_SPEED
+                && isSolidBlock(terrain.getBlockAt(pos - glm::vec3(0.f, 0.05f, 0.f)))) {
+            vel = glm::vec3(0.f);
+            continue;
+        }
+        glm::bvec3 hit;
+        glm::vec3 motion = sweepAABB(terrain, AABB(pos + m_boxMins[i], pos + m_boxMaxs[i]), vel * dT + m_separations[i], &hit);
+        pos += motion;
+        m_grounded[i] = hit.y && vel.y < 0.f;
+        if(hit.y) {
+            vel.y = 0.f;
+        }
+        if(m_kinds[i] == MOB) {
+            // A mob walking into a wall hops, in case it is a single step,
+            // and keeps walking so it can get on top of it
+            if((hit.x || hit.z) && m_grounded[i]) {
+                vel.y = MOB_JUMP_SPEED;
+            }
+        } else {
+            if(hit.x) {
+                vel.x = 0.f;
+            }
+            if(hit.z) {
+                vel.z = 0.f;
+            }
+        }
+        m_spatial.move(i, pos);
+    }
+
+    for(int i = count() - 1; i >= 0; --i) {
+        if(m_positions[i].y < ENTITY_KILL_Y) {
+            remove(i);
+        }
+    }
+}
+
+void EntityManager::gatherInstances(EntityKind kind, EntityInstances *out) const {
+    out->prevOffsets.clear();
+    out->offsets.clear();
+    out->colors.clear();
+    for(int i = 0; i < count(); ++i) {
+        if(m_kinds[i] == kind) {
+            out->prevOffsets.push_back(m_prevPositions[i]);
+            out->offsets.push_back(m_positions[i]);
+            out->colors.push_back(m_colors[i]);
+        }
+    }
+}
+
+glm::vec3 EntityManager::positionOf(int i) const {
+    return m_positions[i];
+}
+
+EntityKind EntityManager::kindOf(int i) const {
+    return m_kinds[i];
+}
+
+void EntityManager::entitiesInRange(glm::vec3 center, float radius, std::vector<int> *out) const {
+    m_spatial.queryRange(center, radius, out);
+}
+
+void EntityManager::nearestEntities(glm::vec3 center, int k, float maxRadius, std::vector<int> *out) const {
+    m_spatial.queryNearest(center, k, maxRadius, out);
+}
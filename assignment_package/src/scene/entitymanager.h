@@ -0,0 +1,77 @@
+#pragma once
+#include "glm_includes.h"
+#include "terrain.h"
+#include "spatialhash.h"
+#include <array>
+#include <random>
+#include <vector>
+
+// The kinds of entity besides the Player. Each is drawn with
+// one instanced draw of its own mesh.
+enum EntityKind : unsigned char {
+    MOB, ITEM, ENTITY_KIND_COUNT
+};
+
+// The box each kind fills, relative to the middle of its base
+glm::vec3 entityKindMin(EntityKind kind);
+glm::vec3 entityKindMax(EntityKind kind);
+
+// What the render thread needs to draw every entity of one kind
+struct EntityInstances {
+    std::vector<glm::vec3> prevOffsets; // Positions before the last step
+    std::vector<glm::vec3> offsets;     // and after it
+    std::vector<glm::vec3> colors;
+};
+
+// Every mob and item in the world. The per-entity state is stored as one
+// array per field rather than one object per entity, so each pass over the
+// entities only reads the fields it needs, and they are all stepped in one
+// batch against the Terrain with sweepAABB.
+// Entity i is element i of each array. Removing one moves the last into its place.
+class EntityManager {
+private:
+    std::vector<EntityKind> m_kinds;
+    std::vector<glm::vec3> m_positions;     // Middle of the base of the box
+    std::vector<glm::vec3> m_prevPositions; // As of the start of the last step
+    std::vector<glm::vec3> m_velocities;
+    std::vector<glm::vec3> m_boxMins, m_boxMaxs; // The box, relative to the position
+    std::vector<glm::vec3> m_colors;
+    std::vector<float> m_wanderTimers;           // Seconds until a mob picks a new heading
+    std::vector<unsigned char> m_grounded;       // Was the last step's fall stopped by a block?
+    std::mt19937 m_rng; // Fixed seed, so replays spawn and steer the same way
+    // Every entity's position by index, kept up to date as they move
+    SpatialHash m_spatial;
+    // Reused by the separation pass
+    std::vector<int> m_neighbors;
+    // How far the separation pass moves each entity this step, on top of its velocity
+    std::vector<glm::vec3> m_separations;
+
+    void remove(int i);
+    // A new heading and timer for mob i
+    void wander(int i);
+    // Fills m_separations, moving mobs that stand inside one another apart.
+    // A displacement rather than a push on the velocity, so it stops once they part.
+    void separateMobs(float dT);
+
+public:
+    EntityManager();
+
+    int count() const;
+    // Returns the new entity's index
+    int spawn(EntityKind kind, glm::vec3 pos, glm::vec3 velocity = glm::vec3(0.f));
+    // Spawns entities standing on the ground at random within radius of center.
+    // Spots in Chunks that do not exist yet are skipped.
+    void spawnAround(const Terrain &terrain, glm::vec3 center, float radius, int count);
+    // Moves every entity by one step, colliding with the Terrain.
+    // Entities in Chunks that do not exist are frozen until they do.
+    void tick(float dT, const Terrain &terrain);
+    void gatherInstances(EntityKind kind, EntityInstances *out) const;
+
+    glm::vec3 positionOf(int i) const;
+    EntityKind kindOf(int i) const;
+    // Appends the index of every entity within radius of center
+    void entitiesInRange(glm::vec3 center, float radius, std::vector<int> *out) const;
+    // Appends the indices of the k entities nearest to center, nearest first,
+    // leaving out any farther than maxRadius
+    void nearestEntities(glm::vec3 center, int k, float maxRadius, std::vector<int> *out) const;
+};
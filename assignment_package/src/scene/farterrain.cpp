@@ -0,0 +1,349 @@
+#include "farterrain.h"
+#include "terrain.h"
+#include "biome.h"
+#include "shaderprogram.h"
+#include "profiler.h"
+
+// How far from the player, in blocks, far tiles are drawn
+#define FAR_TERRAIN_RADIUS 1024
+// Distances to a tile's nearest point at which its voxel scale doubles
+#define FAR_LOD2_DISTANCE 192
+#define FAR_LOD4_DISTANCE 448
+// FBMWorker turns the EMPTY blocks below this height into WATER
+#define FAR_SEA_LEVEL 139
+
+FarTile::FarTile(OpenGLContext *context, glm::ivec2 origin)
+    : Drawable(context), m_origin(origin), m_step(0), m_pendingStep(0)
+{}
+
+void FarTile::createVBOdata()
+{}
+
+void FarTile::createFarVBO(const std::vector<VertexData> &vertData, const std::vector<GLuint> &idxData, int step)
+{
+    // Replace the mesh of the previous level of detail, if there is one
+    destroyVBOdata();
+    m_step = step;
+    m_count = idxData.size();
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxData.size() * sizeof(GLuint), idxData.data(), GL_STATIC_DRAW);
+
+    // Position, normal and UV are interleaved in m_bufPos exactly like a Chunk's VBO
+    generatePos();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, vertData.size() * sizeof(VertexData), vertData.data(), GL_STATIC_DRAW);
+}
+
+
+// The top of one sampled column of terrain
+struct FarColumn {
+    int ground;     // Height of the topmost solid block's top face
+    int surface;    // Height of the visible surface (the water level over lakes)
+    BlockType groundTop;
+    BlockType surfaceTop;
+    GLuint groundTint;  // Biome tint of the ground's top face
+};
+
+// Mirrors the block choices FBMWorker::fillYSpace makes for the top of a column
+static FarColumn sampleColumn(int x, int z)
+{
+    FarColumn col;
+    col.ground = Biome::getHeight(x, z);
+    if (col.ground < 150) {
+        col.groundTop = GRASS;
+    } else if (col.ground > 200) {
+        col.groundTop = SNOW;
+    } else {
+        col.groundTop = STONE;
+    }
+    col.groundTint = isBiomeTinted(col.groundTop, YPOS) ? packTint(Biome::grassTint(x, z)) : TINT_WHITE;
+    if (col.ground < FAR_SEA_LEVEL) {
+        col.surface = FAR_SEA_LEVEL;
+        col.surfaceTop = WATER;
+    } else {
+        col.surface = col.ground;
+        col.surfaceTop = col.groundTop;
+    }
+    return col;
+}
+
+static int farFaceLayer(BlockType t, Direction d)
+{
+    return blockFaceLayers.at(t).at(d);
+}
+
+// Texture coordinates run one unit per block along the face's plane, so a
+// merged quad repeats its block texture instead of stretching it; the
+// texture array's mipmaps keep that repetition from aliasing at a distance
+static void pushQuad(FarTileData &dat, const glm::vec4 &a, const glm::vec4 &b,
+                     const glm::vec4 &c, const glm::vec4 &d,
+                     const glm::vec4 &nor, int layer, GLuint tint = TINT_WHITE)
+{
+    GLuint idx = dat.m_vboData.size();
+    for (const glm::vec4 &p : {a, b, c, d}) {
+        glm::vec2 uv = nor.y != 0 ? glm::vec2(p.x, p.z) : (nor.x != 0 ? glm::vec2(p.z, p.y) : glm::vec2(p.x, p.y));
+        // Far terrain has no light levels, so it is lit as the open air
+        dat.m_vboData.push_back(VertexData(VertexPUData(p, uv), nor, glm::vec4(0.f), layer, withLight(tint, LIGHT_OPEN_AIR)));
+    }
+    dat.m_idxData.push_back(idx);
+    dat.m_idxData.push_back(idx + 1);
+    dat.m_idxData.push_back(idx + 2);
+    dat.m_idxData.push_back(idx);
+    dat.m_idxData.push_back(idx + 2);
+    dat.m_idxData.push_back(idx + 3);
+}
+
+FarTileWorker::FarTileWorker(int64_t key, glm::ivec2 origin, int step,
+                             std::vector<FarTileData> *dat, QMutex *datLock)
+    : m_key(key), m_origin(origin), m_step(step),
+      mp_tilesCompleted(dat), mp_tilesCompletedLock(datLock)
+{}
+
+void FarTileWorker::run()
+{
+    qint64 startNs = Profiler::instance().nowNs();
+    FarTileData t(m_key, m_step);
+    const int cells = FAR_TILE_SIZE / m_step;
+    const int stride = cells + 2;
+    const float step = m_step;
+    // The coarse surface can overshoot the real blocks by about one cell, so
+    // sink it by that much to keep it underneath any full-detail Chunks it overlaps
+    const float sink = step;
+    // Tile borders get skirts that hang this far below the lower of the two
+    // sides, hiding the cracks between neighbouring tiles of different scales
+    const float skirt = 2.f * step;
+
+    // Sample one column per cell, plus a one-cell border so
+    // faces along the tile's edges know their neighbours
+    std::vector<FarColumn> cols(stride * stride);
+    for (int j = -1; j <= cells; ++j) {
+        for (int i = -1; i <= cells; ++i) {
+            cols[(i + 1) + (j + 1) * stride] = sampleColumn(m_origin.x + i * m_step + m_step / 2,
+                                                            m_origin.y + j * m_step + m_step / 2);
+        }
+    }
+    auto colAt = [&](int i, int j) -> const FarColumn& {
+        return cols[(i + 1) + (j + 1) * stride];
+    };
+
+    // Top faces. Runs of cells along X with the same surface are merged into one quad.
+    // A run keeps the tint of its first cell, as the biome tint only changes over thousands of blocks.
+    for (int j = 0; j < cells; ++j) {
+        int i = 0;
+        while (i < cells) {
+            const FarColumn &c = colAt(i, j);
+            int run = 1;
+            while (i + run < cells) {
+                const FarColumn &n = colAt(i + run, j);
+                if (n.surface != c.surface || n.ground != c.ground || n.surfaceTop != c.surfaceTop) {
+                    break;
+                }
+                run++;
+            }
+            float x0 = i * step, x1 = (i + run) * step;
+            float z0 = j * step, z1 = z0 + step;
+            if (c.surfaceTop == WATER) {
+                // Lake bed first so the translucent water blends over it
+                float yb = c.ground - sink;
+                pushQuad(t, glm::vec4(x0, yb, z1, 1), glm::vec4(x1, yb, z1, 1),
+                         glm::vec4(x1, yb, z0, 1), glm::vec4(x0, yb, z0, 1),
+                         glm::vec4(0, 1, 0, 0), farFaceLayer(c.groundTop, YPOS), c.groundTint);
+            }
+            float y = c.surface - sink;
+            pushQuad(t, glm::vec4(x0, y, z1, 1), glm::vec4(x1, y, z1, 1),
+                     glm::vec4(x1, y, z0, 1), glm::vec4(x0, y, z0, 1),
+                     glm::vec4(0, 1, 0, 0), farFaceLayer(c.surfaceTop, YPOS),
+                     c.surfaceTop == c.groundTop ? c.groundTint : TINT_WHITE);
+            i += run;
+        }
+    }
+
+    // Side faces wherever a cell's ground stands above its neighbour's
+    for (int j = 0; j < cells; ++j) {
+        for (int i = 0; i < cells; ++i) {
+            const FarColumn &c = colAt(i, j);
+            float top = c.ground - sink;
+            float x0 = i * step, x1 = x0 + step;
+            float z0 = j * step, z1 = z0 + step;
+            for (const BlockFace &face : adjacentFaces) {
+                if (face.direction == YPOS || face.direction == YNEG) {
+                    continue;
+                }
+                int ni = i + static_cast<int>(face.directionVec.x);
+                int nj = j + static_cast<int>(face.directionVec.z);
+                float bottom = colAt(ni, nj).ground - sink;
+                if (ni < 0 || ni >= cells || nj < 0 || nj >= cells) {
+                    bottom = glm::min(top, bottom) - skirt;
+                } else if (bottom >= top) {
+                    continue;
+                }
+                int layer = farFaceLayer(c.groundTop, face.direction);
+                switch (face.direction) {
+                case XPOS:
+                    pushQuad(t, glm::vec4(x1, bottom, z1, 1), glm::vec4(x1, bottom, z0, 1),
+                             glm::vec4(x1, top, z0, 1), glm::vec4(x1, top, z1, 1), face.directionVec, layer);
+                    break;
+                case XNEG:
+                    pushQuad(t, glm::vec4(x0, bottom, z0, 1), glm::vec4(x0, bottom, z1, 1),
+                             glm::vec4(x0, top, z1, 1), glm::vec4(x0, top, z0, 1), face.directionVec, layer);
+                    break;
+                case ZPOS:
+                    pushQuad(t, glm::vec4(x0, bottom, z1, 1), glm::vec4(x1, bottom, z1, 1),
+                             glm::vec4(x1, top, z1, 1), glm::vec4(x0, top, z1, 1), face.directionVec, layer);
+                    break;
+                default:
+                    pushQuad(t, glm::vec4(x1, bottom, z0, 1), glm::vec4(x0, bottom, z0, 1),
+                             glm::vec4(x0, top, z0, 1), glm::vec4(x1, top, z0, 1), face.directionVec, layer);
+                    break;
+                }
+            }
+        }
+    }
+
+    Profiler::instance().addWorkerSample("far tile", startNs, Profiler::instance().nowNs());
+    mp_tilesCompletedLock->lock();
+    mp_tilesCompleted->push_back(std::move(t));
+    mp_tilesCompletedLock->unlock();
+}
+
+
+FarTerrain::FarTerrain(OpenGLContext *context)
+    : m_tiles(), m_tilesThatHaveVBOs(), m_tilesThatHaveVBOsLock(), m_pool(),
+      m_centerTile(0, 0), m_hasCenter(false), mp_context(context), m_drawOffsets(context)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+FarTerrain::~FarTerrain()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void FarTerrain::destroy()
+{
+    for (auto &kv : m_tiles) {
+        kv.second->destroyVBOdata();
+    }
+    m_drawOffsets.destroy();
+}
+
+int FarTerrain::stepForDistance(float dist)
+{
+    if (dist < FAR_LOD2_DISTANCE) {
+        return 2;
+    }
+    if (dist < FAR_LOD4_DISTANCE) {
+        return 4;
+    }
+    return 8;
+}
+
+float FarTerrain::distanceToTile(glm::vec2 p, glm::ivec2 origin)
+{
+    float dx = glm::max(glm::max(origin.x - p.x, p.x - (origin.x + FAR_TILE_SIZE)), 0.f);
+    float dz = glm::max(glm::max(origin.y - p.y, p.y - (origin.y + FAR_TILE_SIZE)), 0.f);
+    return glm::length(glm::vec2(dx, dz));
+}
+
+void FarTerrain::update(glm::vec3 playerPos)
+{
+    glm::ivec2 centerTile(FAR_TILE_SIZE * glm::floor(playerPos.x / FAR_TILE_SIZE),
+                          FAR_TILE_SIZE * glm::floor(playerPos.z / FAR_TILE_SIZE));
+    // The rings only change when the player crosses into another tile
+    if (m_hasCenter && centerTile == m_centerTile) {
+        return;
+    }
+    m_hasCenter = true;
+    m_centerTile = centerTile;
+    glm::vec2 p(playerPos.x, playerPos.z);
+
+    // Evict the tiles that fell out of range
+    for (auto it = m_tiles.begin(); it != m_tiles.end();) {
+        if (distanceToTile(p, it->second->m_origin) > FAR_TERRAIN_RADIUS) {
+            it->second->destroyVBOdata();
+            it = m_tiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Request new tiles and re-level the ones whose ring changed
+    int radiusInTiles = FAR_TERRAIN_RADIUS / FAR_TILE_SIZE + 1;
+    for (int i = -radiusInTiles; i <= radiusInTiles; ++i) {
+        for (int j = -radiusInTiles; j <= radiusInTiles; ++j) {
+            glm::ivec2 origin = centerTile + FAR_TILE_SIZE * glm::ivec2(i, j);
+            float dist = distanceToTile(p, origin);
+            if (dist > FAR_TERRAIN_RADIUS) {
+                continue;
+            }
+            int step = stepForDistance(dist);
+            int64_t key = toKey(origin.x, origin.y);
+            uPtr<FarTile> &tile = m_tiles[key];
+            if (tile == nullptr) {
+                tile = mkU<FarTile>(mp_context, origin);
+            }
+            if (tile->m_pendingStep != step) {
+                tile->m_pendingStep = step;
+                // Nearer tiles are meshed first
+                m_pool.start(new FarTileWorker(key, origin, step, &m_tilesThatHaveVBOs, &m_tilesThatHaveVBOsLock),
+                             -static_cast<int>(dist / FAR_TILE_SIZE));
+            }
+        }
+    }
+}
+
+void FarTerrain::checkThreadResults()
+{
+    m_tilesThatHaveVBOsLock.lock();
+    for (FarTileData &td : m_tilesThatHaveVBOs) {
+        auto it = m_tiles.find(td.m_key);
+        // Drop meshes for tiles that were evicted or re-levelled in the meantime
+        if (it != m_tiles.end() && it->second->m_pendingStep == td.m_step) {
+            it->second->createFarVBO(td.m_vboData, td.m_idxData, td.m_step);
+        }
+    }
+    m_tilesThatHaveVBOs.clear();
+    m_tilesThatHaveVBOsLock.unlock();
+}
+
+bool FarTerrain::isCoveredByChunks(const FarTile &tile, const Terrain &terrain,
+                                   int minX, int maxX, int minZ, int maxZ) const
+{
+    if (tile.m_origin.x < minX || tile.m_origin.x + FAR_TILE_SIZE > maxX ||
+        tile.m_origin.y < minZ || tile.m_origin.y + FAR_TILE_SIZE > maxZ) {
+        return false;
+    }
+    // Keep drawing the tile as a stand-in until all of its Chunks can be drawn
+    for (int x = tile.m_origin.x; x < tile.m_origin.x + FAR_TILE_SIZE; x += 16) {
+        for (int z = tile.m_origin.y; z < tile.m_origin.y + FAR_TILE_SIZE; z += 16) {
+            if (!terrain.hasChunkAt(x, z) || !terrain.getChunkAt(x, z)->opaquevbogenerated()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void FarTerrain::draw(int minX, int maxX, int minZ, int maxZ,
+                      const Terrain &terrain, ShaderProgram *shaderProgram)
+{
+    std::vector<FarTile*> visible;
+    m_drawOffsets.clear();
+    for (auto &kv : m_tiles) {
+        FarTile &tile = *kv.second;
+        if (tile.elemCount() <= 0 || isCoveredByChunks(tile, terrain, minX, maxX, minZ, maxZ)) {
+            continue;
+        }
+        visible.push_back(&tile);
+        m_drawOffsets.add(tile.m_origin);
+    }
+    m_drawOffsets.upload();
+    m_drawOffsets.beginPass(shaderProgram->attrChunkOffset);
+    for (int i = 0; i < static_cast<int>(visible.size()); i++) {
+        shaderProgram->drawFarTile(*visible[i], m_drawOffsets, i);
+    }
+    m_drawOffsets.endPass();
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "glm_includes.h"
+#include "drawable.h"
+#include "chunk.h"
+#include "drawoffsetbuffer.h"
+#include <QRunnable>
+#include <QMutex>
+#include <QThreadPool>
+#include <unordered_map>
+#include <vector>
+
+class ShaderProgram;
+class Terrain;
+
+// Edge length, in blocks, of one far-field terrain tile
+#define FAR_TILE_SIZE 128
+
+// A heightmap tile of the far-field terrain. Far tiles never
+// hold any block data: their mesh is built straight from
+// Biome::getHeight, sampling one column every m_step blocks,
+// so a tile costs a small fraction of the Chunks it stands in for.
+class FarTile : public Drawable
+{
+public:
+    // World-space XZ coordinates of the tile's lower-left corner
+    const glm::ivec2 m_origin;
+    // Voxel scale of the mesh currently on the GPU (0 if none yet)
+    int m_step;
+    // Voxel scale of the most recently requested mesh
+    int m_pendingStep;
+
+    FarTile(OpenGLContext *context, glm::ivec2 origin);
+    virtual ~FarTile(){};
+
+    void createVBOdata() override;
+    // Uploads the interleaved position/normal/UV data built by a FarTileWorker
+    void createFarVBO(const std::vector<VertexData> &vertData, const std::vector<GLuint> &idxData, int step);
+};
+
+// Mesh data for one FarTile, produced off the main thread
+struct FarTileData {
+    int64_t m_key;
+    int m_step;
+    std::vector<VertexData> m_vboData;
+    std::vector<GLuint> m_idxData;
+
+    FarTileData(int64_t key, int step) : m_key(key), m_step(step),
+                                         m_vboData{}, m_idxData{}
+    {}
+};
+
+class FarTileWorker : public QRunnable
+{
+private:
+    int64_t m_key;
+    glm::ivec2 m_origin;
+    int m_step;
+    std::vector<FarTileData>* mp_tilesCompleted;
+    QMutex *mp_tilesCompletedLock;
+public:
+    FarTileWorker(int64_t key, glm::ivec2 origin, int step,
+                  std::vector<FarTileData>* dat, QMutex *datLock);
+    ~FarTileWorker(){};
+    void run() override;
+};
+
+// Draws simplified terrain in rings around the player, from the edge of
+// the full-detail Chunks out to FAR_TERRAIN_RADIUS blocks. The closest ring
+// uses 2x2 block columns, the next 4x4 and the outermost 8x8.
+class FarTerrain
+{
+private:
+    std::unordered_map<int64_t, uPtr<FarTile>> m_tiles;
+
+    std::vector<FarTileData> m_tilesThatHaveVBOs;
+    QMutex m_tilesThatHaveVBOsLock;
+    // Far tiles get their own small pool so they never
+    // starve the FBM and VBO workers of the near terrain
+    QThreadPool m_pool;
+
+    // The tile the player stood in when the rings were last rebuilt
+    glm::ivec2 m_centerTile;
+    bool m_hasCenter;
+
+    OpenGLContext* mp_context;
+    // Origins of the tiles drawn this frame
+    DrawOffsetBuffer m_drawOffsets;
+
+    static int stepForDistance(float dist);
+    static float distanceToTile(glm::vec2 p, glm::ivec2 origin);
+    bool isCoveredByChunks(const FarTile &tile, const Terrain &terrain,
+                           int minX, int maxX, int minZ, int maxZ) const;
+
+public:
+    FarTerrain(OpenGLContext *context);
+    ~FarTerrain();
+    // Releases every tile's buffers. Needs the context current.
+    void destroy();
+
+    // Adds, re-levels and evicts tiles as the player moves
+    void update(glm::vec3 playerPos);
+    // Sends finished tile meshes to the GPU
+    void checkThreadResults();
+    // Draws every tile that is not entirely hidden by the full-detail
+    // Chunks inside the given XZ bounds
+    void draw(int minX, int maxX, int minZ, int maxZ,
+              const Terrain &terrain, ShaderProgram *shaderProgram);
+};
@@ -1,5 +1,7 @@
 #include "fbmworker.h"
 #include "biome.h"
+#include "lightengine.h"
+#include "profiler.h"
 
 FBMWorker::FBMWorker(int x, int z, std::vector<Chunk*> chunksToFill, std::unordered_set<Chunk *> *chunksCompleted, QMutex* chunksCompletedLock)
     : m_xCorner(x), m_zCorner(z), m_chunksToFill(chunksToFill),
@@ -7,14 +9,26 @@ FBMWorker::FBMWorker(int x, int z, std::vector<Chunk*> chunksToFill, std::unorde
 {}
 
 void FBMWorker::run() {
+    qint64 startNs = Profiler::instance().nowNs();
     for(Chunk* c: m_chunksToFill) {
+        c->m_timeline.stamp(FBM_START);
         // TODO: check_to_create_chunk() function in Terrain
         for(int block_posx = 0; block_posx < 16; ++block_posx) {
             for(int block_posz = 0; block_posz < 16; ++block_posz) {
                 fillYSpace(c, block_posx, block_posz);
+                c->setColumnTint(block_posx, block_posz,
+                                 packTint(Biome::grassTint(block_posx + c->m_global_pos.x, block_posz + c->m_global_pos.y)));
             }
         }
+        c->m_timeline.stamp(FBM_END);
     }
+    Profiler::instance().addWorkerSample("fbm", startNs, Profiler::instance().nowNs());
+
+    // Light the zone on its own here, so the simulation
+    // thread only has to join it up with its neighbors
+    qint64 lightStartNs = Profiler::instance().nowNs();
+    LightEngine::lightZone(m_chunksToFill, glm::ivec2(m_xCorner, m_zCorner));
+    Profiler::instance().addWorkerSample("light zone", lightStartNs, Profiler::instance().nowNs());
 
     mp_chunksCompletedLock->lock();
     for (Chunk* c : m_chunksToFill) {
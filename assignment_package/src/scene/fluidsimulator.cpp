@@ -0,0 +1,266 @@
+#include "fluidsimulator.h"
+#include "profiler.h"
+
+namespace {
+
+const glm::ivec3 UP(0, 1, 0);
+const std::array<glm::ivec3, 4> SIDEWAYS {
+    glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+};
+
+// Packs a block position into one key: 28 bits each for X and Z, 8 for Y
+int64_t cellKey(glm::ivec3 p) {
+    return ((int64_t(p.x) & 0xFFFFFFF) << 36) | ((int64_t(p.z) & 0xFFFFFFF) << 8) | (int64_t(p.y) & 0xFF);
+}
+
+int64_t chunkKeyOf(glm::ivec3 p) {
+    return toKey(16 * static_cast<int>(glm::floor(p.x / 16.f)), 16 * static_cast<int>(glm::floor(p.z / 16.f)));
+}
+
+bool isFluid(BlockType t) {
+    return t == WATER || t == LAVA;
+}
+
+int maxFlowDistance(BlockType fluid) {
+    return fluid == WATER ? WATER_FLOW_DISTANCE : LAVA_FLOW_DISTANCE;
+}
+
+// How far sideways a block of the given level has flowed
+int flowDistance(unsigned char level) {
+    return level == FLUID_FALLING ? 0 : level;
+}
+
+// The block at p, with the bottom of the world and Chunks that do not
+// exist yet acting as BEDROCK, so fluid stops at them
+BlockType fluidBlockAt(const Terrain &terrain, glm::ivec3 p) {
+    if(p.y < 0) {
+        return BEDROCK;
+    }
+    if(p.y >= 256) {
+        return EMPTY;
+    }
+    const Chunk *c = terrain.chunkAt(p.x, p.z);
+    if(c == nullptr) {
+        return BEDROCK;
+    }
+    return c->getBlockAt(static_cast<unsigned int>(p.x - c->m_global_pos.x),
+                         static_cast<unsigned int>(p.y),
+                         static_cast<unsigned int>(p.z - c->m_global_pos.y));
+}
+
+}
+
+bool FluidSimulator::pours(const Terrain &terrain, glm::ivec3 p, BlockType fluid) const {
+    glm::ivec3 below = p - UP;
+    BlockType under = fluidBlockAt(terrain, below);
+    return under == EMPTY || (isFluid(under) && under != fluid) || (under == fluid && levelAt(below) != 0);
+}
+
+FluidSimulator::FluidSimulator()
+    : m_levels(), m_activeWater(), m_activeLava(), m_queued(), m_changes(), m_changedBlocks(),
+      m_timeSinceTick(0.f), m_tickCount(0)
+{}
+
+unsigned char FluidSimulator::levelAt(glm::ivec3 p) const {
+    auto found = m_levels.find(cellKey(p));
+    return found == m_levels.end() ? 0 : found->second;
+}
+
+void FluidSimulator::wake(const Terrain &terrain, glm::ivec3 p) {
+    BlockType t = fluidBlockAt(terrain, p);
+    if(!isFluid(t) || !m_queued.insert(cellKey(p)).second) {
+        return;
+    }
+    (t == WATER ? m_activeWater : m_activeLava).push_back(p);
+}
+
+void FluidSimulator::wakeAround(const Terrain &terrain, glm::ivec3 p) {
+    wake(terrain, p);
+    wake(terrain, p + UP);
+    wake(terrain, p - UP);
+    for(glm::ivec3 d : SIDEWAYS) {
+        wake(terrain, p + d);
+    }
+}
+
+void FluidSimulator::blockChanged(const Terrain &terrain, glm::ivec3 p) {
+    // Whatever is there now was put there whole, so any fluid is a source
+    m_levels.erase(cellKey(p));
+    wakeAround(terrain, p);
+}
+
+int FluidSimulator::activeCount() const {
+    return static_cast<int>(m_queued.size());
+}
+
+std::vector<glm::ivec3> FluidSimulator::takeChangedBlocks() {
+    std::vector<glm::ivec3> changed;
+    changed.swap(m_changedBlocks);
+    return changed;
+}
+
+void FluidSimulator::addChange(glm::ivec3 p, BlockType type, unsigned char level) {
+    int64_t key = cellKey(p);
+    auto found = m_changes.find(key);
+    if(found != m_changes.end()) {
+        // Where two flows meet, STONE beats fluid and the stronger flow beats the weaker
+        const FluidChange &queued = found->second;
+        if(queued.type == STONE || (type != STONE && flowDistance(level) >= flowDistance(queued.level))) {
+            return;
+        }
+    }
+    m_changes[key] = FluidChange{p, type, level};
+}
+
+void FluidSimulator::flowInto(const Terrain &terrain, glm::ivec3 p, BlockType fluid, unsigned char level) {
+    BlockType t = fluidBlockAt(terrain, p);
+    if(t == EMPTY) {
+        addChange(p, fluid, level);
+    } else if(isFluid(t) && t != fluid) {
+        addChange(p, STONE, 0);
+    }
+}
+
+void FluidSimulator::updateCell(const Terrain &terrain, glm::ivec3 p) {
+    BlockType fluid = fluidBlockAt(terrain, p);
+    if(!isFluid(fluid)) {
+        return;
+    }
+    unsigned char level = levelAt(p);
+
+    // Flowing fluid takes its level from what feeds it: the same fluid
+    // above it, or else the neighbor nearest its source that spreads
+    // sideways into it. With nothing left to feed it, it drains away.
+    if(level != 0) {
+        int fed = maxFlowDistance(fluid) + 1;
+        if(fluidBlockAt(terrain, p + UP) == fluid) {
+            fed = FLUID_FALLING;
+        } else {
+            for(glm::ivec3 d : SIDEWAYS) {
+                glm::ivec3 n = p + d;
+                if(fluidBlockAt(terrain, n) == fluid && !pours(terrain, n, fluid)) {
+                    fed = glm::min(fed, flowDistance(levelAt(n)) + 1);
+                }
+            }
+        }
+        if(fed != FLUID_FALLING && fed > maxFlowDistance(fluid)) {
+            addChange(p, EMPTY, 0);
+            return;
+        }
+        if(fed != level) {
+            addChange(p, fluid, static_cast<unsigned char>(fed));
+            level = static_cast<unsigned char>(fed);
+        }
+    }
+
+    if(pours(terrain, p, fluid)) {
+        flowInto(terrain, p - UP, fluid, FLUID_FALLING);
+        return;
+    }
+    int next = flowDistance(level) + 1;
+    if(next > maxFlowDistance(fluid)) {
+        return;
+    }
+    for(glm::ivec3 d : SIDEWAYS) {
+        flowInto(terrain, p + d, fluid, static_cast<unsigned char>(next));
+    }
+}
+
+bool FluidSimulator::runQueue(std::deque<glm::ivec3> *queue, const Terrain &terrain, qint64 deadlineNs) {
+    int sinceClockCheck = 0;
+    while(!queue->empty()) {
+        // Reading the clock costs about as much as updating a cell, so only do it now and then
+        if(++sinceClockCheck == 32) {
+            sinceClockCheck = 0;
+            if(Profiler::instance().nowNs() >= deadlineNs) {
+                return false;
+            }
+        }
+        glm::ivec3 p = queue->front();
+        queue->pop_front();
+        m_queued.erase(cellKey(p));
+        updateCell(terrain, p);
+    }
+    return true;
+}
+
+void FluidSimulator::applyChanges(Terrain *terrain) {
+    // Batch the writes by Chunk, so each Chunk is looked up once
+    // and remeshed at most once however much of it changed
+    std::unordered_map<int64_t, std::vector<const FluidChange*>> byChunk;
+    for(const auto &entry : m_changes) {
+        byChunk[chunkKeyOf(entry.second.pos)].push_back(&entry.second);
+    }
+    std::unordered_set<int64_t> toRemesh;
+    for(const auto &batch : byChunk) {
+        glm::ivec2 origin = toCoords(batch.first);
+        Chunk *c = terrain->chunkAt(origin.x, origin.y);
+        for(const FluidChange *change : batch.second) {
+            unsigned int x = static_cast<unsigned int>(change->pos.x - origin.x);
+            unsigned int y = static_cast<unsigned int>(change->pos.y);
+            unsigned int z = static_cast<unsigned int>(change->pos.z - origin.y);
+            if(change->level != 0) {
+                m_levels[cellKey(change->pos)] = change->level;
+            } else {
+                m_levels.erase(cellKey(change->pos));
+            }
+            // A new level alone does not change how the block looks
+            if(c->getBlockAt(x, y, z) == change->type) {
+                continue;
+            }
+            c->setBlockAt(x, y, z, change->type);
+            m_changedBlocks.push_back(change->pos);
+            toRemesh.insert(batch.first);
+            // Blocks on the edge of a Chunk show or hide faces of its neighbor too
+            if(x == 0) {
+                toRemesh.insert(toKey(origin.x - 16, origin.y));
+            } else if(x == 15) {
+                toRemesh.insert(toKey(origin.x + 16, origin.y));
+            }
+            if(z == 0) {
+                toRemesh.insert(toKey(origin.x, origin.y - 16));
+            } else if(z == 15) {
+                toRemesh.insert(toKey(origin.x, origin.y + 16));
+            }
+        }
+    }
+    for(int64_t key : toRemesh) {
+        glm::ivec2 origin = toCoords(key);
+        terrain->requestRemesh(origin.x, origin.y);
+    }
+
+    // Only now that every write is in can the next tick's cells be told apart
+    for(const auto &entry : m_changes) {
+        wakeAround(*terrain, entry.second.pos);
+    }
+    m_changes.clear();
+}
+
+void FluidSimulator::fluidTick(Terrain *terrain) {
+    bool lavaTick = m_tickCount++ % LAVA_TICK_INTERVAL == 0;
+    if(m_activeWater.empty() && (!lavaTick || m_activeLava.empty())) {
+        return;
+    }
+    qint64 startNs = Profiler::instance().nowNs();
+    qint64 deadlineNs = startNs + FLUID_TICK_BUDGET_NS;
+    // Lava first, as it gets a turn so much less often, but only up to half
+    // the budget so a spreading lava front cannot hold water still. Water
+    // gets the rest, whatever lava left over included.
+    if(lavaTick) {
+        runQueue(&m_activeLava, *terrain, startNs + FLUID_TICK_BUDGET_NS / 2);
+    }
+    runQueue(&m_activeWater, *terrain, deadlineNs);
+    applyChanges(terrain);
+    Profiler::instance().addThreadSample("fluid tick", startNs, Profiler::instance().nowNs());
+}
+
+void FluidSimulator::tick(float dT, Terrain *terrain) {
+    m_timeSinceTick += dT;
+    if(m_timeSinceTick < FLUID_TICK_SECONDS) {
+        return;
+    }
+    // At most one fluid tick per call, so a long step drops
+    // the ticks it missed instead of running them back to back
+    m_timeSinceTick = glm::mod(m_timeSinceTick, FLUID_TICK_SECONDS);
+    fluidTick(terrain);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "glm_includes.h"
+#include "terrain.h"
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// How many blocks each fluid flows sideways from a source
+#define WATER_FLOW_DISTANCE 7
+#define LAVA_FLOW_DISTANCE 3
+// Seconds between fluid ticks. Lava only moves on every LAVA_TICK_INTERVAL-th.
+#define FLUID_TICK_SECONDS 0.25f
+#define LAVA_TICK_INTERVAL 3
+// CPU time one fluid tick may take, at most half of it on lava.
+// Cells it does not get to are first in line next tick.
+#define FLUID_TICK_BUDGET_NS 1000000
+
+// Flow level of a fluid block: 0 for a source, then one more for each block
+// it has flowed sideways, or FLUID_FALLING for fluid pouring straight down,
+// which spreads like a source once it lands.
+#define FLUID_FALLING 0x80
+
+// Makes WATER and LAVA flow, as a cellular automaton over the blocks of the Terrain.
+// Only the active cells, those next to a change, are updated, so still fluid
+// such as the generated lakes costs nothing until a block beside it changes.
+// Each tick reads the Terrain as the last tick left it and only writes its
+// changes at the end, one Chunk at a time, asking for each touched Chunk to
+// be remeshed once.
+// Chunks only store block types, so the levels of flowing blocks are kept
+// here. Blocks without one are sources.
+class FluidSimulator {
+private:
+    // A block the current tick will write
+    struct FluidChange {
+        glm::ivec3 pos;
+        BlockType type;
+        unsigned char level;
+    };
+
+    std::unordered_map<int64_t, unsigned char> m_levels;
+    // Cells to update, one queue for each fluid, and every cell in either
+    std::deque<glm::ivec3> m_activeWater, m_activeLava;
+    std::unordered_set<int64_t> m_queued;
+    // Writes of the tick underway, by cell
+    std::unordered_map<int64_t, FluidChange> m_changes;
+    // Blocks whose type changed since the last call to takeChangedBlocks()
+    std::vector<glm::ivec3> m_changedBlocks;
+    float m_timeSinceTick;
+    unsigned int m_tickCount;
+
+    unsigned char levelAt(glm::ivec3 p) const;
+    // Does the fluid at p pour down rather than spread sideways? It only
+    // spreads over solid blocks and sources, which flowing fluid does not
+    // fill up, so flowing fluid landing on flowing fluid joins it instead.
+    bool pours(const Terrain &terrain, glm::ivec3 p, BlockType fluid) const;
+    // Queues the cell if it holds a fluid
+    void wake(const Terrain &terrain, glm::ivec3 p);
+    void wakeAround(const Terrain &terrain, glm::ivec3 p);
+    // Works through one queue until it is empty or the deadline passes.
+    // Returns false if the deadline passed.
+    bool runQueue(std::deque<glm::ivec3> *queue, const Terrain &terrain, qint64 deadlineNs);
+    void updateCell(const Terrain &terrain, glm::ivec3 p);
+    // Queues fluid of the given type and level into an EMPTY block, or
+    // turns the block to STONE if it holds the other fluid
+    void flowInto(const Terrain &terrain, glm::ivec3 p, BlockType fluid, unsigned char level);
+    void addChange(glm::ivec3 p, BlockType type, unsigned char level);
+    void applyChanges(Terrain *terrain);
+    void fluidTick(Terrain *terrain);
+
+public:
+    FluidSimulator();
+
+    // To be called after something other than this changes the block at p,
+    // so the fluid in and around it can react
+    void blockChanged(const Terrain &terrain, glm::ivec3 p);
+    // Runs the fluid ticks due in the next dT seconds
+    void tick(float dT, Terrain *terrain);
+    // How many cells are waiting to be updated
+    int activeCount() const;
+    // Returns and forgets the blocks the fluids have filled,
+    // emptied or turned to STONE, so the light can follow them
+    std::vector<glm::ivec3> takeChangedBlocks();
+};
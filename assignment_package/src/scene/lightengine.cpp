@@ -0,0 +1,391 @@
+#include "lightengine.h"
+#include "profiler.h"
+
+namespace {
+
+enum LightChannel {
+    SKY, BLOCK
+};
+
+// Indexed like Direction, so DIRECTIONS[YNEG] points down
+const std::array<glm::ivec3, 6> DIRECTIONS {
+    glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+    glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+};
+
+// Origin of the terrain generation zone holding the given XZ position
+glm::ivec2 zoneOf(glm::ivec2 p) {
+    return glm::ivec2(64 * static_cast<int>(glm::floor(p.x / 64.f)), 64 * static_cast<int>(glm::floor(p.y / 64.f)));
+}
+
+int channelLevel(unsigned char light, LightChannel ch) {
+    return ch == SKY ? LIGHT_SKY(light) : LIGHT_BLOCK(light);
+}
+
+unsigned char withChannelLevel(unsigned char light, LightChannel ch, int level) {
+    return ch == SKY ? PACK_LIGHT(level, LIGHT_BLOCK(light)) : PACK_LIGHT(LIGHT_SKY(light), level);
+}
+
+// How many levels light loses passing into a block. Opaque blocks cost more than any light has.
+int lightCost(BlockType t) {
+    switch(t) {
+    case EMPTY:
+    case LAVA:
+        return 1;
+    case WATER:
+        return 2;
+    default:
+        return LIGHT_MAX + 1;
+    }
+}
+
+int lightEmitted(BlockType t) {
+    return t == LAVA ? LIGHT_MAX : 0;
+}
+
+unsigned char lightOf(const Chunk *c, glm::ivec3 p) {
+    return c->getLightAt(static_cast<unsigned int>(p.x - c->m_global_pos.x), static_cast<unsigned int>(p.y),
+                         static_cast<unsigned int>(p.z - c->m_global_pos.y));
+}
+
+void setLightOf(Chunk *c, glm::ivec3 p, unsigned char light) {
+    c->setLightAt(static_cast<unsigned int>(p.x - c->m_global_pos.x), static_cast<unsigned int>(p.y),
+                  static_cast<unsigned int>(p.z - c->m_global_pos.y), light);
+}
+
+BlockType blockOf(const Chunk *c, glm::ivec3 p) {
+    return c->getBlockAt(static_cast<unsigned int>(p.x - c->m_global_pos.x), static_cast<unsigned int>(p.y),
+                         static_cast<unsigned int>(p.z - c->m_global_pos.y));
+}
+
+// The Chunks a flood fill may read and write. Both kinds give nullptr
+// for the Chunks beyond them, which light neither enters nor leaves.
+
+// The 4 x 4 Chunks of one zone, for its FBMWorker
+struct ZoneGrid {
+    glm::ivec2 origin;
+    std::array<Chunk*, 16> chunks;
+
+    Chunk* chunkAt(int x, int z) const {
+        int cx = static_cast<int>(glm::floor((x - origin.x) / 16.f));
+        int cz = static_cast<int>(glm::floor((z - origin.y) / 16.f));
+        if(cx < 0 || cx >= 4 || cz < 0 || cz >= 4) {
+            return nullptr;
+        }
+        return chunks[cx + 4 * cz];
+    }
+    void lightChanged(glm::ivec3) {}
+};
+
+// The Chunks of a Terrain that a LightEngine has stitched
+struct StitchedGrid {
+    Terrain *terrain;
+    // Filled with the origins of the Chunks whose meshes the changes show in
+    std::unordered_set<int64_t> *relit;
+
+    Chunk* chunkAt(int x, int z) const {
+        Chunk *c = terrain->chunkAt(x, z);
+        return c != nullptr && c->m_lightStitched ? c : nullptr;
+    }
+    void lightChanged(glm::ivec3 p) {
+        glm::ivec2 origin(16 * static_cast<int>(glm::floor(p.x / 16.f)), 16 * static_cast<int>(glm::floor(p.z / 16.f)));
+        relit->insert(toKey(origin.x, origin.y));
+        // Faces in the neighboring Chunk look into blocks on the edge
+        int x = p.x - origin.x, z = p.z - origin.y;
+        if(x == 0) {
+            relit->insert(toKey(origin.x - 16, origin.y));
+        } else if(x == 15) {
+            relit->insert(toKey(origin.x + 16, origin.y));
+        }
+        if(z == 0) {
+            relit->insert(toKey(origin.x, origin.y - 16));
+        } else if(z == 15) {
+            relit->insert(toKey(origin.x, origin.y + 16));
+        }
+    }
+};
+
+// Spreads the light of every queued block outward, brightening each
+// neighbor it reaches with more than the neighbor has. Empties the queue.
+template<typename Grid>
+void spreadLight(Grid &grid, LightChannel ch, std::vector<glm::ivec3> *queue) {
+    for(size_t head = 0; head < queue->size(); ++head) {
+        glm::ivec3 p = (*queue)[head];
+        int level = channelLevel(lightOf(grid.chunkAt(p.x, p.z), p), ch);
+        for(int d = 0; d < 6; ++d) {
+            glm::ivec3 q = p + DIRECTIONS[d];
+            if(q.y < 0 || q.y > 255) {
+                continue;
+            }
+            Chunk *c = grid.chunkAt(q.x, q.z);
+            if(c == nullptr) {
+                continue;
+            }
+            BlockType t = blockOf(c, q);
+            // Full skylight falls through the open air without fading
+            int reached = (ch == SKY && d == YNEG && level == LIGHT_MAX && t == EMPTY) ? LIGHT_MAX : level - lightCost(t);
+            unsigned char qLight = lightOf(c, q);
+            if(reached <= channelLevel(qLight, ch)) {
+                continue;
+            }
+            setLightOf(c, q, withChannelLevel(qLight, ch, reached));
+            grid.lightChanged(q);
+            queue->push_back(q);
+        }
+    }
+    queue->clear();
+}
+
+// Darkens everything lit by the queued blocks, which have just been
+// darkened from the paired levels. Neighbors lit from elsewhere go in
+// relight, to spread their light back into the darkened blocks.
+// Empties the queue.
+template<typename Grid>
+void unspreadLight(Grid &grid, LightChannel ch, std::vector<std::pair<glm::ivec3, int>> *queue,
+                   std::vector<glm::ivec3> *relight) {
+    for(size_t head = 0; head < queue->size(); ++head) {
+        glm::ivec3 p = (*queue)[head].first;
+        int level = (*queue)[head].second;
+        for(int d = 0; d < 6; ++d) {
+            glm::ivec3 q = p + DIRECTIONS[d];
+            if(q.y < 0 || q.y > 255) {
+                continue;
+            }
+            Chunk *c = grid.chunkAt(q.x, q.z);
+            if(c == nullptr) {
+                continue;
+            }
+            unsigned char qLight = lightOf(c, q);
+            int qLevel = channelLevel(qLight, ch);
+            if(qLevel == 0) {
+                continue;
+            }
+            // Dimmer light came from p, and so did full skylight right below it
+            if(qLevel < level || (ch == SKY && d == YNEG && level == LIGHT_MAX)) {
+                setLightOf(c, q, withChannelLevel(qLight, ch, 0));
+                grid.lightChanged(q);
+                queue->push_back(std::make_pair(q, qLevel));
+            } else {
+                relight->push_back(q);
+            }
+        }
+    }
+    queue->clear();
+}
+
+}
+
+LightEngine::LightEngine()
+    : m_toStitch(), m_edits(), m_relit()
+{}
+
+void LightEngine::lightZone(const std::vector<Chunk*> &chunks, glm::ivec2 zoneOrigin) {
+    ZoneGrid grid;
+    grid.origin = zoneOrigin;
+    grid.chunks.fill(nullptr);
+    for(Chunk *c : chunks) {
+        c->fillLight(0);
+        glm::ivec2 cell = (c->m_global_pos - zoneOrigin) / 16;
+        grid.chunks[cell.x + 4 * cell.y] = c;
+    }
+
+    // Skylight falls straight down through the open air above the ground.
+    // top holds the lowest block it reaches in each column of the zone.
+    std::array<int, 64 * 64> top;
+    top.fill(256);
+    for(Chunk *c : chunks) {
+        glm::ivec2 cell = c->m_global_pos - zoneOrigin;
+        for(int x = 0; x < 16; ++x) {
+            for(int z = 0; z < 16; ++z) {
+                int y = 255;
+                for(; y >= 0 && c->getBlockAt(x, y, z) == EMPTY; --y) {
+                    c->setLightAt(x, y, z, LIGHT_OPEN_AIR);
+                }
+                top[(cell.x + x) + 64 * (cell.y + z)] = y + 1;
+            }
+        }
+    }
+
+    // From there it spreads sideways, under overhangs and into caves, from
+    // the blocks beside taller columns, and down into water and lava
+    std::vector<glm::ivec3> queue;
+    for(int x = 0; x < 64; ++x) {
+        for(int z = 0; z < 64; ++z) {
+            int lowest = top[x + 64 * z];
+            int highestBeside = lowest;
+            if(x > 0) {
+                highestBeside = glm::max(highestBeside, top[(x - 1) + 64 * z]);
+            }
+            if(x < 63) {
+                highestBeside = glm::max(highestBeside, top[(x + 1) + 64 * z]);
+            }
+            if(z > 0) {
+                highestBeside = glm::max(highestBeside, top[x + 64 * (z - 1)]);
+            }
+            if(z < 63) {
+                highestBeside = glm::max(highestBeside, top[x + 64 * (z + 1)]);
+            }
+            glm::ivec3 column(zoneOrigin.x + x, 0, zoneOrigin.y + z);
+            if(grid.chunkAt(column.x, column.z) == nullptr) {
+                continue;
+            }
+            for(int y = lowest; y < highestBeside; ++y) {
+                queue.push_back(column + glm::ivec3(0, y, 0));
+            }
+            if(lowest > 0 && lowest <= 255 && lightCost(blockOf(grid.chunkAt(column.x, column.z), column + glm::ivec3(0, lowest - 1, 0))) <= LIGHT_MAX) {
+                queue.push_back(column + glm::ivec3(0, lowest, 0));
+            }
+        }
+    }
+    spreadLight(grid, SKY, &queue);
+
+    for(Chunk *c : chunks) {
+        for(int x = 0; x < 16; ++x) {
+            for(int y = 0; y < 256; ++y) {
+                for(int z = 0; z < 16; ++z) {
+                    int emitted = lightEmitted(c->getBlockAt(x, y, z));
+                    if(emitted > 0) {
+                        c->setLightAt(x, y, z, withChannelLevel(c->getLightAt(x, y, z), BLOCK, emitted));
+                        queue.push_back(glm::ivec3(c->m_global_pos.x + x, y, c->m_global_pos.y + z));
+                    }
+                }
+            }
+        }
+    }
+    spreadLight(grid, BLOCK, &queue);
+}
+
+void LightEngine::stitch(Terrain *terrain, const std::vector<Chunk*> &zone) {
+    // lightZone() has already joined up the borders inside the zone
+    for(Chunk *c : zone) {
+        c->m_lightStitched = true;
+    }
+    StitchedGrid grid{terrain, &m_relit};
+    std::vector<glm::ivec3> queue;
+    // Each of the two blocks facing each other across a border may
+    // be brighter than the other, having been lit from its own side
+    const std::array<glm::ivec3, 4> steps {
+        DIRECTIONS[XPOS], DIRECTIONS[XNEG], DIRECTIONS[ZPOS], DIRECTIONS[ZNEG]
+    };
+    for(Chunk *c : zone) {
+        glm::ivec3 origin(c->m_global_pos.x, 0, c->m_global_pos.y);
+        glm::ivec2 zoneOrigin = zoneOf(c->m_global_pos);
+        for(glm::ivec3 step : steps) {
+            glm::ivec2 across(origin.x + 16 * step.x, origin.z + 16 * step.z);
+            if(zoneOf(across) == zoneOrigin) {
+                continue;
+            }
+            Chunk *neighbor = grid.chunkAt(across.x, across.y);
+            if(neighbor == nullptr) {
+                continue;
+            }
+            // The first block of c's edge on this side, and the way along it
+            glm::ivec3 edge = origin + glm::ivec3(step.x > 0 ? 15 : 0, 0, step.z > 0 ? 15 : 0);
+            glm::ivec3 along = step.x != 0 ? glm::ivec3(0, 0, 1) : glm::ivec3(1, 0, 0);
+            for(LightChannel ch : {SKY, BLOCK}) {
+                for(int y = 0; y < 256; ++y) {
+                    for(int i = 0; i < 16; ++i) {
+                        glm::ivec3 a = edge + along * i + glm::ivec3(0, y, 0);
+                        glm::ivec3 b = a + step;
+                        int aLevel = channelLevel(lightOf(c, a), ch);
+                        int bLevel = channelLevel(lightOf(neighbor, b), ch);
+                        if(aLevel > bLevel + 1) {
+                            queue.push_back(a);
+                        } else if(bLevel > aLevel + 1) {
+                            queue.push_back(b);
+                        }
+                    }
+                }
+                spreadLight(grid, ch, &queue);
+            }
+        }
+    }
+}
+
+void LightEngine::relightBlock(Terrain *terrain, glm::ivec3 p) {
+    StitchedGrid grid{terrain, &m_relit};
+    Chunk *c = grid.chunkAt(p.x, p.z);
+    std::vector<std::pair<glm::ivec3, int>> removals;
+    std::vector<glm::ivec3> relight;
+    for(LightChannel ch : {SKY, BLOCK}) {
+        // Take away whatever light the block had and passed on, as it may no longer get or pass it
+        unsigned char light = lightOf(c, p);
+        int level = channelLevel(light, ch);
+        if(level > 0) {
+            setLightOf(c, p, withChannelLevel(light, ch, 0));
+            grid.lightChanged(p);
+            removals.push_back(std::make_pair(p, level));
+            unspreadLight(grid, ch, &removals, &relight);
+        }
+        // Then let what it now emits, and the light around it, back in
+        BlockType t = blockOf(c, p);
+        int seed = ch == BLOCK ? lightEmitted(t) : (p.y == 255 && t == EMPTY ? LIGHT_MAX : 0);
+        if(seed > 0) {
+            setLightOf(c, p, withChannelLevel(lightOf(c, p), ch, seed));
+            grid.lightChanged(p);
+            relight.push_back(p);
+        }
+        for(glm::ivec3 d : DIRECTIONS) {
+            glm::ivec3 q = p + d;
+            Chunk *qc = grid.chunkAt(q.x, q.z);
+            if(q.y >= 0 && q.y <= 255 && qc != nullptr && channelLevel(lightOf(qc, q), ch) > 0) {
+                relight.push_back(q);
+            }
+        }
+        spreadLight(grid, ch, &relight);
+    }
+}
+
+void LightEngine::blockChanged(glm::ivec3 p) {
+    m_edits.push_back(p);
+}
+
+void LightEngine::tick(Terrain *terrain) {
+    // An FBMWorker hands its whole zone over at once, so each zone comes in one batch
+    std::unordered_map<int64_t, size_t> newZones;
+    for(Chunk *c : terrain->takeLitChunks()) {
+        glm::ivec2 zone = zoneOf(c->m_global_pos);
+        auto found = newZones.emplace(toKey(zone.x, zone.y), m_toStitch.size()).first;
+        if(found->second == m_toStitch.size()) {
+            m_toStitch.emplace_back();
+        }
+        m_toStitch[found->second].push_back(c);
+    }
+    if(m_toStitch.empty() && m_edits.empty()) {
+        return;
+    }
+    qint64 startNs = Profiler::instance().nowNs();
+
+    size_t stitched = 0;
+    for(; stitched < m_toStitch.size(); ++stitched) {
+        if(stitched > 0 && Profiler::instance().nowNs() - startNs >= LIGHT_STITCH_BUDGET_NS) {
+            break;
+        }
+        stitch(terrain, m_toStitch[stitched]);
+        terrain->queueStitchedChunks(m_toStitch[stitched]);
+    }
+    m_toStitch.erase(m_toStitch.begin(), m_toStitch.begin() + stitched);
+
+    std::vector<glm::ivec3> edits;
+    edits.swap(m_edits);
+    for(glm::ivec3 p : edits) {
+        Chunk *c = terrain->chunkAt(p.x, p.z);
+        if(c == nullptr || p.y < 0 || p.y > 255) {
+            continue;
+        }
+        // Light in a Chunk that is not stitched yet may still be overwritten,
+        // so a change there waits until it is
+        if(!c->m_lightStitched) {
+            m_edits.push_back(p);
+            continue;
+        }
+        relightBlock(terrain, p);
+    }
+
+    for(int64_t key : m_relit) {
+        glm::ivec2 origin = toCoords(key);
+        terrain->requestRemesh(origin.x, origin.y);
+    }
+    m_relit.clear();
+    Profiler::instance().addThreadSample("light", startNs, Profiler::instance().nowNs());
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "glm_includes.h"
+#include "terrain.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// CPU time a LightEngine may spend each step joining newly
+// generated zones to their neighbors. The rest wait for the next step.
+#define LIGHT_STITCH_BUDGET_NS 2000000
+
+// Voxel lighting: how much skylight, and how much block light from LAVA,
+// reaches each block, spread a block at a time by breadth-first flood fill.
+// The levels are stored in each Chunk and baked into its mesh, so lighting
+// caves costs nothing per fragment.
+//
+// lightZone() lights a freshly generated zone on its FBMWorker, as if the
+// zones around it were dark. A LightEngine then joins each zone's light up
+// with its neighbors' once they exist, after which the zone's Chunks get
+// their first mesh, and keeps it up to date as blocks change: it takes away
+// the light a change cut off, then spreads light back in from around it,
+// across Chunk borders as needed.
+class LightEngine {
+private:
+    // The Chunks of each zone lit by its FBMWorker, waiting to be joined to their neighbors
+    std::vector<std::vector<Chunk*>> m_toStitch;
+    // Blocks changed since the last tick
+    std::vector<glm::ivec3> m_edits;
+    // Chunks whose light changed this tick, by origin
+    std::unordered_set<int64_t> m_relit;
+
+    // Joins the light of one zone's Chunks to the zones around it
+    void stitch(Terrain *terrain, const std::vector<Chunk*> &zone);
+    void relightBlock(Terrain *terrain, glm::ivec3 p);
+
+public:
+    LightEngine();
+
+    // Lights the Chunks of the zone with the given origin, which must all
+    // have just been filled with blocks and not yet be shared with other threads
+    static void lightZone(const std::vector<Chunk*> &chunks, glm::ivec2 zoneOrigin);
+
+    // To be called after the block at p changes
+    void blockChanged(glm::ivec3 p);
+    // Joins up the zones lit since the last tick and queues their first meshes,
+    // updates the light around changed blocks, and asks for every Chunk whose
+    // light changed to be remeshed
+    void tick(Terrain *terrain);
+};
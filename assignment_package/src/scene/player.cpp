@@ -4,7 +4,7 @@
 
 Player::Player(glm::vec3 pos, const Terrain &terrain)
     : Entity(pos), m_prevPos(pos), m_velocity(0,0,0), m_acceleration(0,0,0),
-      m_camera(pos + glm::vec3(0, 1.5f, 0)), mcr_terrain(terrain),
+      m_camera(pos + glm::vec3(0, 1.5f, 0)), m_prevCameraPose(m_camera.getPose()), mcr_terrain(terrain),
       faceAxis(-1), mcr_prevPos(m_prevPos), mcr_camera(m_camera), isInWater(false), isInLava(false)
 {}
 
@@ -111,9 +111,6 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
         this->moveAlongVector(rayDirection);
     } else {
         BlockType belowPlayer = this->mcr_terrain.getBlockAt(this->m_position.x, this->m_position.y - 0.1, this->m_position.z);
-        if (dT == 0 && (belowPlayer == EMPTY || belowPlayer == WATER || belowPlayer == LAVA)) {
-            dT = 1.f;
-        }
         if (belowPlayer == EMPTY)
         {
             this->m_acceleration += glm::vec3(0, -3 * this->g, 0);
@@ -188,58 +185,12 @@ bool Player::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrai
 }
 
 void Player::detectCollision(glm::vec3 *rayDirection, const Terrain &terrain) {
-    glm::vec3 origin = m_position - glm::vec3(0.5f, 0.f, 0.5f);
-    glm::ivec3 outBlockHit = glm::ivec3();
-    float outDist = 0.f;
-    float min_x = rayDirection->x;
-    float min_y = rayDirection->y;
-    float min_z = rayDirection->z;
-    for (int x = 0; x <= 1; x++) {
-        for (int z = 0; z <= 1; z++) {
-            for (int y = 0; y <= 2; y++) {
-                glm::vec3 rayOrigin = origin + glm::vec3(x, y, z);
-                if (gridMarch(rayOrigin, glm::vec3(rayDirection->x,0,0), terrain, &outDist, &outBlockHit)) {
-                    if(outDist > 0.005){
-                        if(glm::abs(min_x) > outDist - 0.005)
-                        {
-                            min_x = (outDist - 0.005) * glm::sign(min_x);
-                        }
-                    }
-                    else{
-                        min_x = 0;
-                    }
-                }
-                if (gridMarch(rayOrigin, glm::vec3(0,rayDirection->y,0), terrain, &outDist, &outBlockHit)) {
-                    if(outDist > 0.005){
-                        if(glm::abs(min_y) > outDist - 0.005)
-                        {
-                            min_y = (outDist - 0.005) * glm::sign(min_y);
-                        }
-                    }
-                    else{
-                        min_y = 0;
-                    }
-                }
-                if (gridMarch(rayOrigin, glm::vec3(0,0,rayDirection->z), terrain, &outDist, &outBlockHit)) {
-                    if(outDist > 0.005){
-                        if(glm::abs(min_z) > outDist - 0.005)
-                        {
-                            min_z = (outDist - 0.005) * glm::sign(min_z);
-                        }
-                    }
-                    else{
-                        min_z = 0;
-                    }
-                }
-            }
-        }
-    }
-    rayDirection->x = min_x;
-    rayDirection->y = min_y;
-    rayDirection->z = min_z;
+    // The Player fills a 1 x 2 x 1 box standing on m_position
+    AABB box(m_position - glm::vec3(0.5f, 0.f, 0.5f), m_position + glm::vec3(0.5f, 2.f, 0.5f));
+    *rayDirection = sweepAABB(terrain, box, *rayDirection);
 }
 
-BlockType Player::placeBlock(Terrain *t, BlockType currBlockType) {
+BlockType Player::placeBlock(Terrain *t, BlockType currBlockType, glm::ivec3 *out_block) {
     glm::vec3 rayOrigin = this->m_camera.mcr_position;
     glm::vec3 rayDirection = 3.f * glm::normalize(this->m_forward);
     glm::ivec3 out_blockHit = glm::ivec3();
@@ -247,21 +198,21 @@ BlockType Player::placeBlock(Terrain *t, BlockType currBlockType) {
 
     if (!gridMarch(rayOrigin, rayDirection, this->mcr_terrain, &out_dist, &out_blockHit)) {
         out_blockHit = this->m_camera.mcr_position + rayDirection;
-        Chunk* c = t->getChunkAt(out_blockHit.x, out_blockHit.z).get();
-        glm::vec2 chunkOrigin = glm::vec2(floor(out_blockHit.x / 16.f) * 16, floor(out_blockHit.z / 16.f) * 16);
-
-        c->setBlockAt(static_cast<unsigned int>(out_blockHit.x - chunkOrigin.x),
-                             static_cast<unsigned int>(out_blockHit.y),
-                             static_cast<unsigned int>(out_blockHit.z - chunkOrigin.y), currBlockType);
-//         TODO:
-        t->getChunkAt(out_blockHit.x, out_blockHit.z).get()->destroy();
-        t->spawnVBOWorker(t->getChunkAt(out_blockHit.x, out_blockHit.z).get());
+        if (!t->hasChunkAt(out_blockHit.x, out_blockHit.z) || out_blockHit.y < 0 || out_blockHit.y >= 256) {
+            return EMPTY;
+        }
+        t->setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, currBlockType);
+        // Runs on the simulation thread, so the GL side is left to the render thread
+        t->requestRemesh(out_blockHit.x, out_blockHit.z);
+        if (out_block) {
+            *out_block = out_blockHit;
+        }
         return currBlockType;
     }
     return EMPTY;
 }
 
-BlockType Player::removeBlock(Terrain *t) {
+BlockType Player::removeBlock(Terrain *t, glm::ivec3 *out_block) {
     glm::vec3 rayOrigin = this->m_camera.mcr_position;
     glm::vec3 rayDirection = 3.f * glm::normalize(this->m_forward);
     glm::ivec3 out_blockHit = glm::ivec3();
@@ -270,8 +221,10 @@ BlockType Player::removeBlock(Terrain *t) {
     if (gridMarch(rayOrigin, rayDirection, this->mcr_terrain, &out_dist, &out_blockHit)) {
         BlockType blockType = t->getBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z);
         t->setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, EMPTY);
-        t->getChunkAt(out_blockHit.x, out_blockHit.z).get()->destroy();
-        t->spawnVBOWorker(t->getChunkAt(out_blockHit.x, out_blockHit.z).get());
+        t->requestRemesh(out_blockHit.x, out_blockHit.z);
+        if (out_block) {
+            *out_block = out_blockHit;
+        }
         return blockType;
     }
     return EMPTY;
@@ -328,6 +281,18 @@ void Player::setCameraWidthHeight(unsigned int w, unsigned int h) {
     m_camera.setWidthHeight(w, h);
 }
 
+void Player::storePreviousPose() {
+    m_prevCameraPose = m_camera.getPose();
+}
+
+const Pose& Player::previousCameraPose() const {
+    return m_prevCameraPose;
+}
+
+Pose Player::cameraPose() const {
+    return m_camera.getPose();
+}
+
 void Player::moveAlongVector(glm::vec3 dir) {
     Entity::moveAlongVector(dir);
     m_camera.moveAlongVector(dir);
@@ -381,6 +346,17 @@ void Player::rotateOnUpGlobal(float degrees) {
     m_camera.rotateOnUpGlobal(degrees);
 }
 
+void Player::lookAlong(glm::vec3 forward) {
+    Entity::lookAlong(forward);
+    m_camera.lookAlong(forward);
+}
+
+void Player::setPose(glm::vec3 pos, glm::vec3 forward) {
+    m_prevPos = m_position;
+    moveAlongVector(pos - m_position);
+    lookAlong(forward);
+}
+
 QString Player::posAsQString() const {
     std::string str("( " + std::to_string(m_position.x) + ", " + std::to_string(m_position.y) + ", " + std::to_string(m_position.z) + ")");
     return QString::fromStdString(str);
@@ -2,11 +2,13 @@
 #include "entity.h"
 #include "camera.h"
 #include "terrain.h"
+#include "voxelcollision.h"
 
 class Player : public Entity {
 private:
     glm::vec3 m_velocity, m_acceleration;
     Camera m_camera;
+    Pose m_prevCameraPose; // m_camera's pose as of the last storePreviousPose()
     const Terrain &mcr_terrain;
     glm::vec3 m_prevPos;
     void processInputs(InputBundle &inputs);
@@ -36,8 +38,10 @@ public:
     bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection,
                        const Terrain &terrain, float *out_dist,
                        glm::ivec3 *out_blockHit);
-    BlockType placeBlock(Terrain* t, BlockType currBlockType);
-    BlockType removeBlock(Terrain* t);
+    // Both return EMPTY if nothing changed, and otherwise write
+    // the position of the changed block to out_block if it is given
+    BlockType placeBlock(Terrain* t, BlockType currBlockType, glm::ivec3 *out_block = nullptr);
+    BlockType removeBlock(Terrain* t, glm::ivec3 *out_block = nullptr);
     void detectCollision(glm::vec3 *rayDirection, const Terrain &terrain);
 
     void checkInWater();
@@ -61,6 +65,15 @@ public:
     void rotateOnForwardGlobal(float degrees) override;
     void rotateOnRightGlobal(float degrees) override;
     void rotateOnUpGlobal(float degrees) override;
+    void lookAlong(glm::vec3 forward) override;
+
+    // Places the Player without any physics, for scripted camera paths
+    void setPose(glm::vec3 pos, glm::vec3 forward);
+    // Call before each simulation step, so the camera can be drawn between steps
+    void storePreviousPose();
+    // The camera's pose before and after the last simulation step
+    const Pose& previousCameraPose() const;
+    Pose cameraPose() const;
 
     // For sending the Player's data to the GUI
     // for display
@@ -0,0 +1,225 @@
+#include "spatialhash.h"
+#include "terrain.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+SpatialHash::SpatialHash()
+    : m_cells(), m_positions(), m_cellOf(), m_present(), m_count(0)
+{}
+
+glm::ivec2 SpatialHash::cellCoords(glm::vec3 p) {
+    return glm::ivec2(glm::floor(glm::vec2(p.x, p.z) / float(SPATIAL_HASH_CELL)));
+}
+
+void SpatialHash::addToCell(int64_t key, int id) {
+    m_cells[key].push_back(id);
+}
+
+void SpatialHash::removeFromCell(int64_t key, int id) {
+    auto found = m_cells.find(key);
+    std::vector<int> &ids = found->second;
+    *std::find(ids.begin(), ids.end(), id) = ids.back();
+    ids.pop_back();
+    if(ids.empty()) {
+        m_cells.erase(found);
+    }
+}
+
+template<typename F>
+void SpatialHash::forEachInCells(glm::ivec2 lo, glm::ivec2 hi, F visit) const {
+    for(int x = lo.x; x <= hi.x; ++x) {
+        for(int z = lo.y; z <= hi.y; ++z) {
+            auto found = m_cells.find(toKey(x, z));
+            if(found == m_cells.end()) {
+                continue;
+            }
+            for(int id : found->second) {
+                visit(id);
+            }
+        }
+    }
+}
+
+int SpatialHash::count() const {
+    return m_count;
+}
+
+bool SpatialHash::contains(int id) const {
+    return id >= 0 && id < static_cast<int>(m_present.size()) && m_present[id];
+}
+
+void SpatialHash::clear() {
+    m_cells.clear();
+    m_positions.clear();
+    m_cellOf.clear();
+    m_present.clear();
+    m_count = 0;
+}
+
+void SpatialHash::insert(int id, glm::vec3 pos) {
+    if(id >= static_cast<int>(m_present.size())) {
+        m_positions.resize(id + 1);
+        m_cellOf.resize(id + 1);
+        m_present.resize(id + 1, false);
+    }
+    m_positions[id] = pos;
+    m_cellOf[id] = toKey(cellCoords(pos).x, cellCoords(pos).y);
+    m_present[id] = true;
+    addToCell(m_cellOf[id], id);
+    m_count++;
+}
+
+void SpatialHash::remove(int id) {
+    removeFromCell(m_cellOf[id], id);
+    m_present[id] = false;
+    m_count--;
+}
+
+void SpatialHash::move(int id, glm::vec3 pos) {
+    m_positions[id] = pos;
+    int64_t key = toKey(cellCoords(pos).x, cellCoords(pos).y);
+    if(key != m_cellOf[id]) {
+        removeFromCell(m_cellOf[id], id);
+        addToCell(key, id);
+        m_cellOf[id] = key;
+    }
+}
+
+void SpatialHash::renumber(int from, int to) {
+    glm::vec3 pos = m_positions[from];
+    remove(from);
+    insert(to, pos);
+}
+
+void SpatialHash::queryRange(glm::vec3 center, float radius, std::vector<int> *out) const {
+    float r2 = radius * radius;
+    forEachInCells(cellCoords(center - glm::vec3(radius)), cellCoords(center + glm::vec3(radius)), [&](int id) {
+        glm::vec3 d = m_positions[id] - center;
+        if(glm::dot(d, d) <= r2) {
+            out->push_back(id);
+        }
+    });
+}
+
+void SpatialHash::queryNearest(glm::vec3 center, int k, float maxRadius, std::vector<int> *out) const {
+    if(k <= 0) {
+        return;
+    }
+    // A max-heap of the k best so far, by squared distance
+    std::vector<std::pair<float, int>> best;
+    glm::ivec2 home = cellCoords(center);
+    int maxRing = static_cast<int>(glm::ceil(maxRadius / SPATIAL_HASH_CELL));
+    // Search rings of cells outward from the one holding center. Every point
+    // beyond ring r - 1 is at least r - 1 cells away, so once k points lie
+    // within that distance no farther ring can improve on them.
+    for(int ring = 0; ring <= maxRing; ++ring) {
+        float reach = float((ring - 1) * SPATIAL_HASH_CELL);
+        if(ring > 0 && static_cast<int>(best.size()) == k && best.front().first <= reach * reach) {
+            break;
+        }
+        auto consider = [&](int id) {
+            glm::vec3 d = m_positions[id] - center;
+            float d2 = glm::dot(d, d);
+            if(d2 > maxRadius * maxRadius) {
+                return;
+            }
+            if(static_cast<int>(best.size()) < k) {
+                best.push_back(std::make_pair(d2, id));
+                std::push_heap(best.begin(), best.end());
+            } else if(d2 < best.front().first) {
+                std::pop_heap(best.begin(), best.end());
+                best.back() = std::make_pair(d2, id);
+                std::push_heap(best.begin(), best.end());
+            }
+        };
+        glm::ivec2 lo = home - glm::ivec2(ring);
+        glm::ivec2 hi = home + glm::ivec2(ring);
+        if(ring == 0) {
+            forEachInCells(lo, hi, consider);
+            continue;
+        }
+        // The rows along X at either end of the ring, then the columns
+        // along Z between them
+        forEachInCells(glm::ivec2(lo.x, lo.y), glm::ivec2(hi.x, lo.y), consider);
+        forEachInCells(glm::ivec2(lo.x, hi.y), glm::ivec2(hi.x, hi.y), consider);
+        forEachInCells(glm::ivec2(lo.x, lo.y + 1), glm::ivec2(lo.x, hi.y - 1), consider);
+        forEachInCells(glm::ivec2(hi.x, lo.y + 1), glm::ivec2(hi.x, hi.y - 1), consider);
+    }
+    std::sort_heap(best.begin(), best.end());
+    for(const std::pair<float, int> &b : best) {
+        out->push_back(b.second);
+    }
+}
+
+void benchmarkSpatialHash(int count) {
+    // Spread over a square the size of the loaded terrain, near the ground
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> xz(-288.f, 288.f);
+    std::uniform_real_distribution<float> y(130.f, 160.f);
+    std::uniform_real_distribution<float> step(-0.1f, 0.1f);
+    std::vector<glm::vec3> points(count);
+    for(glm::vec3 &p : points) {
+        p = glm::vec3(xz(rng), y(rng), xz(rng));
+    }
+    SpatialHash hash;
+    QElapsedTimer timer;
+    auto report = [&](const char *what, int times) {
+        std::cout << "  " << what << ": " << timer.nsecsElapsed() / 1e6f << " ms ("
+                  << timer.nsecsElapsed() / float(times) << " ns each)" << std::endl;
+    };
+    std::cout << "Spatial hash benchmark, " << count << " points" << std::endl;
+
+    timer.start();
+    for(int i = 0; i < count; ++i) {
+        hash.insert(i, points[i]);
+    }
+    report("insert", count);
+
+    // One simulation step's worth of movement
+    timer.start();
+    for(int i = 0; i < count; ++i) {
+        points[i] += glm::vec3(step(rng), step(rng), step(rng));
+        hash.move(i, points[i]);
+    }
+    report("move", count);
+
+    // Every point looks for its neighbors, as a collision pass would.
+    // Brute force only runs the first thousand queries, as it is quadratic.
+    const float RADIUS = 2.f;
+    int bruteQueries = glm::min(count, 1000);
+    std::vector<int> found;
+    long long hashFound = 0, hashFoundChecked = 0;
+    timer.start();
+    for(int i = 0; i < count; ++i) {
+        found.clear();
+        hash.queryRange(points[i], RADIUS, &found);
+        hashFound += found.size();
+        if(i < bruteQueries) {
+            hashFoundChecked += found.size();
+        }
+    }
+    report("range query, hashed", count);
+
+    long long bruteFound = 0;
+    timer.start();
+    for(int i = 0; i < bruteQueries; ++i) {
+        for(int j = 0; j < count; ++j) {
+            if(glm::distance(points[i], points[j]) <= RADIUS) {
+                bruteFound++;
+            }
+        }
+    }
+    report("range query, brute force", bruteQueries);
+
+    timer.start();
+    for(int i = 0; i < count; ++i) {
+        found.clear();
+        hash.queryNearest(points[i], 8, 64.f, &found);
+    }
+    report("8 nearest", count);
+
+    std::cout << "  " << hashFound / float(count) << " neighbors per point, "
+              << (hashFoundChecked == bruteFound ? "matching" : "NOT matching") << " brute force" << std::endl;
+}
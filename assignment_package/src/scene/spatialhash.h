@@ -0,0 +1,55 @@
+#pragma once
+#include "glm_includes.h"
+#include <unordered_map>
+#include <vector>
+
+// Side of one cell of a SpatialHash, in blocks: a quarter of a Chunk's side
+#define SPATIAL_HASH_CELL 4
+
+// Finds the points near a given spot without looking at every point.
+// The XZ plane is cut into square cells, each a full-height column like a
+// Chunk, and each cell lists the ids of the points inside it, so a query only
+// visits the cells it overlaps. The world is a heightfield whose entities keep
+// to its surface, so cutting up Y as well would mostly add empty cells to
+// visit. Only the cells that hold points take up memory.
+// Ids are small non-negative ints, such as an index into an array of entities.
+class SpatialHash {
+private:
+    std::unordered_map<int64_t, std::vector<int>> m_cells;
+    // Indexed by id
+    std::vector<glm::vec3> m_positions;
+    std::vector<int64_t> m_cellOf;
+    std::vector<unsigned char> m_present;
+    int m_count;
+
+    static glm::ivec2 cellCoords(glm::vec3 p);
+    void addToCell(int64_t key, int id);
+    void removeFromCell(int64_t key, int id);
+    // Calls visit(id) for every point in the cells from lo to hi inclusive
+    template<typename F>
+    void forEachInCells(glm::ivec2 lo, glm::ivec2 hi, F visit) const;
+
+public:
+    SpatialHash();
+
+    int count() const;
+    bool contains(int id) const;
+    void clear();
+    void insert(int id, glm::vec3 pos);
+    void remove(int id);
+    // Only touches the cell lists if the point crossed into another cell
+    void move(int id, glm::vec3 pos);
+    // Gives the point with id from the id to, which must be free, e.g.
+    // when the last element of an array is moved into a removed one's place
+    void renumber(int from, int to);
+
+    // Appends the id of every point within radius of center
+    void queryRange(glm::vec3 center, float radius, std::vector<int> *out) const;
+    // Appends the ids of the k points nearest to center, nearest first,
+    // leaving out any farther than maxRadius
+    void queryNearest(glm::vec3 center, int k, float maxRadius, std::vector<int> *out) const;
+};
+
+// Times building, moving and querying a SpatialHash of the given number
+// of points against brute force, and prints the results. Run by --spatial-benchmark.
+void benchmarkSpatialHash(int count);
@@ -3,16 +3,33 @@
 #include "biome.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <QElapsedTimer>
 #define CHUNK_LOADING_RADIUS 6
+// Chunks around the player's own that must be resident before physics runs
+#define SPAWN_RING_RADIUS 1
+// Time checkThreadResults may spend uploading Chunk VBOs per tick.
+// The rest wait for the next tick, so a burst of finished meshes
+// at startup never holds back a frame.
+#define CHUNK_UPLOAD_BUDGET_MS 4
 
 Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context)
+    : m_chunks(), m_generatedTerrain(), mp_context(context), m_drawOffsets(context), mp_uploader(nullptr), m_focus(0.f)
 {}
 
 Terrain::~Terrain() {
 
 }
 
+void Terrain::destroy() {
+    m_drawOffsets.destroy();
+    // Uploads still waiting on their fences will never be adopted
+    for (ChunkBuffers &cb : m_fencedUploads) {
+        cb.release(mp_context);
+    }
+    m_fencedUploads.clear();
+}
+
 // Combine two 32-bit ints into one 64-bit int
 // where the upper 32 bits are X and the lower 32 bits are Z
 int64_t toKey(int x, int z) {
@@ -97,6 +114,17 @@ const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
     return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
 }
 
+const Chunk* Terrain::chunkAt(int x, int z) const {
+    int xFloor = static_cast<int>(glm::floor(x / 16.f));
+    int zFloor = static_cast<int>(glm::floor(z / 16.f));
+    auto found = m_chunks.find(toKey(16 * xFloor, 16 * zFloor));
+    return found == m_chunks.end() ? nullptr : found->second.get();
+}
+
+Chunk* Terrain::chunkAt(int x, int z) {
+    return const_cast<Chunk*>(static_cast<const Terrain*>(this)->chunkAt(x, z));
+}
+
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
     if(hasChunkAt(x, z)) {
@@ -114,7 +142,12 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
     }
 }
 
+QReadWriteLock& Terrain::chunkMapLock() {
+    return m_chunksLock;
+}
+
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
+    QWriteLocker chunksLocker(&m_chunksLock);
     uPtr<Chunk> chunk = mkU<Chunk>(mp_context,glm::ivec2(x,z));
     Chunk *cPtr = chunk.get();
     m_chunks[toKey(x, z)] = move(chunk);
@@ -170,7 +203,7 @@ void Terrain::createvbos(int minX, int maxX, int minZ, int maxZ) {
                         int zFloor = static_cast<int>(glm::floor(z / 16.f)) * 16;
                         createChunkData(chunk.get(),pnu_Buffer_opaque_temp,pnu_Buffer_transp_temp,
                                         idx_Buffer_opaque_temp,idx_Buffer_transp_temp,xFloor,zFloor);
-                        chunk->createSingleOpaqueVBO(pnu_Buffer_opaque_temp,idx_Buffer_opaque_temp);
+                        chunk->createSingleOpaqueVBO(pnu_Buffer_opaque_temp,idx_Buffer_opaque_temp,packPositions(pnu_Buffer_opaque_temp));
                         chunk->createSingleTranspVBO(pnu_Buffer_transp_temp,idx_Buffer_transp_temp);
                     }
                 }
@@ -199,7 +232,8 @@ void Terrain::createChunkData(Chunk *cur_Chunk, std::vector<VertexData> &pnu_Buf
                             if(neighbourType != current){
                                 for(const VertexPUData &dat : neighbourFace.vertices)
                                 {
-                                    pnu_Buffer_transp.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceUVs.find(current)->second.find(neighbourFace.direction)->second));
+                                    pnu_Buffer_transp.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceLayers.find(current)->second.find(neighbourFace.direction)->second,
+                                                                    cur_Chunk->getLitFaceTint(x, y, z, current, neighbourFace.direction)));
                                 }
                                 idx_Buffer_transp.push_back(idx_transp);
                                 idx_Buffer_transp.push_back(idx_transp + 1);
@@ -218,7 +252,8 @@ void Terrain::createChunkData(Chunk *cur_Chunk, std::vector<VertexData> &pnu_Buf
                             if(transparent_blocks.find(neighbourType) != transparent_blocks.end()){
                                 for(const VertexPUData &dat : neighbourFace.vertices)
                                 {
-                                    pnu_Buffer_opaque.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceUVs.find(current)->second.find(neighbourFace.direction)->second));
+                                    pnu_Buffer_opaque.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceLayers.find(current)->second.find(neighbourFace.direction)->second,
+                                                                    cur_Chunk->getLitFaceTint(x, y, z, current, neighbourFace.direction)));
                                 }
                                 idx_Buffer_opaque.push_back(idx_opaque);
                                 idx_Buffer_opaque.push_back(idx_opaque + 1);
@@ -236,6 +271,17 @@ void Terrain::createChunkData(Chunk *cur_Chunk, std::vector<VertexData> &pnu_Buf
 
 void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram)
 {
+    drawOpaque(minX, maxX, minZ, maxZ, shaderProgram);
+    drawTransparent(shaderProgram);
+}
+
+void Terrain::drawOpaque(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram)
+{
+    // Gather every drawable Chunk and upload their origins once,
+    // so neither pass touches any uniforms
+    std::vector<Chunk*> &visible = m_visibleChunks;
+    visible.clear();
+    m_drawOffsets.clear();
     for(int x = minX; x < maxX; x += 16) {
             for(int z = minZ; z < maxZ; z += 16) {
                 if(hasChunkAt(x,z))
@@ -243,29 +289,28 @@ void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shader
                     const uPtr<Chunk> &chunk = getChunkAt(x, z);
                     if((chunk->transpvbogenerated()) & (chunk->opaquevbogenerated()))
                     {
-                        int xFloor = static_cast<int>(glm::floor(x / 16.f)) * 16;
-                        int zFloor = static_cast<int>(glm::floor(z / 16.f)) * 16;
-                        shaderProgram->setModelMatrix(glm::translate(glm::mat4(),glm::vec3(xFloor,0,zFloor)));
-                        shaderProgram->drawChunkOpaque(*chunk);
+                        visible.push_back(chunk.get());
+                        m_drawOffsets.add(chunk->m_global_pos);
                     }
                 }
             }
     }
-    for(int x = minX; x < maxX; x += 16) {
-            for(int z = minZ; z < maxZ; z += 16) {
-                if(hasChunkAt(x,z))
-                {
-                    const uPtr<Chunk> &chunk = getChunkAt(x, z);
-                    if((chunk->transpvbogenerated()) & (chunk->opaquevbogenerated()))
-                    {
-                        int xFloor = static_cast<int>(glm::floor(x / 16.f)) * 16;
-                        int zFloor = static_cast<int>(glm::floor(z / 16.f)) * 16;
-                        shaderProgram->setModelMatrix(glm::translate(glm::mat4(),glm::vec3(xFloor,0,zFloor)));
-                        shaderProgram->drawChunkTransp(*chunk);
-                    }
-                }
-            }
+    m_drawOffsets.upload();
+    m_drawOffsets.beginPass(shaderProgram->attrChunkOffset);
+    for(int i = 0; i < static_cast<int>(visible.size()); i++) {
+        shaderProgram->drawChunkOpaque(*visible[i], m_drawOffsets, i);
     }
+    m_drawOffsets.endPass();
+}
+
+void Terrain::drawTransparent(ShaderProgram *shaderProgram)
+{
+    // Other passes have drawn since drawOpaque, so the attribute is set up again
+    m_drawOffsets.beginPass(shaderProgram->attrChunkOffset);
+    for(int i = 0; i < static_cast<int>(m_visibleChunks.size()); i++) {
+        shaderProgram->drawChunkTransp(*m_visibleChunks[i], m_drawOffsets, i);
+    }
+    m_drawOffsets.endPass();
 }
 
 void Terrain::check_to_create_chunk(float x, float z)
@@ -290,6 +335,8 @@ void Terrain::create_chunk_terrian(int m_x, int m_z)
     for(int block_posx = 0; block_posx < 16; ++block_posx) {
         for(int block_posz = 0; block_posz < 16; ++block_posz) {
             fillYSpace(m_x + block_posx, m_z + block_posz);
+            getChunkAt(m_x, m_z)->setColumnTint(block_posx, block_posz,
+                                                packTint(Biome::grassTint(m_x + block_posx, m_z + block_posz)));
         }
     }
 }
@@ -495,54 +542,86 @@ QSet<int64_t> Terrain::terrainZonesBorderingZone(glm::ivec2 zoneCoords, unsigned
 }
 
 
-void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
+ExpansionPlan Terrain::planExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev, bool initial) const {
     // Find the player's position relative
     // to their current terrain gen zone
     glm::ivec2 currZone(64.f * glm::floor(playerPos.x / 64.f), 64.f * glm::floor(playerPos.z / 64.f));
     glm::ivec2 prevZone(64.f * glm::floor(playerPosPrev.x / 64.f), 64.f * glm::floor(playerPosPrev.z / 64.f));
+    ExpansionPlan plan;
+    if (currZone == prevZone && !initial) {
+        return plan;
+    }
     // Determine which terrain zones border our current position and our previous position
-    // This *will* include un-generated terrain zones, so we can compare them to our global set
-    // and know to generate them
+    // This *will* include un-generated terrain zones, which the render thread
+    // sends to FBMWorkers when it carries out the plan
     // TERRAIN_CREATE_RADIUS = 4
     QSet<int64_t> terrainZonesBorderingCurrPos = terrainZonesBorderingZone(currZone, 4, false);
+    if (initial) {
+        plan.zonesToLoad = terrainZonesBorderingCurrPos;
+        return plan;
+    }
     QSet<int64_t> terrainZonesBorderingPrevPos = terrainZonesBorderingZone(prevZone, 4, false);
-    // Check which terrain zones need to be destroy()ed
-    // by determining which terrain zones were previously in our radius and are now not
+    // Zones that were previously in our radius and are now not get destroy()ed.
+    // Those in both sets have already been sent to a worker at some point.
     for (auto id : terrainZonesBorderingPrevPos) {
         if (!terrainZonesBorderingCurrPos.contains(id)) {
-            glm::ivec2 coord = toCoords(id);
-            for (int x = coord.x; x < coord.x + 64; x += 16) {
-                for (int z = coord.y; z < coord.y + 64; z += 16) {
-                    auto &chunk = getChunkAt(x, z);
-                    chunk->destroy();
+            plan.zonesToUnload.insert(id);
+        }
+    }
+    for (auto id : terrainZonesBorderingCurrPos) {
+        if (!terrainZonesBorderingPrevPos.contains(id)) {
+            plan.zonesToLoad.insert(id);
+        }
+    }
+    return plan;
+}
+
+
+void Terrain::queueExpansion(const ExpansionPlan &plan) {
+    QMutexLocker requestsLocker(&m_requestsLock);
+    m_expansionPlans.push_back(plan);
+}
+
+
+void Terrain::requestRemesh(int x, int z) {
+    QMutexLocker requestsLocker(&m_requestsLock);
+    m_remeshRequests.push_back(glm::ivec2(x, z));
+}
+
+
+void Terrain::setFocus(glm::vec3 playerPos) {
+    m_focus = glm::vec2(playerPos.x, playerPos.z);
+}
+
+
+void Terrain::applyExpansionPlan(const ExpansionPlan &plan) {
+    for (auto id : plan.zonesToUnload) {
+        glm::ivec2 coord = toCoords(id);
+        for (int x = coord.x; x < coord.x + 64; x += 16) {
+            for (int z = coord.y; z < coord.y + 64; z += 16) {
+                if (hasChunkAt(x, z)) {
+                    getChunkAt(x, z)->destroy();
                 }
             }
         }
     }
-
-    // Determine if any terrain zones around our current position need VBO data.
-    // Send these to VBOWorkers.
-    // DO NOT send zones to workers if they do not exist in our global map.
-    // Instead, send these to FBMWorkers.
-    for (auto id : terrainZonesBorderingCurrPos) {
-        // If it exists already AND IS NOT IN PREV SET, send it to a VBOWorker
-        // If it's in the prev set, then it's already been sent to a VBOWorker
-        // at some point, and may even already have VBOs
+    // Zones that exist already only need VBO data, so send them to VBOWorkers.
+    // DO NOT send zones to VBOWorkers if they do not exist in our global map.
+    // Instead, send these to FBMWorkers, which also adds them to the set of
+    // generated terrain zones so we don't try to repeatedly generate them.
+    for (auto id : plan.zonesToLoad) {
         if (terrainZoneExists(id)) {
-            if (!terrainZonesBorderingPrevPos.contains(id)) {
-                            glm::ivec2 coord = toCoords(id);
-                            for (int x = coord.x; x < coord.x + 64; x += 16) {
-                                for (int z = coord.y; z < coord.y + 64; z += 16) {
-                                    auto &chunk = getChunkAt(x, z);
-                                    spawnVBOWorker(chunk.get());
-                                }
-                            }
-                        }
-        }
-        // If it does not yet exist, send it to an FBMWorker
-        // This also adds it to the set of generated terrain zones
-        // so we don't try to repeatedly generate it.
-        else {
+            glm::ivec2 coord = toCoords(id);
+            for (int x = coord.x; x < coord.x + 64; x += 16) {
+                for (int z = coord.y; z < coord.y + 64; z += 16) {
+                    // One not stitched yet has its first mesh still to come
+                    Chunk *c = getChunkAt(x, z).get();
+                    if (m_awaitingStitch.count(c) == 0) {
+                        spawnVBOWorker(c);
+                    }
+                }
+            }
+        } else {
             spawnFBMWorker(id);
         }
     }
@@ -558,12 +637,15 @@ void Terrain::spawnFBMWorker(int64_t zoneToGenerate) {
             Chunk* c = instantiateChunkAt(x, z);
             c->m_countOpaque = 0; // Allow it to be "drawn" even with no VBO data
             c->m_countTransp = 0; // Allow it to be "drawn" even with no VBO data
+            c->m_timeline.stamp(ZONE_REQUESTED);
             chunksForWorker.push_back(c);
+            m_awaitingStitch.insert(c);
         }
     }
     FBMWorker *worker = new FBMWorker(coords.x, coords.y, chunksForWorker,
                                       &m_chunksThatHaveBlockData, &m_chunksThatHaveBlockDataLock);
-    QThreadPool::globalInstance()->start(worker);
+    // Meshing a Chunk outranks generating a zone at the same distance
+    QThreadPool::globalInstance()->start(worker, 2 * workerPriority(coords, 64));
 }
 
 
@@ -576,33 +658,177 @@ void Terrain::spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate) {
 
 
 void Terrain::spawnVBOWorker(Chunk* chunkNeedingVBOData) {
-    VBOWorker *worker = new VBOWorker(chunkNeedingVBOData, &m_chunksThatHaveVBOs, &m_chunksThatHaveVBOsLock);
-    QThreadPool::globalInstance()->start(worker);
+    // A remesh, or a Chunk whose FBMWorker may still be running,
+    // so its generation stamps are left out
+    spawnVBOWorker(chunkNeedingVBOData, ChunkTimeline());
+}
+
+
+void Terrain::spawnVBOWorker(Chunk* chunkNeedingVBOData, ChunkTimeline timeline) {
+    timeline.stamp(MESH_QUEUED);
+    VBOWorker *worker = new VBOWorker(chunkNeedingVBOData, timeline, &m_chunksThatHaveVBOs, &m_chunksThatHaveVBOsLock);
+    QThreadPool::globalInstance()->start(worker, 2 * workerPriority(chunkNeedingVBOData->m_global_pos, 16) + 1);
 }
 
 
-void Terrain::spawnVBOWorkers(const std::unordered_set<Chunk*> &chunksNeedingVBOs) {
+void Terrain::spawnVBOWorkers(const std::vector<Chunk*> &chunksNeedingVBOs) {
+    // Only called with Chunks their FBMWorker has handed over
+    // and the LightEngine has stitched since
     for (Chunk* c : chunksNeedingVBOs) {
-        spawnVBOWorker(c);
+        spawnVBOWorker(c, c->m_timeline);
     }
 }
 
 
 void Terrain::checkThreadResults() {
-    // Send Chunks that have been processed by FBMWorkers
-    // to VBOWorkers for VBO data
+    // Carry out what the simulation has asked for since the last call
+    std::vector<ExpansionPlan> plans;
+    std::vector<glm::ivec2> remeshes;
+    std::vector<Chunk*> stitched;
+    m_requestsLock.lock();
+    plans.swap(m_expansionPlans);
+    remeshes.swap(m_remeshRequests);
+    stitched.swap(m_stitchedChunks);
+    m_requestsLock.unlock();
+    for (const ExpansionPlan &plan : plans) {
+        applyExpansionPlan(plan);
+    }
+    // Send Chunks whose light has been joined up to their
+    // neighbors' to VBOWorkers for their first VBO data
+    std::unordered_set<int64_t> remeshed;
+    for (Chunk *c : stitched) {
+        m_awaitingStitch.erase(c);
+        remeshed.insert(toKey(c->m_global_pos.x, c->m_global_pos.y));
+    }
+    spawnVBOWorkers(stitched);
+    // The fluids and the lighting may both ask for the same Chunk in one step
+    for (glm::ivec2 p : remeshes) {
+        // The old mesh is drawn until the new one replaces it
+        Chunk *c = chunkAt(p.x, p.y);
+        if (c != nullptr && m_awaitingStitch.count(c) == 0
+                && remeshed.insert(toKey(c->m_global_pos.x, c->m_global_pos.y)).second) {
+            spawnVBOWorker(c);
+        }
+    }
+
+    // Hand Chunks that have been processed by FBMWorkers to the LightEngine,
+    // which queues them for meshing once their light is stitched
     m_chunksThatHaveBlockDataLock.lock();
-    spawnVBOWorkers(m_chunksThatHaveBlockData);
+    m_requestsLock.lock();
+    m_litChunks.insert(m_litChunks.end(), m_chunksThatHaveBlockData.begin(), m_chunksThatHaveBlockData.end());
+    m_requestsLock.unlock();
     m_chunksThatHaveBlockData.clear();
     m_chunksThatHaveBlockDataLock.unlock();
 
     // Collect the Chunks that have been given VBO data
     // by VBOWorkers and send that VBO data to the GPU.
+    std::vector<ChunkVBOData> ready;
     m_chunksThatHaveVBOsLock.lock();
-    for (ChunkVBOData cd : m_chunksThatHaveVBOs) {
-        cd.mp_chunk->createSingleOpaqueVBO(cd.m_vboDataOpaque, cd.m_idxDataOpaque);
+    ready.swap(m_chunksThatHaveVBOs);
+    m_chunksThatHaveVBOsLock.unlock();
+
+    if (mp_uploader) {
+        mp_uploader->upload(ready);
+        adoptUploadedMeshes();
+    } else {
+        uploadMeshes(ready);
+    }
+}
+
+void Terrain::uploadMeshes(std::vector<ChunkVBOData> &ready) {
+    // Nearest first. The sort is stable, so a Chunk meshed twice
+    // still has its newer data uploaded last.
+    std::stable_sort(ready.begin(), ready.end(), [this](const ChunkVBOData &a, const ChunkVBOData &b) {
+        return workerPriority(a.mp_chunk->m_global_pos, 16) > workerPriority(b.mp_chunk->m_global_pos, 16);
+    });
+    QElapsedTimer uploadTimer;
+    uploadTimer.start();
+    unsigned int uploaded = 0;
+    for (; uploaded < ready.size(); ++uploaded) {
+        if (uploaded > 0 && uploadTimer.elapsed() >= CHUNK_UPLOAD_BUDGET_MS) {
+            break;
+        }
+        ChunkVBOData &cd = ready[uploaded];
+        cd.mp_chunk->createSingleOpaqueVBO(cd.m_vboDataOpaque, cd.m_idxDataOpaque, cd.m_posDataOpaque);
         cd.mp_chunk->createSingleTranspVBO(cd.m_vboDataTransparent, cd.m_idxDataTransparent);
+        meshUploaded(cd.mp_chunk, cd.m_timeline);
     }
-    m_chunksThatHaveVBOs.clear();
-    m_chunksThatHaveVBOsLock.unlock();
+
+    // Whatever did not fit goes back ahead of anything finished meanwhile
+    if (uploaded < ready.size()) {
+        m_chunksThatHaveVBOsLock.lock();
+        m_chunksThatHaveVBOs.insert(m_chunksThatHaveVBOs.begin(),
+                                    std::make_move_iterator(ready.begin() + uploaded),
+                                    std::make_move_iterator(ready.end()));
+        m_chunksThatHaveVBOsLock.unlock();
+    }
+}
+
+void Terrain::adoptUploadedMeshes() {
+    std::vector<ChunkBuffers> uploaded = mp_uploader->takeUploaded();
+    m_fencedUploads.insert(m_fencedUploads.end(), uploaded.begin(), uploaded.end());
+    // Only swapping handles is left to do here. Buffers are taken in the
+    // order they were filled, so a Chunk meshed twice ends up with its newer data.
+    unsigned int adopted = 0;
+    for (; adopted < m_fencedUploads.size(); ++adopted) {
+        ChunkBuffers &cb = m_fencedUploads[adopted];
+        GLenum status = mp_context->glClientWaitSync(cb.m_fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        mp_context->glDeleteSync(cb.m_fence);
+        cb.mp_chunk->adoptBuffers(cb);
+        meshUploaded(cb.mp_chunk, cb.m_timeline);
+    }
+    m_fencedUploads.erase(m_fencedUploads.begin(), m_fencedUploads.begin() + adopted);
+}
+
+void Terrain::meshUploaded(Chunk *c, ChunkTimeline &timeline) {
+    m_remeshedChunks.push_back(c->m_global_pos);
+    timeline.stamp(UPLOADED);
+    timeline.report();
+}
+
+void Terrain::setUploader(ChunkUploader *uploader) {
+    mp_uploader = uploader;
+}
+
+int Terrain::workerPriority(glm::ivec2 origin, int size) const {
+    // Distance from the focus to the nearest point of the square
+    glm::vec2 lo(origin);
+    glm::vec2 nearest = glm::clamp(m_focus, lo, lo + glm::vec2(size));
+    return -static_cast<int>(glm::length(m_focus - nearest) / 16.f);
+}
+
+bool Terrain::initialTerrainDoneLoading(glm::vec3 playerPos) const {
+    int chunkX = 16 * static_cast<int>(glm::floor(playerPos.x / 16.f));
+    int chunkZ = 16 * static_cast<int>(glm::floor(playerPos.z / 16.f));
+    for (int dx = -SPAWN_RING_RADIUS; dx <= SPAWN_RING_RADIUS; ++dx) {
+        for (int dz = -SPAWN_RING_RADIUS; dz <= SPAWN_RING_RADIUS; ++dz) {
+            int x = chunkX + 16 * dx;
+            int z = chunkZ + 16 * dz;
+            if (!hasChunkAt(x, z) || !getChunkAt(x, z)->opaquevbogenerated()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<glm::ivec2> Terrain::takeRemeshedChunks() {
+    std::vector<glm::ivec2> remeshed;
+    remeshed.swap(m_remeshedChunks);
+    return remeshed;
+}
+
+std::vector<Chunk*> Terrain::takeLitChunks() {
+    QMutexLocker requestsLocker(&m_requestsLock);
+    std::vector<Chunk*> lit;
+    lit.swap(m_litChunks);
+    return lit;
+}
+
+void Terrain::queueStitchedChunks(const std::vector<Chunk*> &chunks) {
+    QMutexLocker requestsLocker(&m_requestsLock);
+    m_stitchedChunks.insert(m_stitchedChunks.end(), chunks.begin(), chunks.end());
 }
@@ -6,10 +6,13 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "shaderprogram.h"
+#include "drawoffsetbuffer.h"
 #include "cube.h"
 #include <QThreadPool>
+#include <QReadWriteLock>
 #include "vboworker.h"
 #include "fbmworker.h"
+#include "chunkuploader.h"
 
 //using namespace std;
 
@@ -17,6 +20,13 @@
 int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
+// The terrain zones to stream in and out after the Player moved,
+// as decided by the simulation thread for the render thread to carry out
+struct ExpansionPlan {
+    QSet<int64_t> zonesToLoad;   // Zones that came into range
+    QSet<int64_t> zonesToUnload; // Zones that went out of range
+};
+
 // The container class for all of the Chunks in the game.
 // Ultimately, while Terrain will always store all Chunks,
 // not all Chunks will be drawn at any given time as the world
@@ -29,6 +39,9 @@ private:
     // so that we can use them as a key for the map, as objects like std::pairs or
     // glm::ivec2s are not hashable by default, so they cannot be used as keys.
     std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
+    // Only the render thread adds Chunks to m_chunks, so only
+    // the other threads need to read-lock it
+    QReadWriteLock m_chunksLock;
 
     // We will designate every 64 x 64 area of the world's x-z plane
     // as one "terrain generation zone". Every time the player moves
@@ -55,16 +68,62 @@ private:
 
 
     OpenGLContext* mp_context;
+    // Origins of the Chunks drawn this frame
+    DrawOffsetBuffer m_drawOffsets;
+    // The Chunks gathered by the last drawOpaque, in draw order
+    std::vector<Chunk*> m_visibleChunks;
 
     // For Milestone-2 multi-threading
     std:: unordered_set<Chunk*> m_chunksThatHaveBlockData;
     QMutex m_chunksThatHaveBlockDataLock;
     std::vector<ChunkVBOData> m_chunksThatHaveVBOs;
     QMutex m_chunksThatHaveVBOsLock;
+    // Uploads meshes off the render thread when set
+    ChunkUploader *mp_uploader;
+    // Buffers mp_uploader has filled whose fences have not signaled yet, oldest first
+    std::vector<ChunkBuffers> m_fencedUploads;
+    // Origins of the Chunks whose VBOs were (re)uploaded
+    // since the last call to takeRemeshedChunks()
+    std::vector<glm::ivec2> m_remeshedChunks;
+    // Player XZ as of the last setFocus(). Workers nearest to it run first.
+    glm::vec2 m_focus;
+    // Requests from the simulation thread, carried out by checkThreadResults()
+    std::vector<ExpansionPlan> m_expansionPlans;
+    std::vector<glm::ivec2> m_remeshRequests;
+    QMutex m_requestsLock;
+    // Chunks handed over by their FBMWorker since the last call to
+    // takeLitChunks(), whose light is still to be joined to their neighbors'.
+    // Guarded by m_requestsLock.
+    std::vector<Chunk*> m_litChunks;
+    // Chunks the LightEngine has stitched since the last checkThreadResults(),
+    // now ready for their first mesh. Guarded by m_requestsLock.
+    std::vector<Chunk*> m_stitchedChunks;
+    // Chunks sent to an FBMWorker whose light the LightEngine has not stitched
+    // yet. Their first mesh waits for it, so their light never pops, and will
+    // show any change asked to be remeshed meanwhile, or any reload of their
+    // zone. Only touched by the render thread.
+    std::unordered_set<Chunk*> m_awaitingStitch;
+
+    void applyExpansionPlan(const ExpansionPlan &plan);
+    // The two ways checkThreadResults can get meshes to the GPU
+    void uploadMeshes(std::vector<ChunkVBOData> &ready);
+    void adoptUploadedMeshes();
+    // Bookkeeping for a Chunk whose new mesh can now be drawn
+    void meshUploaded(Chunk *c, ChunkTimeline &timeline);
+
+    // Queue priority of a worker for the square of the given size at origin:
+    // higher the nearer it is to m_focus, so the ground under the player comes first
+    int workerPriority(glm::ivec2 origin, int size) const;
 
 public:
     Terrain(OpenGLContext *context);
     ~Terrain();
+    // Releases the GPU buffers Terrain owns itself, uploads waiting on their
+    // fences included. Needs the context current, and the uploader stopped.
+    void destroy();
+
+    // Hold for reading to look Chunks up from any thread but the render thread
+    QReadWriteLock& chunkMapLock();
 
     // Instantiates a new Chunk and stores it in
     // our chunk map at the given coordinates.
@@ -79,6 +138,10 @@ public:
     // Assuming a Chunk exists at these coords,
     // return a const reference to it
     const uPtr<Chunk>& getChunkAt(int x, int z) const;
+    // The Chunk containing these world-space coordinates, or nullptr
+    // if there is none. Costs a single lookup, unlike the pair above.
+    const Chunk* chunkAt(int x, int z) const;
+    Chunk* chunkAt(int x, int z);
     // Given a world-space coordinate (which may have negative
     // values) return the block stored at that point in space.
     BlockType getBlockAt(int x, int y, int z) const;
@@ -95,6 +158,10 @@ public:
     void createChunkData(Chunk* cur_Chunk,std::vector<VertexData>& pnu_Buffer_opaque,std::vector<VertexData>& pnu_Buffer_transp,
                          std::vector<GLuint>& idx_Buffer_opaque,std::vector<GLuint>& idx_Buffer_transp,const int& m_x,const int& m_z);
     void draw(int minX, int maxX, int minZ, int maxZ,ShaderProgram *shaderProgram);
+    // The two halves of draw(), for when other passes must run in between.
+    // drawTransparent draws the Chunks that the last drawOpaque gathered.
+    void drawOpaque(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
+    void drawTransparent(ShaderProgram *shaderProgram);
     void check_to_create_chunk(float x,float z);
     void create_chunk_terrian(int m_x,int m_z);
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
@@ -106,13 +173,36 @@ public:
     bool terrainZoneExists(int64_t id) const;
 
     void generateTerrain(int minX, int maxX, int minZ, int maxZ);
-    void tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev);
+    // The zones to load and unload now that the Player has moved from playerPosPrev
+    // to playerPos, or every zone in range of playerPos if initial is set.
+    // Safe to call from any thread.
+    ExpansionPlan planExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev, bool initial) const;
+    // Safe to call from any thread. Carried out by the next checkThreadResults().
+    void queueExpansion(const ExpansionPlan &plan);
+    void requestRemesh(int x, int z);
+    void setFocus(glm::vec3 playerPos);
     void spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate);
     void spawnFBMWorker(int64_t zoneToGenerate);
-    void spawnVBOWorkers(const std::unordered_set<Chunk *> &chunksNeedingVBOs);
+    void spawnVBOWorkers(const std::vector<Chunk *> &chunksNeedingVBOs);
     void spawnVBOWorker(Chunk* chunkNeedingVBOData);
+    // As above, continuing the timeline of the Chunk's trip through the pipeline
+    void spawnVBOWorker(Chunk* chunkNeedingVBOData, ChunkTimeline timeline);
     void checkThreadResults();
-    bool initialTerrainDoneLoading() const;
+    // Hands finished meshes to the given uploader, which must outlive
+    // this Terrain or be unset first, instead of uploading them here
+    void setUploader(ChunkUploader *uploader);
+    // Returns and forgets the Chunks uploaded by checkThreadResults(),
+    // so caches built from Chunk geometry know what to refresh
+    std::vector<glm::ivec2> takeRemeshedChunks();
+    // Returns and forgets the Chunks whose FBMWorkers have finished,
+    // for the LightEngine to stitch. Safe to call from any thread.
+    std::vector<Chunk*> takeLitChunks();
+    // Safe to call from any thread. The next checkThreadResults() gives
+    // the given Chunks, which the LightEngine has stitched, their first mesh.
+    void queueStitchedChunks(const std::vector<Chunk*> &chunks);
+    // Have the Chunk under the given position and the ring of
+    // Chunks around it all been meshed and uploaded?
+    bool initialTerrainDoneLoading(glm::vec3 playerPos) const;
     QSet<int64_t> terrainZonesBorderingZone(glm::ivec2 zoneCoords, unsigned int radius, bool onlyCircumference) const;
 
 
@@ -1,11 +1,13 @@
 #include "vboworker.h"
+#include "profiler.h"
 
-VBOWorker::VBOWorker(Chunk *c, std::vector<ChunkVBOData> *dat, QMutex *datLock)
-    : mp_chunk(c), mp_chunkVBOsCompleted(dat), mp_chunkVBOsCompletedLock(datLock)
+VBOWorker::VBOWorker(Chunk *c, const ChunkTimeline &timeline, std::vector<ChunkVBOData> *dat, QMutex *datLock)
+    : mp_chunk(c), m_timeline(timeline), mp_chunkVBOsCompleted(dat), mp_chunkVBOsCompletedLock(datLock)
 {}
 
 void VBOWorker::run() {
-    ChunkVBOData c(mp_chunk);
+    ChunkVBOData c(mp_chunk, m_timeline);
+    c.m_timeline.stamp(MESH_START);
 
     // TODO: createvbos() function in Terrain
     int idx_opaque = 0;
@@ -27,7 +29,8 @@ void VBOWorker::run() {
                                 if(neighbourType != current){
                                     for(const VertexPUData &dat : neighbourFace.vertices)
                                     {
-                                        c.m_vboDataTransparent.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceUVs.find(current)->second.find(neighbourFace.direction)->second));
+                                        c.m_vboDataTransparent.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceLayers.find(current)->second.find(neighbourFace.direction)->second,
+                                                                    mp_chunk->getLitFaceTint(x, y, z, current, neighbourFace.direction)));
                                     }
                                     c.m_idxDataTransparent.push_back(idx_transp);
                                     c.m_idxDataTransparent.push_back(idx_transp + 1);
@@ -47,7 +50,9 @@ void VBOWorker::run() {
                                 if(transparent_blocks.find(neighbourType) != transparent_blocks.end()){
                                     for(const VertexPUData &dat : neighbourFace.vertices)
                                     {
-                                        c.m_vboDataOpaque.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceUVs.find(current)->second.find(neighbourFace.direction)->second));
+                                        c.m_vboDataOpaque.push_back(VertexData(dat,neighbourFace.directionVec,glm::vec4(x,y,z,0),blockFaceLayers.find(current)->second.find(neighbourFace.direction)->second,
+                                                                    mp_chunk->getLitFaceTint(x, y, z, current, neighbourFace.direction)));
+                                        c.m_posDataOpaque.push_back(VertexPos(c.m_vboDataOpaque.back().pos));
                                     }
                                     c.m_idxDataOpaque.push_back(idx_opaque);
                                     c.m_idxDataOpaque.push_back(idx_opaque + 1);
@@ -61,6 +66,8 @@ void VBOWorker::run() {
                         }
                     }
                 }
+    c.m_timeline.stamp(MESH_END);
+    Profiler::instance().addWorkerSample("mesh", c.m_timeline.stamps[MESH_START], c.m_timeline.stamps[MESH_END]);
     mp_chunkVBOsCompletedLock->lock();
     mp_chunkVBOsCompleted->push_back(c);
     mp_chunkVBOsCompletedLock->unlock();
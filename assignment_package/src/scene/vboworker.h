@@ -10,10 +10,11 @@ class VBOWorker : public QRunnable
 {
 protected:
     Chunk* mp_chunk;
+    ChunkTimeline m_timeline; // Stamped up to MESH_QUEUED by Terrain
     std::vector<ChunkVBOData>* mp_chunkVBOsCompleted;
     QMutex *mp_chunkVBOsCompletedLock;
 public:
-    VBOWorker(Chunk* c, std::vector<ChunkVBOData>* dat, QMutex *datLock);
+    VBOWorker(Chunk* c, const ChunkTimeline &timeline, std::vector<ChunkVBOData>* dat, QMutex *datLock);
     ~VBOWorker(){};
     void run() override;
 };
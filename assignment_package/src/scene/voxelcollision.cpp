@@ -0,0 +1,83 @@
+#include "voxelcollision.h"
+#include <vector>
+
+AABB::AABB(glm::vec3 min, glm::vec3 max)
+    : min(min), max(max)
+{}
+
+bool isSolidBlock(BlockType t) {
+    return t != EMPTY && t != WATER && t != LAVA;
+}
+
+namespace {
+// Appends the world position of every solid block overlapping the region
+void gatherSolidBlocks(const Terrain &terrain, const AABB &region, std::vector<glm::ivec3> *out) {
+    glm::ivec3 lo(glm::floor(region.min));
+    glm::ivec3 hi(glm::floor(region.max));
+    lo.y = glm::max(lo.y, 0);
+    hi.y = glm::min(hi.y, 255);
+    for(int x = lo.x; x <= hi.x; ++x) {
+        for(int z = lo.z; z <= hi.z; ++z) {
+            // A missing Chunk has nothing to collide with
+            const Chunk *c = terrain.chunkAt(x, z);
+            if(c == nullptr) {
+                continue;
+            }
+            unsigned int localX = x - c->m_global_pos.x;
+            unsigned int localZ = z - c->m_global_pos.y;
+            for(int y = lo.y; y <= hi.y; ++y) {
+                if(isSolidBlock(c->getBlockAt(localX, static_cast<unsigned int>(y), localZ))) {
+                    out->push_back(glm::ivec3(x, y, z));
+                }
+            }
+        }
+    }
+}
+
+// Shortens the motion along one axis so the box stops before any of the blocks
+// lying ahead of it. Blocks it already overlaps are ignored, so it can not get stuck.
+float clipAxis(const std::vector<glm::ivec3> &blocks, const AABB &box, int axis, float motion) {
+    int a1 = (axis + 1) % 3;
+    int a2 = (axis + 2) % 3;
+    for(const glm::ivec3 &block : blocks) {
+        glm::vec3 blockMin(block);
+        glm::vec3 blockMax = blockMin + glm::vec3(1.f);
+        if(box.max[a1] <= blockMin[a1] || box.min[a1] >= blockMax[a1]
+                || box.max[a2] <= blockMin[a2] || box.min[a2] >= blockMax[a2]) {
+            continue;
+        }
+        if(motion > 0.f && blockMin[axis] >= box.max[axis]) {
+            motion = glm::min(motion, glm::max(0.f, blockMin[axis] - box.max[axis] - VOXEL_COLLISION_SKIN));
+        } else if(motion < 0.f && blockMax[axis] <= box.min[axis]) {
+            motion = glm::max(motion, glm::min(0.f, blockMax[axis] - box.min[axis] + VOXEL_COLLISION_SKIN));
+        }
+    }
+    return motion;
+}
+}
+
+glm::vec3 sweepAABB(const Terrain &terrain, const AABB &box, glm::vec3 motion, glm::bvec3 *hitAxes) {
+    // Every block the box could touch on its way
+    AABB region(glm::min(box.min, box.min + motion) - glm::vec3(VOXEL_COLLISION_SKIN),
+                glm::max(box.max, box.max + motion) + glm::vec3(VOXEL_COLLISION_SKIN));
+    static thread_local std::vector<glm::ivec3> blocks;
+    blocks.clear();
+    gatherSolidBlocks(terrain, region, &blocks);
+
+    glm::vec3 allowed = motion;
+    AABB moved = box;
+    // Vertical first, so walking into a wall while falling still lands
+    const int AXIS_ORDER[3] = {1, 0, 2};
+    for(int axis : AXIS_ORDER) {
+        if(allowed[axis] == 0.f) {
+            continue;
+        }
+        allowed[axis] = clipAxis(blocks, moved, axis, allowed[axis]);
+        moved.min[axis] += allowed[axis];
+        moved.max[axis] += allowed[axis];
+    }
+    if(hitAxes != nullptr) {
+        *hitAxes = glm::notEqual(allowed, motion);
+    }
+    return allowed;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "glm_includes.h"
+#include "terrain.h"
+
+// Gap left between a moving box and the blocks it is stopped by,
+// so it is never found touching them on the next move
+#define VOXEL_COLLISION_SKIN 0.005f
+
+// An axis-aligned box in world space
+struct AABB {
+    glm::vec3 min, max;
+    AABB(glm::vec3 min, glm::vec3 max);
+};
+
+// Do entities collide with blocks of this type?
+bool isSolidBlock(BlockType t);
+
+// Returns as much of the given motion as the box can make without entering
+// a solid block of the Terrain. The blocks the moving box could touch are
+// gathered once, reading each Chunk column directly, and the motion is then
+// resolved along Y, X and Z in turn, so the box slides along any floor or
+// wall it meets. Any entity's box can be swept this way.
+// If hitAxes is given, each component is set to whether the motion along
+// that axis was cut short.
+glm::vec3 sweepAABB(const Terrain &terrain, const AABB &box, glm::vec3 motion, glm::bvec3 *hitAxes = nullptr);
@@ -1,63 +1,27 @@
 #include "shaderprogram.h"
-#include <QFile>
-#include <QStringBuilder>
-#include <QTextStream>
 #include <QDebug>
 #include <stdexcept>
 #include "scene/chunk.h"
+#include "scene/farterrain.h"
+#include "uniformbuffer.h"
+#include "drawoffsetbuffer.h"
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
-    : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrCol(-1),attrUV(-1),
-      unifModel(-1), unifModelInvTr(-1), unifViewProj(-1),unifColor(-1),unifLightDir(-1),unifShadowBiasMVP(-1),unifSampler2D(-1),unifShadowSampler2D(-1), unifTime(-1),
-       unifDimensions(-1),unifEye(-1),unifCamPos(-1),
+    : prog(),
+      attrPos(-1), attrNor(-1), attrCol(-1),attrUV(-1),attrChunkOffset(-1),
+      unifModel(-1), unifModelInvTr(-1), unifColor(-1),unifSampler2D(-1),unifShadowSampler2D{-1, -1, -1}, unifTime(-1),
       context(context)
 {}
 
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
 {
-    // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
-    vertShader = context->glCreateShader(GL_VERTEX_SHADER);
-    fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
-    prog = context->glCreateProgram();
     // Get the body of text stored in our two .glsl files
-    QString qVertSource = qTextFileRead(vertfile);
-    QString qFragSource = qTextFileRead(fragfile);
-
-    char* vertSource = new char[qVertSource.size()+1];
-    strcpy(vertSource, qVertSource.toStdString().c_str());
-    char* fragSource = new char[qFragSource.size()+1];
-    strcpy(fragSource, qFragSource.toStdString().c_str());
-
-
-    // Send the shader text to OpenGL and store it in the shaders specified by the handles vertShader and fragShader
-    context->glShaderSource(vertShader, 1, (const char**)&vertSource, 0);
-    context->glShaderSource(fragShader, 1, (const char**)&fragSource, 0);
-    // Tell OpenGL to compile the shader text stored above
-    context->glCompileShader(vertShader);
-    context->glCompileShader(fragShader);
-    // Check if everything compiled OK
-    GLint compiled;
-    context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(vertShader);
-    }
-    context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(fragShader);
-    }
-
-    // Tell prog that it manages these particular vertex and fragment shaders
-    context->glAttachShader(prog, vertShader);
-    context->glAttachShader(prog, fragShader);
-    context->glLinkProgram(prog);
+    createFromSource(ProgramBinaryCache::readSource(vertfile), ProgramBinaryCache::readSource(fragfile));
+}
 
-    // Check for linking success
-    GLint linked;
-    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        printLinkInfoLog(prog);
-    }
+void ShaderProgram::createFromSource(const QByteArray &vertSource, const QByteArray &fragSource)
+{
+    prog = context->programBinaries().build(vertSource, fragSource);
 
     // Get the handles to the variables stored in our shaders
     // See shaderprogram.h for more information about these variables
@@ -68,29 +32,37 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     if(attrCol == -1) attrCol = context->glGetAttribLocation(prog, "vs_ColInstanced");
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
     attrUV  = context->glGetAttribLocation(prog, "vs_UV");
+    attrChunkOffset = context->glGetAttribLocation(prog, "vs_ChunkOffset");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
-    unifViewProj   = context->glGetUniformLocation(prog, "u_ViewProj");
     unifColor      = context->glGetUniformLocation(prog, "u_Color");
-    unifLightDir   = context->glGetUniformLocation(prog, "lightDir");
-    unifShadowBiasMVP = context->glGetUniformLocation(prog, "u_depthbiasMVP");
     setupMemberVars();
-    unifDimensions = context->glGetUniformLocation(prog, "u_Dimensions");
-    unifEye = context->glGetUniformLocation(prog, "u_Eye");
+
+    // Uniform values and block bindings are not saved in a program binary,
+    // so they are set here whichever way prog was built.
+    // Camera, light and time come from the shared PerFrame block
+    GLuint perFrameIdx = context->glGetUniformBlockIndex(prog, "PerFrame");
+    if(perFrameIdx != GL_INVALID_INDEX) {
+        context->glUniformBlockBinding(prog, perFrameIdx, PER_FRAME_UBO_BINDING);
+    }
+    // Samplers are program state, so they only need to be set once
+    useMe();
+    setSamplerSlots();
 }
 
 
 void ShaderProgram::setupMemberVars() {
     unifSampler2D  = context->glGetUniformLocation(prog, "u_Texture");
-    unifShadowSampler2D = context->glGetUniformLocation(prog, "u_Shadow");
+    unifShadowSampler2D[0] = context->glGetUniformLocation(prog, "u_Shadow");
+    unifShadowSampler2D[1] = context->glGetUniformLocation(prog, "u_Shadow1");
+    unifShadowSampler2D[2] = context->glGetUniformLocation(prog, "u_Shadow2");
     unifTime = context->glGetUniformLocation(prog, "u_Time");
-    unifCamPos = context->glGetUniformLocation(prog, "u_Cam");
 }
 
 void ShaderProgram::useMe()
 {
-    context->glUseProgram(prog);
+    context->useProgram(prog);
 }
 
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
@@ -123,38 +95,18 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 }
 
-void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
+void ShaderProgram::setSamplerSlots()
 {
-    // Tell OpenGL to use this shader program for subsequent function calls
-    useMe();
-
-    if(unifViewProj != -1) {
-    // Pass a 4x4 matrix into a uniform variable in our shader
-                    // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifViewProj,
-                    // How many matrices to pass
-                       1,
-                    // Transpose the matrix? OpenGL uses column-major, so no.
-                       GL_FALSE,
-                    // Pointer to the first element of the matrix
-                       &vp[0][0]);
+    if(unifSampler2D != -1)
+    {
+        context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
     }
-}
-
-void ShaderProgram::setShadowViewProjMatrix(const glm::mat4 &vp)
-{
-    useMe();
-
-    if(unifShadowBiasMVP != -1) {
-    // Pass a 4x4 matrix into a uniform variable in our shader
-                    // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifShadowBiasMVP,
-                    // How many matrices to pass
-                       1,
-                    // Transpose the matrix? OpenGL uses column-major, so no.
-                       GL_FALSE,
-                    // Pointer to the first element of the matrix
-                       &vp[0][0]);
+    for(int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+    {
+        if(unifShadowSampler2D[i] != -1)
+        {
+            context->glUniform1i(unifShadowSampler2D[i], SHADOW_CASCADE_SLOTS[i]);
+        }
     }
 }
 
@@ -168,16 +120,6 @@ void ShaderProgram::setGeometryColor(glm::vec4 color)
     }
 }
 
-void ShaderProgram::setLightDir(const glm::vec4 &ldr)
-{
-    useMe();
-
-    if(unifLightDir != -1)
-    {
-        context->glUniform4fv(unifLightDir, 1, &ldr[0]);
-    }
-}
-
 //This function, as its name implies, uses the passed in GL widget
 void ShaderProgram::draw(Drawable &d)
 {
@@ -223,17 +165,9 @@ void ShaderProgram::draw(Drawable &d)
     context->printGLErrorLog();
 }
 
-void ShaderProgram::drawChunkOpaque(Chunk &d)
+void ShaderProgram::drawChunkOpaque(Chunk &d, DrawOffsetBuffer &offsets, int drawIdx)
 {
         useMe();
-        if(unifSampler2D != -1)
-        {
-            context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
-        }
-        if(unifShadowSampler2D != -1)
-        {
-            context->glUniform1i(unifShadowSampler2D, /*GL_TEXTURE*/1);
-        }
         if(d.elemCountOpaque() < 0) {
             throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
         }
@@ -242,38 +176,37 @@ void ShaderProgram::drawChunkOpaque(Chunk &d)
             if(attrPos != -1)
             {
                 context->glEnableVertexAttribArray(attrPos);
-                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (0));
+                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, sizeof(VertexData), (void*) offsetof(VertexData, pos));
             }
             if(attrNor != -1)
             {
                 context->glEnableVertexAttribArray(attrNor);
-                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false,  2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (sizeof(glm::vec4)));
+                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false,  sizeof(VertexData), (void*) offsetof(VertexData, nor));
             }
             if (attrUV != -1) {
                 context->glEnableVertexAttribArray(attrUV);
-                context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false,  2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (2 * sizeof(glm::vec4)));
+                context->glVertexAttribPointer(attrUV, 3, GL_FLOAT, false,  sizeof(VertexData), (void*) offsetof(VertexData, uv));
+            }
+            if (attrCol != -1) {
+                // The baked biome tint, four normalized bytes
+                context->glEnableVertexAttribArray(attrCol);
+                context->glVertexAttribPointer(attrCol, 4, GL_UNSIGNED_BYTE, true, sizeof(VertexData), (void*) offsetof(VertexData, tint));
             }
         }
         d.bindIdxOpaque();
-        context->glDrawElements(d.drawMode(), d.elemCountOpaque(), GL_UNSIGNED_INT, 0);
+        // The offsets' pass already points vs_ChunkOffset at them
+        offsets.drawElements(d.drawMode(), d.elemCountOpaque(), drawIdx);
         if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
         if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
         if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
+        if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
 
         context->printGLErrorLog();
 }
 
-void ShaderProgram::drawChunkTransp(Chunk &d)
+void ShaderProgram::drawChunkTransp(Chunk &d, DrawOffsetBuffer &offsets, int drawIdx)
 {
         useMe();
-        if(unifSampler2D != -1)
-        {
-            context->glUniform1i(unifSampler2D, /*GL_TEXTURE*/0);
-        }
-        if(unifShadowSampler2D != -1)
-        {
-            context->glUniform1i(unifShadowSampler2D, /*GL_TEXTURE*/1);
-        }
         if(d.elemCountTransp() < 0) {
             throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
         }
@@ -282,23 +215,70 @@ void ShaderProgram::drawChunkTransp(Chunk &d)
             if(attrPos != -1)
             {
                 context->glEnableVertexAttribArray(attrPos);
-                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (0));
+                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, sizeof(VertexData), (void*) offsetof(VertexData, pos));
             }
             if(attrNor != -1)
             {
                 context->glEnableVertexAttribArray(attrNor);
-                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false,  2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (sizeof(glm::vec4)));
+                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false,  sizeof(VertexData), (void*) offsetof(VertexData, nor));
             }
             if (attrUV != -1) {
                 context->glEnableVertexAttribArray(attrUV);
-                context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false,  2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (2 * sizeof(glm::vec4)));
+                context->glVertexAttribPointer(attrUV, 3, GL_FLOAT, false,  sizeof(VertexData), (void*) offsetof(VertexData, uv));
+            }
+            if (attrCol != -1) {
+                // The baked biome tint, four normalized bytes
+                context->glEnableVertexAttribArray(attrCol);
+                context->glVertexAttribPointer(attrCol, 4, GL_UNSIGNED_BYTE, true, sizeof(VertexData), (void*) offsetof(VertexData, tint));
             }
         }
         d.bindIdxTransp();
-        context->glDrawElements(d.drawMode(), d.elemCountTransp(), GL_UNSIGNED_INT, 0);
+        // The offsets' pass already points vs_ChunkOffset at them
+        offsets.drawElements(d.drawMode(), d.elemCountTransp(), drawIdx);
+        if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
+        if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
+        if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
+        if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
+
+        context->printGLErrorLog();
+}
+
+void ShaderProgram::drawFarTile(FarTile &d, DrawOffsetBuffer &offsets, int drawIdx)
+{
+        useMe();
+        if(d.elemCount() < 0) {
+            throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
+        }
+        // Far tiles share the Chunk vertex layout, interleaved in their position buffer
+        if(d.bindPos())
+        {
+            if(attrPos != -1)
+            {
+                context->glEnableVertexAttribArray(attrPos);
+                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, sizeof(VertexData), (void*) offsetof(VertexData, pos));
+            }
+            if(attrNor != -1)
+            {
+                context->glEnableVertexAttribArray(attrNor);
+                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false,  sizeof(VertexData), (void*) offsetof(VertexData, nor));
+            }
+            if (attrUV != -1) {
+                context->glEnableVertexAttribArray(attrUV);
+                context->glVertexAttribPointer(attrUV, 3, GL_FLOAT, false,  sizeof(VertexData), (void*) offsetof(VertexData, uv));
+            }
+            if (attrCol != -1) {
+                // The baked biome tint, four normalized bytes
+                context->glEnableVertexAttribArray(attrCol);
+                context->glVertexAttribPointer(attrCol, 4, GL_UNSIGNED_BYTE, true, sizeof(VertexData), (void*) offsetof(VertexData, tint));
+            }
+        }
+        d.bindIdx();
+        // The offsets' pass already points vs_ChunkOffset at them
+        offsets.drawElements(d.drawMode(), d.elemCount(), drawIdx);
         if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
         if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
         if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
+        if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
 
         context->printGLErrorLog();
 }
@@ -357,82 +337,6 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
 
 }
 
-char* ShaderProgram::textFileRead(const char* fileName) {
-    char* text;
-
-    if (fileName != NULL) {
-        FILE *file = fopen(fileName, "rt");
-
-        if (file != NULL) {
-            fseek(file, 0, SEEK_END);
-            int count = ftell(file);
-            rewind(file);
-
-            if (count > 0) {
-                text = (char*)malloc(sizeof(char) * (count + 1));
-                count = fread(text, sizeof(char), count, file);
-                text[count] = '\0';	//cap off the string with a terminal symbol, fixed by Cory
-            }
-            fclose(file);
-        }
-    }
-    return text;
-}
-
-QString ShaderProgram::qTextFileRead(const char *fileName)
-{
-    QString text;
-    QFile file(fileName);
-    if(file.open(QFile::ReadOnly))
-    {
-        QTextStream in(&file);
-        text = in.readAll();
-        text.append('\0');
-    }
-    return text;
-}
-
-void ShaderProgram::printShaderInfoLog(int shader)
-{
-    int infoLogLen = 0;
-    int charsWritten = 0;
-    GLchar *infoLog;
-
-    context->glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLen);
-
-    // should additionally check for OpenGL errors here
-
-    if (infoLogLen > 0)
-    {
-        infoLog = new GLchar[infoLogLen];
-        // error check for fail to allocate memory omitted
-        context->glGetShaderInfoLog(shader,infoLogLen, &charsWritten, infoLog);
-        qDebug() << "ShaderInfoLog:" << "\n" << infoLog << "\n";
-        delete [] infoLog;
-    }
-
-    // should additionally check for OpenGL errors here
-}
-
-void ShaderProgram::printLinkInfoLog(int prog)
-{
-    int infoLogLen = 0;
-    int charsWritten = 0;
-    GLchar *infoLog;
-
-    context->glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &infoLogLen);
-
-    // should additionally check for OpenGL errors here
-
-    if (infoLogLen > 0) {
-        infoLog = new GLchar[infoLogLen];
-        // error check for fail to allocate memory omitted
-        context->glGetProgramInfoLog(prog, infoLogLen, &charsWritten, infoLog);
-        qDebug() << "LinkInfoLog:" << "\n" << infoLog << "\n";
-        delete [] infoLog;
-    }
-}
-
 void ShaderProgram::setTime(int t)
 {
     useMe();
@@ -442,29 +346,3 @@ void ShaderProgram::setTime(int t)
         context->glUniform1i(unifTime, t);
     }
 }
-
-void ShaderProgram::setEye(glm::vec3 eye) {
-    useMe();
-
-    if (unifEye != -1) {
-        context->glUniform3fv(unifEye, 1, &eye[0]);
-    }
-}
-
-void ShaderProgram::setDim(glm::vec2 dim) {
-    useMe();
-
-    if (unifDimensions != -1) {
-        context->glUniform2fv(unifDimensions, 1, &dim[0]);
-    }
-}
-
-void ShaderProgram::setCamPos(const glm::vec3 &camera)
-{
-    useMe();
-
-    if (unifCamPos != -1)
-    {
-        context->glUniform3fv(unifCamPos, 1, &camera[0]);
-    }
-}
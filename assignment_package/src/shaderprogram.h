@@ -7,74 +7,68 @@
 
 #include "drawable.h"
 class Chunk;
+class FarTile;
+class DrawOffsetBuffer;
+
+// Number of shadow map cascades sampled by the surface shaders
+#define SHADOW_CASCADE_COUNT 3
+// Texture slots the cascades are bound to, nearest first.
+// Slot 0 holds the block texture and slot 2 the post-process input.
+const unsigned int SHADOW_CASCADE_SLOTS[SHADOW_CASCADE_COUNT] = {1, 3, 4};
 
 class ShaderProgram
 {
 public:
-    GLuint vertShader; // A handle for the vertex shader stored in this shader program
-    GLuint fragShader; // A handle for the fragment shader stored in this shader program
     GLuint prog;       // A handle for the linked shader program stored in this class
 
     int attrPos; // A handle for the "in" vec4 representing vertex position in the vertex shader
     int attrNor; // A handle for the "in" vec4 representing vertex normal in the vertex shader
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
-    int attrUV; // A handle for the "in" vec2 representing the UV coordinates in the vertex shader
+    int attrUV; // A handle for the "in" vec2 (vec3 with a texture array layer for terrain) representing the UV coordinates in the vertex shader
+    int attrChunkOffset; // A handle for the instanced "in" ivec2 representing the world-space XZ origin of the Chunk being drawn
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
-    int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
     int unifColor; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
-    int unifLightDir; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
-    int unifShadowBiasMVP;
 
     int unifSampler2D; // A handle to the "uniform" sampler2D that will be used to read the texture containing the scene render
-    int unifShadowSampler2D;
+    int unifShadowSampler2D[SHADOW_CASCADE_COUNT]; // Handles to the "uniform" sampler2Ds of the shadow cascades
     int unifTime; // A handle for the "uniform" float representing time in the shader
 
-    int unifDimensions;
-    int unifEye;
-    int unifCamPos;  // A handle to a uniform vec3 in a surface shader that represents your camera's
-                     // position in world space
-
 
 public:
     ShaderProgram(OpenGLContext* context);
     // Sets up the requisite GL data and shaders from the given .glsl files
     void create(const char *vertfile, const char *fragfile);
+    // As create(), but from GLSL source text that was built at run time.
+    // Loads a cached binary of the program instead when there is one.
+    void createFromSource(const QByteArray &vertSource, const QByteArray &fragSource);
     // Tells our OpenGL context to use this shader to draw things
     void useMe();
     // Pass the given model matrix to this shader on the GPU
     void setModelMatrix(const glm::mat4 &model);
-    // Pass the given Projection * View matrix to this shader on the GPU
-    void setViewProjMatrix(const glm::mat4 &vp);
-    void setShadowViewProjMatrix(const glm::mat4 &vp);
     // Pass the given color to this shader on the GPU
     void setGeometryColor(glm::vec4 color);
 
-    // Pass the given camera position to this shader on the GPU
-    void setCamPos(const glm::vec3 &camera);
-
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
-    void drawChunkOpaque(Chunk &d);
-    void drawChunkTransp(Chunk &d);
+    // Chunks and far tiles read their origin from entry drawIdx of the given
+    // offsets, whose pass must have begun with this program's attrChunkOffset.
+    // Camera, light and time are shared by every program through the PerFrame UBO.
+    void drawChunkOpaque(Chunk &d, DrawOffsetBuffer &offsets, int drawIdx);
+    void drawChunkTransp(Chunk &d, DrawOffsetBuffer &offsets, int drawIdx);
+    void drawFarTile(FarTile &d, DrawOffsetBuffer &offsets, int drawIdx);
     // Draw the given object to our screen multiple times using instanced rendering
     void drawInstanced(InstancedDrawable &d);
-    // Utility function used in create()
-    char* textFileRead(const char*);
-    // Utility function that prints any shader compilation errors to the console
-    void printShaderInfoLog(int shader);
-    // Utility function that prints any shader linking errors to the console
-    void printLinkInfoLog(int prog);
 
     virtual void setupMemberVars();
 
     void setTime(int t);
-    void setEye(glm::vec3 eye);
-    void setDim(glm::vec2 dim);
-    void setLightDir(const glm::vec4 &ldr);
-    QString qTextFileRead(const char*);
+
+private:
+    // Points the texture and shadow samplers at their texture slots
+    void setSamplerSlots();
 
 //private:
 protected:
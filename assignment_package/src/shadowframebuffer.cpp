@@ -23,7 +23,7 @@ void ShadowFrameBuffer::create() {
     // Bind our texture so that all functions that deal with textures will interact with this one
     mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
     // Give an empty image to OpenGL ( the last "0" )
-    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, 2048, 2048, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
     // Set the render settings for the texture we've just created.
     // Essentially zero filtering on the "texture" so it appears exactly as rendered
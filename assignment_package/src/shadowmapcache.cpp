@@ -0,0 +1,207 @@
+#include "shadowmapcache.h"
+#include "shadowshader.h"
+#include "scene/terrain.h"
+#include <cfloat>
+
+// How far, in radians, the sun may travel before the map is re-rendered.
+// At SUN_VELOCITY this is roughly once every hundred frames.
+#define SHADOW_SUN_ANGLE_THRESHOLD 0.005f
+// Half the depth range of the light frustum, in blocks
+#define SHADOW_DEPTH_RANGE 512.f
+
+ShadowMapCache::ShadowMapCache(OpenGLContext *context, unsigned int resolution, int drawRadius,
+                               int amortizeFrames, int updateInterval)
+    : mp_context(context), m_maps(), m_front(0),
+      m_resolution(resolution), m_drawRadius(drawRadius),
+      m_amortizeFrames(glm::max(amortizeFrames, 1)),
+      m_updateInterval(glm::max(updateInterval, 1)), m_framesSinceCheck(0),
+      m_frontViewProj(), m_backViewProj(), m_lightView(), m_lightRect(0.f),
+      m_sunDir(0.f), m_focus(0.f), m_halfExtent(0.f), m_center(0),
+      m_valid(false), m_dirty(false), m_rendering(false), m_slice(0)
+{
+    // A single map is enough when every re-render finishes in one frame.
+    // Otherwise the scene keeps sampling the old map while the new one is drawn.
+    int numMaps = m_amortizeFrames > 1 ? 2 : 1;
+    for(int i = 0; i < numMaps; i++) {
+        m_maps.push_back(mkU<ShadowFrameBuffer>(context, resolution, resolution, 1));
+    }
+}
+
+void ShadowMapCache::create() {
+    for(uPtr<ShadowFrameBuffer> &map : m_maps) {
+        map->create();
+        // Until the first render completes, nothing is in shadow
+        map->bindFrameBuffer();
+        mp_context->glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    invalidate();
+}
+
+void ShadowMapCache::destroy() {
+    for(uPtr<ShadowFrameBuffer> &map : m_maps) {
+        map->destroy();
+    }
+}
+
+void ShadowMapCache::invalidate() {
+    m_valid = false;
+    m_rendering = false;
+}
+
+bool ShadowMapCache::overlapsLightRect(glm::vec3 boxMin, glm::vec3 boxMax) const {
+    glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+    for(int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? boxMax.x : boxMin.x,
+                         (i & 2) ? boxMax.y : boxMin.y,
+                         (i & 4) ? boxMax.z : boxMin.z);
+        glm::vec2 p = glm::vec2(m_lightView * glm::vec4(corner, 1.f));
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    return lo.x <= m_lightRect.y && hi.x >= m_lightRect.x &&
+           lo.y <= m_lightRect.w && hi.y >= m_lightRect.z;
+}
+
+void ShadowMapCache::notifyChunkRemeshed(glm::ivec2 chunkOrigin) {
+    if(chunkOrigin.x < m_center.x - m_drawRadius || chunkOrigin.x >= m_center.x + 16 + m_drawRadius ||
+       chunkOrigin.y < m_center.y - m_drawRadius || chunkOrigin.y >= m_center.y + 16 + m_drawRadius)
+    {
+        return;
+    }
+    // The new mesh's height is not known here, so test the whole column
+    if(overlapsLightRect(glm::vec3(chunkOrigin.x, 0, chunkOrigin.y),
+                         glm::vec3(chunkOrigin.x + 16, 256, chunkOrigin.y + 16)))
+    {
+        m_dirty = true;
+    }
+}
+
+void ShadowMapCache::startRender(glm::vec3 sunDir, glm::vec3 focus, float halfExtent, glm::ivec2 center) {
+    m_sunDir = sunDir;
+    m_focus = focus;
+    m_halfExtent = halfExtent;
+    m_center = center;
+    m_dirty = false;
+
+    // The sun only moves in the XY plane, but guard against a
+    // degenerate basis should it ever pass straight overhead
+    glm::vec3 up = glm::abs(sunDir.y) > 0.999f ? glm::vec3(0,0,1) : glm::vec3(0,1,0);
+    // Build the light's view about the world origin rather than the player,
+    // so the texel grid is fixed in world space for a given sun direction
+    m_lightView = glm::lookAt(sunDir, glm::vec3(0.f), up);
+
+    glm::vec4 c = m_lightView * glm::vec4(focus, 1.f);
+    // Snap the frustum's center to a whole texel so static geometry always
+    // lands on the same texels and the shadow edges do not crawl
+    float texel = 2.f * halfExtent / m_resolution;
+    c.x = glm::floor(c.x / texel) * texel;
+    c.y = glm::floor(c.y / texel) * texel;
+    m_lightRect = glm::vec4(c.x - halfExtent, c.x + halfExtent, c.y - halfExtent, c.y + halfExtent);
+
+    glm::mat4 proj = glm::ortho<float>(m_lightRect.x, m_lightRect.y, m_lightRect.z, m_lightRect.w,
+                                       -c.z - SHADOW_DEPTH_RANGE, -c.z + SHADOW_DEPTH_RANGE);
+    m_backViewProj = proj * m_lightView;
+    m_slice = 0;
+    m_rendering = true;
+}
+
+void ShadowMapCache::renderSlice(Terrain &terrain, ShadowShader &shader) {
+    // Gather the Chunks of this slice whose opaque geometry
+    // falls inside the light frustum's XY bounds. The depth range
+    // is deep enough that nothing in it is clipped toward the sun.
+    std::vector<Chunk*> casters;
+    for(int x = m_center.x - m_drawRadius; x < m_center.x + 16 + m_drawRadius; x += 16) {
+        for(int z = m_center.y - m_drawRadius; z < m_center.y + 16 + m_drawRadius; z += 16) {
+            if(m_amortizeFrames > 1) {
+                int chunkIdx = x / 16 + z / 16;
+                if(((chunkIdx % m_amortizeFrames) + m_amortizeFrames) % m_amortizeFrames != m_slice) {
+                    continue;
+                }
+            }
+            if(!terrain.hasChunkAt(x, z)) {
+                continue;
+            }
+            const uPtr<Chunk> &chunk = terrain.getChunkAt(x, z);
+            if(chunk->opaquevbogenerated() && chunk->transpvbogenerated() &&
+               overlapsLightRect(glm::vec3(x, chunk->m_opaqueMinY, z),
+                                 glm::vec3(x + 16, chunk->m_opaqueMaxY, z + 16)))
+            {
+                casters.push_back(chunk.get());
+            }
+        }
+    }
+
+    int target = m_amortizeFrames > 1 ? 1 - m_front : m_front;
+    m_maps[target]->bindFrameBuffer();
+    mp_context->glViewport(0, 0, m_resolution, m_resolution);
+    if(m_slice == 0) {
+        mp_context->glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    shader.setViewProjMatrix(m_backViewProj);
+    shader.drawShadow(casters);
+    m_slice++;
+}
+
+bool ShadowMapCache::update(glm::vec3 sunDir, glm::vec3 sphereCenter, float sphereRadius, glm::vec3 playerPos,
+                            Terrain &terrain, ShadowShader &shader) {
+    if(!m_rendering) {
+        m_framesSinceCheck++;
+        if(m_valid && m_framesSinceCheck < m_updateInterval) {
+            return false;
+        }
+        m_framesSinceCheck = 0;
+
+        // Snap the sphere to a grid a quarter of its radius wide and grow
+        // the frustum to match, so small camera motions reuse the cached map
+        float radius = glm::ceil(sphereRadius);
+        float grid = glm::max(1.f, glm::floor(radius / 4.f));
+        glm::vec3 focus = glm::round(sphereCenter / grid) * grid;
+        float halfExtent = glm::ceil(radius + grid * 0.87f);
+        glm::ivec2 center(16 * glm::ivec2(glm::floor(glm::vec2(playerPos.x, playerPos.z) / 16.f)));
+
+        bool sunMoved = glm::dot(sunDir, m_sunDir) < glm::cos(SHADOW_SUN_ANGLE_THRESHOLD);
+        if(m_valid && !sunMoved && !m_dirty && focus == m_focus && halfExtent == m_halfExtent) {
+            return false;
+        }
+        // Remeshes that arrive while a render is in
+        // progress set m_dirty again and queue another one
+        startRender(sunDir, focus, halfExtent, center);
+        if(!m_valid) {
+            // Nothing usable to show in the meantime, so draw it all at once
+            while(m_slice < m_amortizeFrames) {
+                renderSlice(terrain, shader);
+            }
+        }
+        else {
+            renderSlice(terrain, shader);
+        }
+    }
+    else {
+        renderSlice(terrain, shader);
+    }
+
+    if(m_slice < m_amortizeFrames) {
+        return false;
+    }
+    if(m_amortizeFrames > 1) {
+        m_front = 1 - m_front;
+    }
+    m_frontViewProj = m_backViewProj;
+    m_rendering = false;
+    m_valid = true;
+    return true;
+}
+
+glm::mat4 ShadowMapCache::getDepthBiasMVP() const {
+    glm::mat4 biasMatrix(
+    0.5, 0.0, 0.0, 0.0,
+    0.0, 0.5, 0.0, 0.0,
+    0.0, 0.0, 0.5, 0.0,
+    0.5, 0.5, 0.5, 1.0
+    );
+    return biasMatrix * m_frontViewProj;
+}
+
+void ShadowMapCache::bindToTextureSlot(unsigned int slot) {
+    m_maps[m_front]->bindToTextureSlot(slot);
+}
@@ -0,0 +1,75 @@
+#ifndef SHADOWMAPCACHE_H
+#define SHADOWMAPCACHE_H
+
+#include "openglcontext.h"
+#include "glm_includes.h"
+#include "shadowframebuffer.h"
+#include "smartpointerhelp.h"
+#include <vector>
+
+class Terrain;
+class ShadowShader;
+class Chunk;
+
+// A shadow map that persists between frames. It covers a bounding sphere
+// handed to it every frame, and is only re-rendered when the sun has turned
+// past a small threshold, when the sphere has moved far enough for the
+// snapped light frustum to change, or when a Chunk inside the frustum was
+// remeshed. Those checks only run every m_updateInterval frames.
+// With more than one amortization frame, a re-render is spread across that
+// many frames into a second map, which is swapped in once it is complete.
+class ShadowMapCache
+{
+private:
+    OpenGLContext *mp_context;
+    std::vector<uPtr<ShadowFrameBuffer>> m_maps;
+    int m_front; // Index of the map the scene currently samples
+
+    unsigned int m_resolution;
+    int m_drawRadius;     // Chunks this far from the player's chunk may cast shadows
+    int m_amortizeFrames;
+    int m_updateInterval;
+    int m_framesSinceCheck;
+
+    glm::mat4 m_frontViewProj;
+    glm::mat4 m_backViewProj;
+    glm::mat4 m_lightView;  // Light view of the most recent render
+    glm::vec4 m_lightRect;  // Its light-space XY bounds: min x, max x, min y, max y
+
+    glm::vec3 m_sunDir;     // Sun direction of the most recent render
+    glm::vec3 m_focus;      // Snapped center of the bounding sphere it covered
+    float m_halfExtent;     // Half the width of its light frustum, in blocks
+    glm::ivec2 m_center;    // Chunk the player stood in when it was rendered
+    bool m_valid;
+    bool m_dirty;           // A Chunk inside the map was remeshed
+    bool m_rendering;       // An amortized re-render is in progress
+    int m_slice;
+
+    // Does the given box overlap the light frustum of the most recent render?
+    bool overlapsLightRect(glm::vec3 boxMin, glm::vec3 boxMax) const;
+    void startRender(glm::vec3 sunDir, glm::vec3 focus, float halfExtent, glm::ivec2 center);
+    void renderSlice(Terrain &terrain, ShadowShader &shader);
+
+public:
+    ShadowMapCache(OpenGLContext *context, unsigned int resolution, int drawRadius,
+                   int amortizeFrames, int updateInterval);
+
+    void create();
+    void destroy();
+
+    // Forces the next update() to re-render the map
+    void invalidate();
+    // Marks the map dirty if the Chunk at the given origin was drawn into it
+    void notifyChunkRemeshed(glm::ivec2 chunkOrigin);
+    // Re-renders (part of) the map if it is out of date.
+    // Leaves a shadow frame buffer bound when it draws anything.
+    // Returns true if a new map was swapped in.
+    bool update(glm::vec3 sunDir, glm::vec3 sphereCenter, float sphereRadius, glm::vec3 playerPos,
+                Terrain &terrain, ShadowShader &shader);
+
+    // The light's view-projection, remapped from NDC to texture space
+    glm::mat4 getDepthBiasMVP() const;
+    void bindToTextureSlot(unsigned int slot);
+};
+
+#endif // SHADOWMAPCACHE_H
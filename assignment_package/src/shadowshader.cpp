@@ -1,91 +1,38 @@
 #include "shadowshader.h"
-#include <QFile>
-#include <QStringBuilder>
-#include <QTextStream>
 #include <QDebug>
 #include <stdexcept>
 #include "scene/chunk.h"
 #include "scene/terrain.h"
 ShadowShader::ShadowShader(OpenGLContext *context)
-    : vertShader(), fragShader(), prog(),
+    : prog(),
       attrPos(-1),
-      unifModel(-1), unifViewProj(-1),
-      context(context)
+      attrChunkOffset(-1), unifViewProj(-1),
+      m_drawOffsets(context), context(context)
 {}
 
+void ShadowShader::destroy()
+{
+    m_drawOffsets.destroy();
+}
+
 void ShadowShader::create(const char *vertfile, const char *fragfile)
 {
-    // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
-    vertShader = context->glCreateShader(GL_VERTEX_SHADER);
-    fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
-    prog = context->glCreateProgram();
     // Get the body of text stored in our two .glsl files
-    QString qVertSource = qTextFileRead(vertfile);
-    QString qFragSource = qTextFileRead(fragfile);
-
-    char* vertSource = new char[qVertSource.size()+1];
-    strcpy(vertSource, qVertSource.toStdString().c_str());
-    char* fragSource = new char[qFragSource.size()+1];
-    strcpy(fragSource, qFragSource.toStdString().c_str());
-
-
-    // Send the shader text to OpenGL and store it in the shaders specified by the handles vertShader and fragShader
-    context->glShaderSource(vertShader, 1, (const char**)&vertSource, 0);
-    context->glShaderSource(fragShader, 1, (const char**)&fragSource, 0);
-    // Tell OpenGL to compile the shader text stored above
-    context->glCompileShader(vertShader);
-    context->glCompileShader(fragShader);
-    // Check if everything compiled OK
-    GLint compiled;
-    context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(vertShader);
-    }
-    context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(fragShader);
-    }
-
-    // Tell prog that it manages these particular vertex and fragment shaders
-    context->glAttachShader(prog, vertShader);
-    context->glAttachShader(prog, fragShader);
-    context->glLinkProgram(prog);
-
-    // Check for linking success
-    GLint linked;
-    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        printLinkInfoLog(prog);
-    }
+    QByteArray vertSource = ProgramBinaryCache::readSource(vertfile);
+    QByteArray fragSource = ProgramBinaryCache::readSource(fragfile);
+    prog = context->programBinaries().build(vertSource, fragSource);
 
     // Get the handles to the variables stored in our shaders
     // See shaderprogram.h for more information about these variables
 
     attrPos = context->glGetAttribLocation(prog, "vs_Pos");
-    unifModel      = context->glGetUniformLocation(prog, "u_Model");
+    attrChunkOffset = context->glGetAttribLocation(prog, "vs_ChunkOffset");
     unifViewProj   = context->glGetUniformLocation(prog, "u_shadowViewProj");
 }
 
 void ShadowShader::useMe()
 {
-    context->glUseProgram(prog);
-}
-
-void ShadowShader::setModelMatrix(const glm::mat4 &model)
-{
-    useMe();
-
-    if (unifModel != -1) {
-        // Pass a 4x4 matrix into a uniform variable in our shader
-                        // Handle to the matrix variable on the GPU
-        context->glUniformMatrix4fv(unifModel,
-                        // How many matrices to pass
-                           1,
-                        // Transpose the matrix? OpenGL uses column-major, so no.
-                           GL_FALSE,
-                        // Pointer to the first element of the matrix
-                           &model[0][0]);
-    }
+    context->useProgram(prog);
 }
 
 void ShadowShader::setViewProjMatrix(const glm::mat4 &vp)
@@ -107,118 +54,41 @@ void ShadowShader::setViewProjMatrix(const glm::mat4 &vp)
 }
 
 //This function, as its name implies, uses the passed in GL widget
-void ShadowShader::drawShadow(Terrain &t, int minX, int maxX, int minZ, int maxZ)
+void ShadowShader::drawShadow(const std::vector<Chunk*> &chunks)
 {
-    for(int x = minX; x < maxX; x += 16) {
-            for(int z = minZ; z < maxZ; z += 16) {
-                if(t.hasChunkAt(x,z))
-                {
-                    const uPtr<Chunk> &chunk = t.getChunkAt(x, z);
-                    if((chunk->transpvbogenerated()) & (chunk->opaquevbogenerated()))
-                    {
-                        int xFloor = static_cast<int>(glm::floor(x / 16.f)) * 16;
-                        int zFloor = static_cast<int>(glm::floor(z / 16.f)) * 16;
-                        setModelMatrix(glm::translate(glm::mat4(),glm::vec3(xFloor,0,zFloor)));
-                        drawChunk(*chunk);
-                    }
-                }
-            }
+    // Upload every origin at once so the draws themselves change no state
+    m_drawOffsets.clear();
+    for(Chunk *chunk : chunks) {
+        m_drawOffsets.add(chunk->m_global_pos);
     }
+    m_drawOffsets.upload();
+    m_drawOffsets.beginPass(attrChunkOffset);
+    for(int i = 0; i < static_cast<int>(chunks.size()); i++) {
+        drawChunk(*chunks[i], i);
+    }
+    m_drawOffsets.endPass();
 }
 
-void ShadowShader::drawChunk(Chunk &d)
+void ShadowShader::drawChunk(Chunk &d, int drawIdx)
 {
         useMe();
         if(d.elemCountOpaque() < 0) {
             throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
         }
-        if(d.bindSingleOpaqueBuf())
+        // Depth only needs positions, so read the packed
+        // stream rather than the full interleaved vertices
+        if(d.bindOpaquePosBuf())
         {
             if(attrPos != -1)
             {
                 context->glEnableVertexAttribArray(attrPos);
-                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 2 * sizeof(glm::vec4) + sizeof(glm::vec2), (void*) (0));
+                context->glVertexAttribPointer(attrPos, 4, GL_SHORT, false, sizeof(VertexPos), (void*) (0));
             }
         }
         d.bindIdxOpaque();
-        context->glDrawElements(d.drawMode(), d.elemCountOpaque(), GL_UNSIGNED_INT, 0);
+        m_drawOffsets.drawElements(d.drawMode(), d.elemCountOpaque(), drawIdx);
         if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
         context->printGLErrorLog();
 }
 
 
-char* ShadowShader::textFileRead(const char* fileName) {
-    char* text;
-
-    if (fileName != NULL) {
-        FILE *file = fopen(fileName, "rt");
-
-        if (file != NULL) {
-            fseek(file, 0, SEEK_END);
-            int count = ftell(file);
-            rewind(file);
-
-            if (count > 0) {
-                text = (char*)malloc(sizeof(char) * (count + 1));
-                count = fread(text, sizeof(char), count, file);
-                text[count] = '\0';	//cap off the string with a terminal symbol, fixed by Cory
-            }
-            fclose(file);
-        }
-    }
-    return text;
-}
-
-QString ShadowShader::qTextFileRead(const char *fileName)
-{
-    QString text;
-    QFile file(fileName);
-    if(file.open(QFile::ReadOnly))
-    {
-        QTextStream in(&file);
-        text = in.readAll();
-        text.append('\0');
-    }
-    return text;
-}
-
-void ShadowShader::printShaderInfoLog(int shader)
-{
-    int infoLogLen = 0;
-    int charsWritten = 0;
-    GLchar *infoLog;
-
-    context->glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLen);
-
-    // should additionally check for OpenGL errors here
-
-    if (infoLogLen > 0)
-    {
-        infoLog = new GLchar[infoLogLen];
-        // error check for fail to allocate memory omitted
-        context->glGetShaderInfoLog(shader,infoLogLen, &charsWritten, infoLog);
-        qDebug() << "ShaderInfoLog:" << "\n" << infoLog << "\n";
-        delete [] infoLog;
-    }
-
-    // should additionally check for OpenGL errors here
-}
-
-void ShadowShader::printLinkInfoLog(int prog)
-{
-    int infoLogLen = 0;
-    int charsWritten = 0;
-    GLchar *infoLog;
-
-    context->glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &infoLogLen);
-
-    // should additionally check for OpenGL errors here
-
-    if (infoLogLen > 0) {
-        infoLog = new GLchar[infoLogLen];
-        // error check for fail to allocate memory omitted
-        context->glGetProgramInfoLog(prog, infoLogLen, &charsWritten, infoLog);
-        qDebug() << "LinkInfoLog:" << "\n" << infoLog << "\n";
-        delete [] infoLog;
-    }
-}
@@ -6,43 +6,38 @@
 #include <glm/glm.hpp>
 
 #include "drawable.h"
+#include "drawoffsetbuffer.h"
+#include <vector>
 class Terrain;
 class Chunk;
 class ShadowShader
 {
 public:
-    GLuint vertShader; // A handle for the vertex shader stored in this shader program
-    GLuint fragShader; // A handle for the fragment shader stored in this shader program
     GLuint prog;       // A handle for the linked shader program stored in this class
 
     int attrPos; // A handle for the "in" vec4 representing vertex position in the vertex shader
-    int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
+    int attrChunkOffset; // A handle for the instanced "in" ivec2 representing the world-space XZ origin of the Chunk being drawn
     int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
 public:
     ShadowShader(OpenGLContext* context);
+    // Releases m_drawOffsets. Needs the context current.
+    void destroy();
     // Sets up the requisite GL data and shaders from the given .glsl files
     void create(const char *vertfile, const char *fragfile);
     // Tells our OpenGL context to use this shader to draw things
     void useMe();
-    // Pass the given model matrix to this shader on the GPU
-    void setModelMatrix(const glm::mat4 &model);
     // Pass the given Projection * View matrix to this shader on the GPU
     void setViewProjMatrix(const glm::mat4 &vp);
-    // Draw the given object to our screen using this ShaderProgram's shaders
-    void drawShadow(Terrain &t,int minX, int maxX, int minZ, int maxZ);
-    void drawChunk(Chunk& d);
-    // Utility function used in create()
-    char* textFileRead(const char*);
-    // Utility function that prints any shader compilation errors to the console
-    void printShaderInfoLog(int shader);
-    // Utility function that prints any shader linking errors to the console
-    void printLinkInfoLog(int prog);
+    // Draw the opaque geometry of the given Chunks into the bound shadow map
+    void drawShadow(const std::vector<Chunk*> &chunks);
+    // Draw one Chunk whose origin is entry drawIdx of m_drawOffsets
+    void drawChunk(Chunk& d, int drawIdx);
 
     virtual void setupMemberVars(){};
-    QString qTextFileRead(const char*);
 
 //private:
 protected:
+    DrawOffsetBuffer m_drawOffsets; // Origins of the Chunks in the current drawShadow() call
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
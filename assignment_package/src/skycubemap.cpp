@@ -0,0 +1,89 @@
+#include "skycubemap.h"
+#include "skyshader.h"
+
+// View direction and up vector of each face, in the order of
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X onward. The ups follow the
+// cubemap convention of t running downward on the side faces.
+static const glm::vec3 FACE_DIRS[6] = {
+    glm::vec3( 1, 0, 0), glm::vec3(-1, 0, 0),
+    glm::vec3( 0, 1, 0), glm::vec3( 0,-1, 0),
+    glm::vec3( 0, 0, 1), glm::vec3( 0, 0,-1)
+};
+static const glm::vec3 FACE_UPS[6] = {
+    glm::vec3( 0,-1, 0), glm::vec3( 0,-1, 0),
+    glm::vec3( 0, 0, 1), glm::vec3( 0, 0,-1),
+    glm::vec3( 0,-1, 0), glm::vec3( 0,-1, 0)
+};
+
+SkyCubeMap::SkyCubeMap(OpenGLContext *context, unsigned int resolution)
+    : mp_context(context), m_frameBuffer(0), m_cubeTexture(0),
+      m_resolution(resolution), m_nextFace(0), m_complete(false), m_created(false)
+{}
+
+void SkyCubeMap::create() {
+    mp_context->glGenFramebuffers(1, &m_frameBuffer);
+    mp_context->glGenTextures(1, &m_cubeTexture);
+
+    mp_context->glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
+    for(int face = 0; face < 6; face++) {
+        mp_context->glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8,
+                                 m_resolution, m_resolution, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    }
+    // The sky is smooth enough that bilinear filtering hides the low resolution
+    mp_context->glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    mp_context->glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    mp_context->glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    mp_context->glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    mp_context->glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    m_created = true;
+    m_complete = false;
+    m_nextFace = 0;
+    mp_context->printGLErrorLog();
+}
+
+void SkyCubeMap::destroy() {
+    if(m_created) {
+        m_created = false;
+        mp_context->glDeleteFramebuffers(1, &m_frameBuffer);
+        mp_context->glDeleteTextures(1, &m_cubeTexture);
+    }
+}
+
+void SkyCubeMap::renderFace(int face, SkyShader &shader, Drawable &quad) {
+    mp_context->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                       GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_cubeTexture, 0);
+    // Rays start at the origin, since only their direction matters
+    glm::mat4 viewProj = glm::perspective(glm::radians(90.f), 1.f, 0.1f, 10.f)
+                       * glm::lookAt(glm::vec3(0.f), FACE_DIRS[face], FACE_UPS[face]);
+    shader.setFaceInvViewProj(glm::inverse(viewProj));
+    shader.draw(quad);
+}
+
+void SkyCubeMap::update(SkyShader &shader, Drawable &quad) {
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+    mp_context->glViewport(0, 0, m_resolution, m_resolution);
+    // Every texel of a face is overwritten, so nothing needs clearing or depth testing
+    mp_context->glDisable(GL_DEPTH_TEST);
+    mp_context->glDisable(GL_BLEND);
+
+    if(!m_complete) {
+        for(int face = 0; face < 6; face++) {
+            renderFace(face, shader, quad);
+        }
+        m_complete = true;
+    } else {
+        // The clouds drift slowly enough that a face lagging the
+        // others by a few frames leaves no visible seam
+        renderFace(m_nextFace, shader, quad);
+        m_nextFace = (m_nextFace + 1) % 6;
+    }
+
+    mp_context->glEnable(GL_BLEND);
+    mp_context->glEnable(GL_DEPTH_TEST);
+}
+
+void SkyCubeMap::bindToTextureSlot(unsigned int slot) {
+    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
+    mp_context->glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeTexture);
+}
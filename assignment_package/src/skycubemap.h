@@ -0,0 +1,39 @@
+#ifndef SKYCUBEMAP_H
+#define SKYCUBEMAP_H
+
+#include "openglcontext.h"
+#include "glm_includes.h"
+
+class SkyShader;
+class Drawable;
+
+// The sky only depends on the view direction and the time, so rather
+// than running sky.frag for every pixel of the screen it is cached in a
+// small cubemap. One face is redrawn per frame, so the whole sky is
+// refreshed every six frames as u_Time advances.
+class SkyCubeMap
+{
+private:
+    OpenGLContext *mp_context;
+    GLuint m_frameBuffer;
+    GLuint m_cubeTexture;
+    unsigned int m_resolution; // Width and height of each face
+    int m_nextFace;            // Face the next update() redraws
+    bool m_complete;           // Has every face been drawn at least once?
+    bool m_created;
+
+    void renderFace(int face, SkyShader &shader, Drawable &quad);
+
+public:
+    SkyCubeMap(OpenGLContext *context, unsigned int resolution);
+
+    void create();
+    void destroy();
+
+    // Redraws the next face in turn, or all six if none have been drawn yet.
+    // Leaves the cubemap's frame buffer bound and its viewport set.
+    void update(SkyShader &shader, Drawable &quad);
+    void bindToTextureSlot(unsigned int slot);
+};
+
+#endif // SKYCUBEMAP_H
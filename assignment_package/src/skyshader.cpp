@@ -0,0 +1,30 @@
+#include "skyshader.h"
+
+SkyShader::SkyShader(OpenGLContext *context)
+    : ShaderProgram(context),
+      unifFaceInvViewProj(-1), unifSkyCube(-1)
+{}
+
+SkyShader::~SkyShader()
+{}
+
+void SkyShader::setupMemberVars()
+{
+    ShaderProgram::setupMemberVars();
+    unifFaceInvViewProj = context->glGetUniformLocation(prog, "u_FaceInvViewProj");
+    unifSkyCube = context->glGetUniformLocation(prog, "u_SkyCube");
+
+    if(unifSkyCube != -1) {
+        useMe();
+        context->glUniform1i(unifSkyCube, SKY_CUBE_SLOT);
+    }
+}
+
+void SkyShader::setFaceInvViewProj(const glm::mat4 &invViewProj)
+{
+    useMe();
+
+    if(unifFaceInvViewProj != -1) {
+        context->glUniformMatrix4fv(unifFaceInvViewProj, 1, GL_FALSE, &invViewProj[0][0]);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "shaderprogram.h"
+
+// Texture slot the cached sky is bound to when it is composited.
+// Slots 0 to 7 hold the block texture, the shadow cascades, the
+// post-process input and the G-buffer.
+#define SKY_CUBE_SLOT 8
+
+// The programs that draw the sky: one renders a face of the sky
+// cubemap from a ray direction matrix, the other composites the
+// cubemap behind the terrain.
+class SkyShader : public ShaderProgram
+{
+public:
+    int unifFaceInvViewProj; // A handle for the "uniform" mat4 that maps a cubemap face's NDC to ray directions
+    int unifSkyCube;         // A handle to the "uniform" samplerCube holding the cached sky
+
+public:
+    SkyShader(OpenGLContext* context);
+    virtual ~SkyShader();
+
+    // Sets up shader-specific handles and points the sky sampler at its slot
+    void setupMemberVars() override;
+    // Pass the inverse view-projection of the cubemap face being drawn
+    void setFaceInvViewProj(const glm::mat4 &invViewProj);
+};
@@ -2,6 +2,7 @@ INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
 SOURCES += \
+    $$PWD/cascadedshadowmap.cpp \
     $$PWD/chunkworkers.cpp \
     $$PWD/framebuffer.cpp \
     $$PWD/inventory.cpp \
@@ -10,8 +11,16 @@ SOURCES += \
     $$PWD/mygl.cpp \
     $$PWD/postprocessshader.cpp \
     $$PWD/scene/biome.cpp \
+    $$PWD/scene/farterrain.cpp \
     $$PWD/scene/fbmworker.cpp \
     $$PWD/scene/vboworker.cpp \
+    $$PWD/scene/chunktimeline.cpp \
+    $$PWD/scene/voxelcollision.cpp \
+    $$PWD/scene/chunkuploader.cpp \
+    $$PWD/scene/entitymanager.cpp \
+    $$PWD/scene/spatialhash.cpp \
+    $$PWD/scene/fluidsimulator.cpp \
+    $$PWD/scene/lightengine.cpp \
     $$PWD/scene/quad.cpp \
     $$PWD/shaderprogram.cpp \
     $$PWD/drawable.cpp \
@@ -26,10 +35,24 @@ SOURCES += \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
     $$PWD/shadowframebuffer.cpp \
+    $$PWD/shadowmapcache.cpp \
     $$PWD/shadowshader.cpp \
-    $$PWD/texteure.cpp
+    $$PWD/uniformbuffer.cpp \
+    $$PWD/drawoffsetbuffer.cpp \
+    $$PWD/deferredshader.cpp \
+    $$PWD/texturearray.cpp \
+    $$PWD/skyshader.cpp \
+    $$PWD/skycubemap.cpp \
+    $$PWD/postprocesschain.cpp \
+    $$PWD/programbinarycache.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/runoptions.cpp \
+    $$PWD/inputrecorder.cpp \
+    $$PWD/benchmarkrunner.cpp \
+    $$PWD/worldsimulation.cpp
 
 HEADERS += \
+    $$PWD/cascadedshadowmap.h \
     $$PWD/chunkworkers.h \
     $$PWD/framebuffer.h \
     $$PWD/inventory.h \
@@ -37,8 +60,16 @@ HEADERS += \
     $$PWD/mygl.h \
     $$PWD/postprocessshader.h \
     $$PWD/scene/biome.h \
+    $$PWD/scene/farterrain.h \
     $$PWD/scene/fbmworker.h \
     $$PWD/scene/vboworker.h \
+    $$PWD/scene/chunktimeline.h \
+    $$PWD/scene/voxelcollision.h \
+    $$PWD/scene/chunkuploader.h \
+    $$PWD/scene/entitymanager.h \
+    $$PWD/scene/spatialhash.h \
+    $$PWD/scene/fluidsimulator.h \
+    $$PWD/scene/lightengine.h \
     $$PWD/scene/quad.h \
     $$PWD/shaderprogram.h \
     $$PWD/drawable.h \
@@ -48,6 +79,7 @@ HEADERS += \
     $$PWD/scene/terrain.h \
     $$PWD/scene/worldaxes.h \
     $$PWD/shadowframebuffer.h \
+    $$PWD/shadowmapcache.h \
     $$PWD/shadowshader.h \
     $$PWD/smartpointerhelp.h \
     $$PWD/glm_includes.h \
@@ -56,4 +88,17 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
-    $$PWD/texteure.h
+    $$PWD/uniformbuffer.h \
+    $$PWD/drawoffsetbuffer.h \
+    $$PWD/deferredshader.h \
+    $$PWD/texturearray.h \
+    $$PWD/skyshader.h \
+    $$PWD/skycubemap.h \
+    $$PWD/postprocesschain.h \
+    $$PWD/programbinarycache.h \
+    $$PWD/profiler.h \
+    $$PWD/runoptions.h \
+    $$PWD/inputrecorder.h \
+    $$PWD/benchmarkrunner.h \
+    $$PWD/worldsimulation.h \
+    $$PWD/triplebuffer.h
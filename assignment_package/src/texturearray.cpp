@@ -0,0 +1,72 @@
+#include "texturearray.h"
+#include <QImage>
+#include <QOpenGLWidget>
+
+TextureArray::TextureArray(OpenGLContext *context)
+    : context(context), m_textureHandle(-1), m_textureImage(nullptr), m_cellsPerSide(1)
+{}
+
+TextureArray::~TextureArray()
+{}
+
+void TextureArray::create(const char *texturePath, int cellsPerSide)
+{
+    context->printGLErrorLog();
+
+    QImage img(texturePath);
+    img = img.convertToFormat(QImage::Format_ARGB32);
+    // Flip so that row 0 is the bottom of the atlas, like UV space
+    img = img.mirrored();
+    m_textureImage = std::make_shared<QImage>(img);
+    m_cellsPerSide = cellsPerSide;
+    context->glGenTextures(1, &m_textureHandle);
+
+    context->printGLErrorLog();
+}
+
+void TextureArray::load(int texSlot = 0)
+{
+    context->printGLErrorLog();
+
+    int cellSize = m_textureImage->width() / m_cellsPerSide;
+    int layers = m_cellsPerSide * m_cellsPerSide;
+
+    context->glActiveTexture(GL_TEXTURE0 + texSlot);
+    context->glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureHandle);
+
+    // Keep blocks crisp up close, but blend mip levels at a distance
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    context->glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    context->glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+                          cellSize, cellSize, layers,
+                          0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    // Copy each cell straight out of the atlas into its layer
+    context->glPixelStorei(GL_UNPACK_ROW_LENGTH, m_textureImage->width());
+    for(int row = 0; row < m_cellsPerSide; row++) {
+        for(int col = 0; col < m_cellsPerSide; col++) {
+            const uchar *cell = m_textureImage->constScanLine(row * cellSize) + col * cellSize * 4;
+            context->glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, col + m_cellsPerSide * row,
+                                     cellSize, cellSize, 1,
+                                     GL_BGRA, GL_UNSIGNED_BYTE, cell);
+        }
+    }
+    context->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    context->glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    context->printGLErrorLog();
+}
+
+void TextureArray::bind(int texSlot = 0)
+{
+    context->glActiveTexture(GL_TEXTURE0 + texSlot);
+    context->glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureHandle);
+}
+
+void TextureArray::destroy()
+{
+    context->glDeleteTextures(1, &m_textureHandle);
+}
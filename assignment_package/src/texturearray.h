@@ -0,0 +1,34 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+#include <openglcontext.h>
+#include <glm_includes.h>
+#include <memory>
+
+// A texture atlas of equally sized square cells, sliced into a
+// GL_TEXTURE_2D_ARRAY with one cell per layer and a full mip chain.
+// Unlike sampling one atlas, a layer can repeat across a large face
+// and be filtered at a distance without bleeding into its neighbors.
+// Layer i holds cell (i % cellsPerSide, i / cellsPerSide), counted
+// from the atlas' lower left corner.
+// This is the only way block textures are loaded. Chunk meshes carry a
+// layer rather than atlas UVs, and the terrain shaders sample a
+// sampler2DArray, so there is no single-image atlas path to fall back to.
+class TextureArray
+{
+public:
+    TextureArray(OpenGLContext* context);
+    ~TextureArray();
+
+    void create(const char *texturePath, int cellsPerSide);
+    void load(int texSlot);
+    void bind(int texSlot);
+    void destroy();
+
+private:
+    OpenGLContext* context;
+    GLuint m_textureHandle;
+    std::shared_ptr<QImage> m_textureImage;
+    int m_cellsPerSide;
+};
+
+#endif // TEXTUREARRAY_H
@@ -0,0 +1,45 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+
+// Hands the newest of a stream of values from one thread to another without
+// either ever waiting on the other. The writer fills one slot while the
+// reader holds another. The third is the spare, and is swapped with the
+// writer's slot on publish() and with the reader's on read() if it holds
+// a value the reader has not seen yet. Values that are never read are
+// simply overwritten, so the writer must fill in all of back() each time.
+template<typename T>
+class TripleBuffer
+{
+private:
+    static const int FRESH = 4; // Set on m_spare while it holds an unread value
+    std::array<T, 3> m_slots;
+    std::atomic<int> m_spare;
+    int m_back;  // The writer's slot
+    int m_front; // The reader's slot
+
+public:
+    TripleBuffer()
+        : m_slots(), m_spare(1), m_back(0), m_front(2)
+    {}
+
+    // Writer only: the slot to fill in
+    T& back() {
+        return m_slots[m_back];
+    }
+    // Writer only: makes back() the newest value
+    void publish() {
+        m_back = m_spare.exchange(m_back | FRESH) & ~FRESH;
+    }
+    // Reader only: the newest published value. It stays valid until the next read().
+    const T& read() {
+        if(m_spare.load() & FRESH) {
+            m_front = m_spare.exchange(m_front) & ~FRESH;
+        }
+        return m_slots[m_front];
+    }
+};
+
+#endif // TRIPLEBUFFER_H
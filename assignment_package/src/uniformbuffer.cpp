@@ -0,0 +1,27 @@
+#include "uniformbuffer.h"
+
+UniformBuffer::UniformBuffer(OpenGLContext *context, GLuint binding)
+    : mp_context(context), m_buffer(0), m_binding(binding), m_size(0), m_created(false)
+{}
+
+void UniformBuffer::create(GLsizeiptr size) {
+    m_size = size;
+    mp_context->glGenBuffers(1, &m_buffer);
+    mp_context->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    mp_context->glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_buffer);
+    m_created = true;
+    mp_context->printGLErrorLog();
+}
+
+void UniformBuffer::destroy() {
+    if(m_created) {
+        m_created = false;
+        mp_context->glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+void UniformBuffer::upload(const void *data) {
+    mp_context->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    mp_context->glBufferSubData(GL_UNIFORM_BUFFER, 0, m_size, data);
+}
@@ -0,0 +1,48 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include "openglcontext.h"
+#include "glm_includes.h"
+#include "shaderprogram.h"
+
+// Binding point of the PerFrame uniform block in every program that declares it
+#define PER_FRAME_UBO_BINDING 0
+
+// CPU-side mirror of the std140 PerFrame block declared in glsl/per_frame.glsl.
+// Member order and padding must match the GLSL declaration exactly.
+struct PerFrameUniforms {
+    glm::mat4 viewProj;
+    glm::mat4 invViewProj;
+    glm::mat4 depthBiasMVP[SHADOW_CASCADE_COUNT];
+    glm::vec4 cascadeSplits;
+    glm::vec4 lightDir;
+    glm::vec3 eye;
+    GLint time;         // Packs into the fourth component of eye's std140 slot
+    glm::vec2 dimensions;
+    glm::vec2 padding;  // Rounds the block up to a multiple of a vec4
+};
+
+static_assert(sizeof(PerFrameUniforms) == 384, "PerFrameUniforms no longer matches the std140 layout");
+
+// A uniform buffer object bound to a fixed binding point, so that any
+// number of programs can read the same data after a single upload.
+class UniformBuffer
+{
+private:
+    OpenGLContext *mp_context;
+    GLuint m_buffer;
+    GLuint m_binding;
+    GLsizeiptr m_size;
+    bool m_created;
+
+public:
+    UniformBuffer(OpenGLContext *context, GLuint binding);
+
+    // Allocates size bytes on the GPU and attaches them to the binding point
+    void create(GLsizeiptr size);
+    void destroy();
+    // Replaces the whole contents of the buffer
+    void upload(const void *data);
+};
+
+#endif // UNIFORMBUFFER_H
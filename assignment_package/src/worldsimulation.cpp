@@ -0,0 +1,43 @@
+#include "worldsimulation.h"
+#include <QElapsedTimer>
+
+WorldSnapshot::WorldSnapshot()
+    : prevCamera(), camera(), stepNs(0), playerPos(0.f), underwater(false), underLava(false), finished(false), entities(),
+      posText(), velText(), accText(), lookText()
+{}
+
+WorldSimulation::WorldSimulation(std::function<bool()> step)
+    : m_step(step), m_stopping(false)
+{}
+
+WorldSimulation::~WorldSimulation() {
+    stop();
+}
+
+void WorldSimulation::stop() {
+    m_stopping = true;
+    wait();
+}
+
+void WorldSimulation::run() {
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextStep = 0;
+    while(!m_stopping) {
+        qint64 now = clock.nsecsElapsed();
+        if(now < nextStep) {
+            QThread::usleep(static_cast<unsigned long>((nextStep - now) / 1000));
+            continue;
+        }
+        for(int steps = 0; now >= nextStep && !m_stopping; steps++) {
+            if(steps == SIM_MAX_CATCHUP_STEPS) {
+                nextStep = now + SIM_TIMESTEP_NS;
+                break;
+            }
+            if(!m_step()) {
+                return;
+            }
+            nextStep += SIM_TIMESTEP_NS;
+        }
+    }
+}
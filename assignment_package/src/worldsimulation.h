@@ -0,0 +1,55 @@
+#ifndef WORLDSIMULATION_H
+#define WORLDSIMULATION_H
+
+#include "glm_includes.h"
+#include "scene/entity.h"
+#include "scene/entitymanager.h"
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <functional>
+
+// Length of one simulation step
+#define SIM_TIMESTEP_NS 16666667LL
+#define SIM_TIMESTEP (SIM_TIMESTEP_NS / 1e9f)
+// Most steps run back to back to catch up. Beyond this the world slows
+// down instead, so a long hitch can not snowball into ever longer catch-ups.
+#define SIM_MAX_CATCHUP_STEPS 5
+
+// What the render thread needs to know of one simulation step.
+// The render thread draws the Chunks within its radius of playerPos.
+struct WorldSnapshot {
+    Pose prevCamera;  // The camera before the step
+    Pose camera;      // and after it
+    qint64 stepNs;    // When the step finished, on the profiler's clock
+    glm::vec3 playerPos;
+    bool underwater;  // Is the camera in water, or in lava?
+    bool underLava;
+    bool finished;    // Has the simulation stopped, e.g. because a replay ran out?
+    std::array<EntityInstances, ENTITY_KIND_COUNT> entities;
+    // For the Player info window
+    QString posText, velText, accText, lookText;
+
+    WorldSnapshot();
+};
+
+// Runs the world's simulation on its own thread at a fixed SIM_TIMESTEP,
+// so neither slow frames nor slow steps hold the other back.
+// Each step is the given function, which returns false to stop the thread.
+class WorldSimulation : public QThread
+{
+private:
+    std::function<bool()> m_step;
+    std::atomic<bool> m_stopping;
+
+protected:
+    void run() override;
+
+public:
+    WorldSimulation(std::function<bool()> step);
+    ~WorldSimulation();
+    // Waits for the step in progress, if any, to finish
+    void stop();
+};
+
+#endif // WORLDSIMULATION_H